@@ -1,4 +1,6 @@
 #include "PluginEditor.h"
+#include "DelayLine.h"
+#include "helpers/instruction_counter.h"
 #include "catch2/benchmark/catch_benchmark_all.hpp"
 #include "catch2/catch_test_macros.hpp"
 
@@ -7,14 +9,14 @@ TEST_CASE ("Boot performance")
     BENCHMARK_ADVANCED ("Processor constructor")
     (Catch::Benchmark::Chronometer meter)
     {
-        std::vector<Catch::Benchmark::storage_for<PluginProcessor>> storage (size_t (meter.runs()));
+        std::vector<Catch::Benchmark::storage_for<Waylochorus2AudioProcessor>> storage (size_t (meter.runs()));
         meter.measure ([&] (int i) { storage[(size_t) i].construct(); });
     };
 
     BENCHMARK_ADVANCED ("Processor destructor")
     (Catch::Benchmark::Chronometer meter)
     {
-        std::vector<Catch::Benchmark::destructable_object<PluginProcessor>> storage (size_t (meter.runs()));
+        std::vector<Catch::Benchmark::destructable_object<Waylochorus2AudioProcessor>> storage (size_t (meter.runs()));
         for (auto& s : storage)
             s.construct();
         meter.measure ([&] (int i) { storage[(size_t) i].destruct(); });
@@ -23,7 +25,7 @@ TEST_CASE ("Boot performance")
     BENCHMARK_ADVANCED ("Editor open and close")
     (Catch::Benchmark::Chronometer meter)
     {
-        PluginProcessor plugin;
+        Waylochorus2AudioProcessor plugin;
 
         // due to complex construction logic of the editor, let's measure open/close together
         meter.measure ([&] (int /* i */) {
@@ -34,3 +36,476 @@ TEST_CASE ("Boot performance")
         });
     };
 }
+
+TEST_CASE ("Voice scaling")
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 512;
+
+    // one benchmark per voice count, divide by the voice count to compare the per-voice cost
+    for (auto numVoices : { 2, 4, 8, 16, 32 })
+    {
+        Waylochorus2AudioProcessor plugin;
+        plugin.setNumVoices (numVoices);
+        plugin.setSilenceBypassEnabled (false); // the input is silent, time the processing rather than the bypass
+        plugin.setRateAndBufferSizeDetails (sampleRate, blockSize);
+        plugin.prepareToPlay (sampleRate, blockSize);
+
+        juce::AudioBuffer<float> buffer (2, blockSize);
+        juce::MidiBuffer midi;
+        buffer.clear();
+
+        BENCHMARK ("processBlock, " + std::to_string (numVoices) + " voices")
+        {
+            plugin.processBlock (buffer, midi);
+            return buffer.getSample (0, 0);
+        };
+    }
+}
+
+TEST_CASE ("Instructions per sample")
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 512;
+    constexpr int numBlocks = 1000;
+
+    InstructionCounter counter;
+
+    if (! counter.isAvailable())
+        SKIP ("hardware instruction counter not available");
+
+    for (auto numVoices : { 4, 32 })
+    {
+        Waylochorus2AudioProcessor plugin;
+        plugin.setNumVoices (numVoices);
+        plugin.setSilenceBypassEnabled (false); // the input is silent, time the processing rather than the bypass
+        plugin.setRateAndBufferSizeDetails (sampleRate, blockSize);
+        plugin.prepareToPlay (sampleRate, blockSize);
+
+        juce::AudioBuffer<float> buffer (2, blockSize);
+        juce::MidiBuffer midi;
+        buffer.clear();
+
+        // warm up caches and branch predictors before counting
+        for (int i = 0; i < 10; ++i)
+            plugin.processBlock (buffer, midi);
+
+        counter.start();
+
+        for (int i = 0; i < numBlocks; ++i)
+            plugin.processBlock (buffer, midi);
+
+        const auto instructions = counter.stop();
+
+        WARN (numVoices << " voices: " << (double) instructions / (numBlocks * blockSize) << " instructions per sample");
+    }
+}
+
+TEST_CASE ("Vectorised kernel speed-up")
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 512;
+    constexpr int numBlocks = 2000;
+
+    for (auto mode : { Interpolation::Mode::linear, Interpolation::Mode::hermite })
+    {
+        for (auto numVoices : { 4, 32 })
+        {
+            double seconds[2] {};
+
+            for (auto kernel : { Waylochorus2AudioProcessor::Kernel::scalar, Waylochorus2AudioProcessor::Kernel::vectorised })
+            {
+                Waylochorus2AudioProcessor plugin;
+                plugin.setKernel (kernel);
+                plugin.setNumVoices (numVoices);
+                plugin.setSilenceBypassEnabled (false);
+
+                auto* interpolation = plugin.getValueTreeState().getParameter (ChorusParameters::interpolationId);
+                interpolation->setValueNotifyingHost (interpolation->convertTo0to1 ((float) mode));
+
+                plugin.setRateAndBufferSizeDetails (sampleRate, blockSize);
+                plugin.prepareToPlay (sampleRate, blockSize);
+
+                juce::AudioBuffer<float> buffer (2, blockSize);
+                juce::MidiBuffer midi;
+                buffer.clear();
+
+                const auto* kernelName = kernel == Waylochorus2AudioProcessor::Kernel::scalar ? "scalar" : "vectorised";
+
+                BENCHMARK (std::string (kernelName) + " kernel, interpolation " + std::to_string ((int) mode) + ", " + std::to_string (numVoices) + " voices")
+                {
+                    plugin.processBlock (buffer, midi);
+                    return buffer.getSample (0, 0);
+                };
+
+                // a fixed run of each kernel as well, so the two can be compared directly
+                const auto start = juce::Time::getHighResolutionTicks();
+
+                for (int i = 0; i < numBlocks; ++i)
+                    plugin.processBlock (buffer, midi);
+
+                seconds[(int) kernel] = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+            }
+
+            WARN ("interpolation " << (int) mode << ", " << numVoices << " voices: vectorised kernel is "
+                                   << seconds[0] / seconds[1] << "x the speed of the scalar one");
+        }
+    }
+}
+
+TEST_CASE ("Interleaved delay lines")
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 128;
+    constexpr int numBlocks = 5000;
+
+    // dual stereo, the only mode with a delay line per channel
+    for (auto mode : { Interpolation::Mode::linear, Interpolation::Mode::hermite })
+    {
+        for (auto numVoices : { 4, 32 })
+        {
+            double seconds[2] {};
+
+            for (auto delayLineLayout : { Waylochorus2AudioProcessor::DelayLineLayout::planar, Waylochorus2AudioProcessor::DelayLineLayout::interleaved })
+            {
+                Waylochorus2AudioProcessor plugin;
+                plugin.setDelayLineLayout (delayLineLayout);
+                plugin.setNumVoices (numVoices);
+                plugin.setSilenceBypassEnabled (false);
+
+                for (auto [id, value] : { std::pair (ChorusParameters::interpolationId, (float) mode),
+                                          std::pair (ChorusParameters::stereoModeId, (float) ChorusParameters::StereoMode::dual) })
+                {
+                    auto* parameter = plugin.getValueTreeState().getParameter (id);
+                    parameter->setValueNotifyingHost (parameter->convertTo0to1 (value));
+                }
+
+                plugin.setRateAndBufferSizeDetails (sampleRate, blockSize);
+                plugin.prepareToPlay (sampleRate, blockSize);
+
+                juce::AudioBuffer<float> buffer (2, blockSize);
+                juce::MidiBuffer midi;
+                buffer.clear();
+
+                const auto* layoutName = delayLineLayout == Waylochorus2AudioProcessor::DelayLineLayout::planar ? "planar" : "interleaved";
+
+                BENCHMARK (std::string (layoutName) + " delay lines, interpolation " + std::to_string ((int) mode) + ", " + std::to_string (numVoices) + " voices")
+                {
+                    plugin.processBlock (buffer, midi);
+                    return buffer.getSample (0, 0);
+                };
+
+                const auto start = juce::Time::getHighResolutionTicks();
+
+                for (int i = 0; i < numBlocks; ++i)
+                    plugin.processBlock (buffer, midi);
+
+                seconds[(int) delayLineLayout] = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+            }
+
+            WARN ("interpolation " << (int) mode << ", " << numVoices << " voices: interleaved delay lines take "
+                                   << 100.0 * seconds[1] / seconds[0] << " % of the planar time");
+        }
+    }
+}
+
+TEST_CASE ("Feedback network")
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 128;
+    constexpr int numBlocks = 5000;
+
+    // stereo in and out, which the network sums to mono like the default stereo mode does
+    for (auto numVoices : { 4, 8, 16, 32 })
+    {
+        double seconds[2] {};
+
+        for (auto enabled : { false, true })
+        {
+            Waylochorus2AudioProcessor plugin;
+            plugin.setNumVoices (numVoices);
+            plugin.setSilenceBypassEnabled (false);
+
+            auto* parameter = plugin.getValueTreeState().getParameter (ChorusParameters::feedbackNetworkId);
+            parameter->setValueNotifyingHost (enabled ? 1.0f : 0.0f);
+
+            plugin.setRateAndBufferSizeDetails (sampleRate, blockSize);
+            plugin.prepareToPlay (sampleRate, blockSize);
+
+            juce::AudioBuffer<float> buffer (2, blockSize);
+            juce::MidiBuffer midi;
+            buffer.clear();
+
+            BENCHMARK (std::string (enabled ? "feedback network" : "plain chorus") + ", " + std::to_string (numVoices) + " voices")
+            {
+                plugin.processBlock (buffer, midi);
+                return buffer.getSample (0, 0);
+            };
+
+            const auto start = juce::Time::getHighResolutionTicks();
+
+            for (int i = 0; i < numBlocks; ++i)
+                plugin.processBlock (buffer, midi);
+
+            seconds[enabled ? 1 : 0] = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+        }
+
+        WARN (numVoices << " voices: the feedback network takes " << 100.0 * seconds[1] / seconds[0] << " % of the plain chorus time");
+    }
+}
+
+TEST_CASE ("BBD emulation")
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 128;
+    constexpr int numBlocks = 5000;
+
+    // what each voice adds, to judge whether a vintage patch fits next to a synth on the same core
+    for (auto numVoices : { 4, 8, 16, 32 })
+    {
+        double seconds[2] {};
+
+        for (auto enabled : { false, true })
+        {
+            Waylochorus2AudioProcessor plugin;
+            plugin.setNumVoices (numVoices);
+            plugin.setSilenceBypassEnabled (false);
+
+            auto* parameter = plugin.getValueTreeState().getParameter (ChorusParameters::bbdId);
+            parameter->setValueNotifyingHost (enabled ? 1.0f : 0.0f);
+
+            plugin.setRateAndBufferSizeDetails (sampleRate, blockSize);
+            plugin.prepareToPlay (sampleRate, blockSize);
+
+            juce::AudioBuffer<float> buffer (2, blockSize);
+            juce::MidiBuffer midi;
+            buffer.clear();
+
+            BENCHMARK (std::string (enabled ? "BBD emulation" : "plain chorus") + ", " + std::to_string (numVoices) + " voices")
+            {
+                plugin.processBlock (buffer, midi);
+                return buffer.getSample (0, 0);
+            };
+
+            const auto start = juce::Time::getHighResolutionTicks();
+
+            for (int i = 0; i < numBlocks; ++i)
+                plugin.processBlock (buffer, midi);
+
+            seconds[enabled ? 1 : 0] = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+        }
+
+        // the share of one core a voice takes at 48 kHz, counting the whole chain
+        const auto audioSeconds = numBlocks * blockSize / sampleRate;
+        const auto perVoice = [&] (double time) { return 100.0 * time / audioSeconds / numVoices; };
+
+        WARN (numVoices << " voices: " << perVoice (seconds[1]) << " % of a core per BBD voice, against "
+                        << perVoice (seconds[0]) << " % per plain voice (" << 100.0 * seconds[1] / seconds[0] << " % of the plain time)");
+    }
+}
+
+TEST_CASE ("Worker threads")
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 128;
+    constexpr int numBlocks = 5000;
+
+    // how the voice rendering scales from the audio thread alone to one thread per core on a Pi
+    for (auto numVoices : { 16, 32 })
+    {
+        double seconds[VoiceWorkerPool::maxThreads] {};
+
+        for (int numThreads = 1; numThreads <= VoiceWorkerPool::maxThreads; ++numThreads)
+        {
+            Waylochorus2AudioProcessor plugin;
+            plugin.setNumWorkerThreads (numThreads - 1);
+            plugin.setNumVoices (numVoices);
+            plugin.setSilenceBypassEnabled (false);
+
+            // a cubic interpolator, where the voices are most of the work
+            auto* parameter = plugin.getValueTreeState().getParameter (ChorusParameters::interpolationId);
+            parameter->setValueNotifyingHost (parameter->convertTo0to1 (1.0f));
+
+            plugin.setRateAndBufferSizeDetails (sampleRate, blockSize);
+            plugin.prepareToPlay (sampleRate, blockSize);
+
+            juce::AudioBuffer<float> buffer (2, blockSize);
+            juce::MidiBuffer midi;
+            buffer.clear();
+
+            BENCHMARK (std::to_string (numThreads) + " threads, " + std::to_string (numVoices) + " voices")
+            {
+                plugin.processBlock (buffer, midi);
+                return buffer.getSample (0, 0);
+            };
+
+            const auto start = juce::Time::getHighResolutionTicks();
+
+            for (int i = 0; i < numBlocks; ++i)
+                plugin.processBlock (buffer, midi);
+
+            seconds[numThreads - 1] = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+
+            if (plugin.getNumWorkerFallbacks() > 0)
+                WARN (numThreads << " threads, " << numVoices << " voices: the workers fell behind " << plugin.getNumWorkerFallbacks() << " times");
+        }
+
+        WARN (numVoices << " voices: 2, 3 and 4 threads take " << 100.0 * seconds[1] / seconds[0] << " %, "
+                        << 100.0 * seconds[2] / seconds[0] << " % and " << 100.0 * seconds[3] / seconds[0] << " % of the single thread time");
+    }
+}
+
+TEST_CASE ("Eco tiers")
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 128;
+    constexpr int numBlocks = 5000;
+
+    // what each tier saves on a Hermite chorus, the tiers the auto mode steps through under load
+    for (auto numVoices : { 8, 32 })
+    {
+        double seconds[EcoMode::maxTier + 1] {};
+
+        for (int tier = 0; tier <= EcoMode::maxTier; ++tier)
+        {
+            Waylochorus2AudioProcessor plugin;
+            plugin.setNumVoices (numVoices);
+            plugin.setSilenceBypassEnabled (false);
+
+            auto* interpolation = plugin.getValueTreeState().getParameter (ChorusParameters::interpolationId);
+            interpolation->setValueNotifyingHost (interpolation->convertTo0to1 (1.0f));
+
+            // off, then the fixed tiers, which come after auto
+            auto* eco = plugin.getValueTreeState().getParameter (ChorusParameters::ecoId);
+            eco->setValueNotifyingHost (eco->convertTo0to1 (tier == 0 ? 0.0f : (float) (tier + 1)));
+
+            plugin.setRateAndBufferSizeDetails (sampleRate, blockSize);
+            plugin.prepareToPlay (sampleRate, blockSize);
+
+            juce::AudioBuffer<float> buffer (2, blockSize);
+            juce::MidiBuffer midi;
+            buffer.clear();
+
+            BENCHMARK ("eco tier " + std::to_string (tier) + ", " + std::to_string (numVoices) + " voices")
+            {
+                plugin.processBlock (buffer, midi);
+                return buffer.getSample (0, 0);
+            };
+
+            const auto start = juce::Time::getHighResolutionTicks();
+
+            for (int i = 0; i < numBlocks; ++i)
+                plugin.processBlock (buffer, midi);
+
+            seconds[tier] = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+        }
+
+        WARN (numVoices << " voices: eco tiers 1, 2 and 3 take " << 100.0 * seconds[1] / seconds[0] << " %, "
+                        << 100.0 * seconds[2] / seconds[0] << " % and " << 100.0 * seconds[3] / seconds[0] << " % of the full quality time");
+    }
+}
+
+TEST_CASE ("Idle processing")
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 128;
+    constexpr int numBlocks = 20000;
+
+    // silent input, long after the tail has gone: what an idle chain on a Zynthian costs
+    for (auto numVoices : { 4, 32 })
+    {
+        double seconds[2] {};
+
+        for (auto bypass : { false, true })
+        {
+            Waylochorus2AudioProcessor plugin;
+            plugin.setNumVoices (numVoices);
+            plugin.setSilenceBypassEnabled (bypass);
+            plugin.setRateAndBufferSizeDetails (sampleRate, blockSize);
+            plugin.prepareToPlay (sampleRate, blockSize);
+
+            juce::AudioBuffer<float> buffer (2, blockSize);
+            juce::MidiBuffer midi;
+            buffer.clear();
+
+            // play out the tail first
+            for (int i = 0; i < 100; ++i)
+                plugin.processBlock (buffer, midi);
+
+            BENCHMARK (std::string (bypass ? "bypassed" : "processed") + " silence, " + std::to_string (numVoices) + " voices")
+            {
+                plugin.processBlock (buffer, midi);
+                return buffer.getSample (0, 0);
+            };
+
+            const auto start = juce::Time::getHighResolutionTicks();
+
+            for (int i = 0; i < numBlocks; ++i)
+                plugin.processBlock (buffer, midi);
+
+            seconds[bypass ? 1 : 0] = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+        }
+
+        WARN (numVoices << " voices: idle blocks take " << 100.0 * seconds[1] / seconds[0] << " % of the time of processed silence");
+    }
+}
+
+TEST_CASE ("Delay line storage")
+{
+    constexpr int blockSize = 128;
+    constexpr int numBlocks = 20000;
+    constexpr int maxDelayInSamples = 2400; // 50 ms at 48 kHz
+
+    // the write and the voice reads of the vectorised kernel, on float and on 16-bit storage
+    const auto run = [&] (auto delayLine, int numVoices, std::vector<float>& output)
+    {
+        delayLine.prepare (maxDelayInSamples, blockSize);
+
+        alignas (64) float input[blockSize];
+        alignas (64) float mix[blockSize];
+        std::vector<float> delays ((size_t) (numVoices * blockSize));
+        output.clear();
+
+        for (int i = 0; i < blockSize; ++i)
+            input[i] = 0.5f * (float) std::sin (0.13 * i);
+
+        const auto start = juce::Time::getHighResolutionTicks();
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            // each voice sweeps around its own ~1700 sample window, like the chorus does
+            for (int v = 0; v < numVoices; ++v)
+                for (int i = 0; i < blockSize; ++i)
+                    delays[(size_t) (v * blockSize + i)] = 1000.0f + 850.0f * (float) std::sin (0.00005 * (block * blockSize + i) + v);
+
+            delayLine.writeBlock (input, blockSize);
+            std::fill (std::begin (mix), std::end (mix), 0.0f);
+
+            for (int v = 0; v < numVoices; ++v)
+                delayLine.template addTap<Interpolation::Hermite> (delays.data() + v * blockSize, 1.0f / (float) numVoices, 0.0f, mix, blockSize);
+
+            if (block >= numBlocks - 100)
+                output.insert (output.end(), mix, mix + blockSize);
+        }
+
+        return juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+    };
+
+    for (auto numVoices : { 4, 32 })
+    {
+        std::vector<float> reference, compact;
+        const auto floatSeconds = run (DelayLine<float>(), numVoices, reference);
+        const auto compactSeconds = run (DelayLine<float, std::int16_t>(), numVoices, compact);
+
+        double signal = 0.0, noise = 0.0;
+
+        for (size_t i = 0; i < reference.size(); ++i)
+        {
+            signal += (double) reference[i] * reference[i];
+            noise += std::pow ((double) compact[i] - reference[i], 2.0);
+        }
+
+        WARN (numVoices << " voices: 16-bit storage takes " << 100.0 * compactSeconds / floatSeconds << " % of the float time, SNR "
+                        << 10.0 * std::log10 (signal / noise) << " dB at -6 dBFS");
+    }
+}
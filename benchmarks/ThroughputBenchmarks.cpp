@@ -0,0 +1,123 @@
+#include "PluginProcessor.h"
+#include "helpers/throughput_report.h"
+#include "catch2/catch_test_macros.hpp"
+
+/* Drives processBlock over the whole matrix of sample rates, block sizes,
+ * channel layouts, voice counts and sample precisions, and writes the results to
+ * throughput.csv and throughput.json.
+ *
+ * Set WAYLOCHORUS_BENCHMARK_OUTPUT to choose where the files go (the default
+ * is the working directory), and WAYLOCHORUS_BENCHMARK_LABEL to tag the
+ * results with a build or machine name (the default is the host name).
+ */
+TEST_CASE ("Processing throughput")
+{
+    // every configuration processes this much audio, the best of a few runs is kept
+    constexpr double secondsOfAudio = 0.25;
+    constexpr int numRuns = 3;
+
+    struct Layout
+    {
+        const char* name;
+        juce::AudioChannelSet input, output;
+        ChorusParameters::StereoMode stereoMode = ChorusParameters::StereoMode::monoSum;
+        Waylochorus2AudioProcessor::DelayLineLayout delayLineLayout = Waylochorus2AudioProcessor::DelayLineLayout::interleaved;
+    };
+
+    const Layout layouts[] = { { "mono", juce::AudioChannelSet::mono(), juce::AudioChannelSet::mono() },
+                               { "mono to stereo", juce::AudioChannelSet::mono(), juce::AudioChannelSet::stereo() },
+                               { "stereo", juce::AudioChannelSet::stereo(), juce::AudioChannelSet::stereo() },
+                               { "stereo dual", juce::AudioChannelSet::stereo(), juce::AudioChannelSet::stereo(), ChorusParameters::StereoMode::dual },
+                               { "stereo dual planar", juce::AudioChannelSet::stereo(), juce::AudioChannelSet::stereo(), ChorusParameters::StereoMode::dual,
+                                 Waylochorus2AudioProcessor::DelayLineLayout::planar } };
+
+    ThroughputReport report;
+    report.setBuildInfo (juce::SystemStats::getEnvironmentVariable ("WAYLOCHORUS_BENCHMARK_LABEL", juce::SystemStats::getComputerName()).toStdString(),
+                         juce::SystemStats::getCpuModel().toStdString(),
+                         (int) juce::dsp::SIMDRegister<float>::size());
+
+    // both precisions go through the same kernels; a 64-bit host gets the double one
+    const auto measure = [&] (auto sampleType, const char* precision)
+    {
+        using SampleType = decltype (sampleType);
+
+        for (const auto& layout : layouts)
+        {
+            for (auto sampleRate : { 44100.0, 48000.0, 88200.0, 96000.0, 176400.0, 192000.0 })
+            {
+                for (auto blockSize : { 16, 32, 64, 128, 256, 512, 1024, 2048, 4096 })
+                {
+                    for (auto numVoices : { 2, 4, 8, 16, 32 })
+                    {
+                        Waylochorus2AudioProcessor plugin;
+                        plugin.setBusesLayout ({ { layout.input }, { layout.output } });
+                        plugin.setNumVoices (numVoices);
+                        plugin.setDelayLineLayout (layout.delayLineLayout);
+
+                        auto* stereoMode = plugin.getValueTreeState().getParameter (ChorusParameters::stereoModeId);
+                        stereoMode->setValueNotifyingHost (stereoMode->convertTo0to1 ((float) layout.stereoMode));
+
+                        plugin.setProcessingPrecision (std::is_same_v<SampleType, double> ? juce::AudioProcessor::doublePrecision
+                                                                                           : juce::AudioProcessor::singlePrecision);
+                        plugin.setRateAndBufferSizeDetails (sampleRate, blockSize);
+                        plugin.prepareToPlay (sampleRate, blockSize);
+
+                        const auto numInputChannels = layout.input.size();
+                        const auto numChannels = layout.output.size();
+                        const auto numBlocks = juce::jmax (1, (int) (secondsOfAudio * sampleRate) / blockSize);
+
+                        // noise rather than silence, so nothing can take a shortcut
+                        juce::AudioBuffer<SampleType> input (numChannels, blockSize);
+                        juce::Random random (1);
+                        input.clear();
+
+                        for (int channel = 0; channel < numInputChannels; ++channel)
+                            for (int i = 0; i < blockSize; ++i)
+                                input.setSample (channel, i, (SampleType) (random.nextFloat() * 2.0f - 1.0f));
+
+                        juce::AudioBuffer<SampleType> buffer (numChannels, blockSize);
+                        juce::MidiBuffer midi;
+                        auto bestSeconds = std::numeric_limits<double>::max();
+
+                        for (int run = 0; run < numRuns; ++run)
+                        {
+                            const auto start = juce::Time::getHighResolutionTicks();
+
+                            for (int block = 0; block < numBlocks; ++block)
+                            {
+                                buffer.makeCopyOf (input, true);
+                                plugin.processBlock (buffer, midi);
+                            }
+
+                            bestSeconds = juce::jmin (bestSeconds, juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start));
+                        }
+
+                        const auto numSamples = (double) numBlocks * blockSize;
+
+                        ThroughputReport::Result result;
+                        result.sampleRate = sampleRate;
+                        result.blockSize = blockSize;
+                        result.layout = layout.name;
+                        result.precision = precision;
+                        result.numChannels = numChannels;
+                        result.numVoices = numVoices;
+                        result.nanosecondsPerSample = bestSeconds * 1.0e9 / numSamples;
+                        result.realtimeFactor = (numSamples / sampleRate) / bestSeconds;
+
+                        report.add (result);
+                    }
+                }
+            }
+        }
+    };
+
+    measure (float(), "float");
+    measure (double(), "double");
+
+    const auto directory = juce::File (juce::SystemStats::getEnvironmentVariable ("WAYLOCHORUS_BENCHMARK_OUTPUT",
+                                                                                  juce::File::getCurrentWorkingDirectory().getFullPathName()));
+    const auto baseName = directory.getChildFile ("throughput").getFullPathName().toStdString();
+
+    CHECK (report.write (baseName));
+    WARN ("wrote " << report.getResults().size() << " results to " << baseName << ".csv and .json");
+}
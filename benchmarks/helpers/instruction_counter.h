@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+
+#if defined(__linux__)
+    #include <linux/perf_event.h>
+    #include <sys/ioctl.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+/* Counts the CPU instructions retired by this thread between start() and stop().
+ *
+ * Uses perf_event_open on Linux. Elsewhere, or when the kernel doesn't allow
+ * user space counters (see /proc/sys/kernel/perf_event_paranoid), isAvailable()
+ * returns false and stop() returns 0.
+ *
+ * Instruction counts are much steadier than timings on a busy Pi, which makes
+ * them the better number for comparing two builds of the same kernel.
+ */
+class InstructionCounter
+{
+public:
+    InstructionCounter()
+    {
+#if defined(__linux__)
+        perf_event_attr attr {};
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof (attr);
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        fd = (int) syscall (SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+    }
+
+    ~InstructionCounter()
+    {
+#if defined(__linux__)
+        if (fd >= 0)
+            close (fd);
+#endif
+    }
+
+    bool isAvailable() const { return fd >= 0; }
+
+    void start()
+    {
+#if defined(__linux__)
+        if (fd >= 0)
+        {
+            ioctl (fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl (fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    uint64_t stop()
+    {
+        uint64_t count = 0;
+
+#if defined(__linux__)
+        if (fd >= 0)
+        {
+            ioctl (fd, PERF_EVENT_IOC_DISABLE, 0);
+
+            if (read (fd, &count, sizeof (count)) != (ssize_t) sizeof (count))
+                count = 0;
+        }
+#endif
+
+        return count;
+    }
+
+private:
+    int fd = -1;
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/* Collects processBlock throughput measurements and writes them out as CSV and JSON.
+ *
+ * One row per configuration. nanosecondsPerSample is the CPU time per sample
+ * frame (all channels), realtimeFactor is how many seconds of audio are
+ * processed per second of CPU time. Anything below 1 can't keep up.
+ *
+ * The build fields go into every CSV row and the JSON header, so results from
+ * different builds and machines can be concatenated and compared.
+ */
+class ThroughputReport
+{
+public:
+    struct Result
+    {
+        double sampleRate = 0.0;
+        int blockSize = 0;
+        std::string layout;
+        std::string precision;
+        int numChannels = 0;
+        int numVoices = 0;
+        double nanosecondsPerSample = 0.0;
+        double realtimeFactor = 0.0;
+    };
+
+    void setBuildInfo (std::string newLabel, std::string newCpu, int newSimdLanes)
+    {
+        label = std::move (newLabel);
+        cpu = std::move (newCpu);
+        simdLanes = newSimdLanes;
+    }
+
+    void add (const Result& result) { results.push_back (result); }
+    const std::vector<Result>& getResults() const { return results; }
+
+    std::string toCsv() const
+    {
+        std::ostringstream out;
+        out << "label,cpu,simd_lanes,sample_rate,block_size,layout,precision,channels,voices,ns_per_sample,realtime_factor\n";
+
+        for (const auto& r : results)
+            out << quoted (label) << ',' << quoted (cpu) << ',' << simdLanes << ','
+                << r.sampleRate << ',' << r.blockSize << ',' << r.layout << ',' << r.precision << ',' << r.numChannels << ',' << r.numVoices << ','
+                << r.nanosecondsPerSample << ',' << r.realtimeFactor << '\n';
+
+        return out.str();
+    }
+
+    std::string toJson() const
+    {
+        std::ostringstream out;
+        out << "{\n  \"label\": " << quoted (label) << ",\n  \"cpu\": " << quoted (cpu)
+            << ",\n  \"simd_lanes\": " << simdLanes << ",\n  \"results\": [";
+
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const auto& r = results[i];
+            out << (i == 0 ? "\n" : ",\n")
+                << "    { \"sample_rate\": " << r.sampleRate << ", \"block_size\": " << r.blockSize
+                << ", \"layout\": " << quoted (r.layout) << ", \"precision\": " << quoted (r.precision) << ", \"channels\": " << r.numChannels << ", \"voices\": " << r.numVoices
+                << ", \"ns_per_sample\": " << r.nanosecondsPerSample << ", \"realtime_factor\": " << r.realtimeFactor << " }";
+        }
+
+        out << "\n  ]\n}\n";
+        return out.str();
+    }
+
+    /* Writes <baseName>.csv and <baseName>.json, returns false if either couldn't be written. */
+    bool write (const std::string& baseName) const
+    {
+        std::ofstream csv (baseName + ".csv");
+        csv << toCsv();
+
+        std::ofstream json (baseName + ".json");
+        json << toJson();
+
+        return csv.good() && json.good();
+    }
+
+private:
+    // JSON strings and CSV fields both survive being double quoted, as long as the text has no quotes of its own
+    static std::string quoted (const std::string& text)
+    {
+        std::string result = "\"";
+
+        for (auto c : text)
+            if (c != '"' && c != '\\')
+                result += c;
+
+        return result + "\"";
+    }
+
+    std::string label;
+    std::string cpu;
+    int simdLanes = 1;
+    std::vector<Result> results;
+};
@@ -0,0 +1,216 @@
+// Worst case execution time soak test for processBlock.
+//
+// Runs the processor for millions of blocks at a JACK-like buffer size, times
+// every call, and reports the tail of the distribution against the real-time
+// budget (block size / sample rate). Means hide the occasional slow block that
+// causes an xrun; this looks for exactly those.
+//
+// Options (all optional):
+//   --blocks=N            number of processBlock calls (default 1000000)
+//   --rate=HZ             sample rate (default 48000)
+//   --block-size=N        samples per call (default 128)
+//   --voices=N            chorus voices (default 4)
+//   --interpolation=N     0 linear, 1 hermite, 2 lagrange, 3 allpass (default 0)
+//   --input=KIND          noise, silence, or bursts: 10 s of silence then 1 s of noise, repeated (default noise)
+//   --automate=N          change a parameter every N blocks, like host automation (default off)
+//   --cpu=N               pin the thread to this core (Linux)
+//   --fifo=PRIORITY       run under SCHED_FIFO at this priority, needs rtprio rights (Linux)
+//   --lock-memory         mlockall, so nothing gets paged out (Linux)
+//   --histogram=FILE      write the histogram as CSV
+//   --limit=FRACTION      exit with 1 if the slowest call took longer than this fraction of the budget
+
+#include "PluginProcessor.h"
+#include "latency_histogram.h"
+#include "../tests/helpers/test_helpers.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+
+#if defined(__linux__)
+    #include <pthread.h>
+    #include <sched.h>
+    #include <sys/mman.h>
+#endif
+
+namespace
+{
+    struct Options
+    {
+        int numBlocks = 1000000;
+        double sampleRate = 48000.0;
+        int blockSize = 128;
+        int numVoices = 4;
+        int interpolation = 0;
+        juce::String input = "noise";
+        int automateEvery = 0;
+        int cpu = -1;
+        int fifoPriority = 0;
+        bool lockMemory = false;
+        juce::String histogramFile;
+        double limit = 0.0;
+
+        explicit Options (const juce::ArgumentList& args)
+        {
+            const auto intOption = [&] (const char* name, int fallback) {
+                return args.containsOption (name) ? args.getValueForOption (name).getIntValue() : fallback;
+            };
+
+            numBlocks = intOption ("--blocks", numBlocks);
+            sampleRate = args.containsOption ("--rate") ? args.getValueForOption ("--rate").getDoubleValue() : sampleRate;
+            blockSize = intOption ("--block-size", blockSize);
+            numVoices = intOption ("--voices", numVoices);
+            interpolation = intOption ("--interpolation", interpolation);
+            input = args.containsOption ("--input") ? args.getValueForOption ("--input") : input;
+            automateEvery = intOption ("--automate", automateEvery);
+            cpu = intOption ("--cpu", cpu);
+            fifoPriority = intOption ("--fifo", fifoPriority);
+            lockMemory = args.containsOption ("--lock-memory");
+            histogramFile = args.getValueForOption ("--histogram");
+            limit = args.containsOption ("--limit") ? args.getValueForOption ("--limit").getDoubleValue() : limit;
+        }
+    };
+
+    void setUpThread (const Options& options)
+    {
+#if defined(__linux__)
+        if (options.cpu >= 0)
+        {
+            cpu_set_t cpus;
+            CPU_ZERO (&cpus);
+            CPU_SET (options.cpu, &cpus);
+
+            if (pthread_setaffinity_np (pthread_self(), sizeof (cpus), &cpus) != 0)
+                std::printf ("warning: couldn't pin to cpu %d\n", options.cpu);
+        }
+
+        if (options.fifoPriority > 0)
+        {
+            sched_param param {};
+            param.sched_priority = options.fifoPriority;
+
+            if (pthread_setschedparam (pthread_self(), SCHED_FIFO, &param) != 0)
+                std::printf ("warning: couldn't switch to SCHED_FIFO, check the rtprio limit\n");
+        }
+
+        if (options.lockMemory && mlockall (MCL_CURRENT | MCL_FUTURE) != 0)
+            std::printf ("warning: couldn't lock memory, check the memlock limit\n");
+#else
+        if (options.cpu >= 0 || options.fifoPriority > 0 || options.lockMemory)
+            std::printf ("warning: --cpu, --fifo and --lock-memory are only supported on Linux\n");
+#endif
+    }
+
+    void fillInput (juce::AudioBuffer<float>& buffer, const Options& options, int block, juce::Random& random)
+    {
+        // bursts: ten seconds of silence then one of noise, to catch anything that goes cold or denormal in between
+        const auto blocksPerSecond = options.sampleRate / options.blockSize;
+        const auto isSilent = options.input == "silence"
+                           || (options.input == "bursts" && std::fmod ((double) block / blocksPerSecond, 11.0) < 10.0);
+
+        if (isSilent)
+        {
+            buffer.clear();
+            return;
+        }
+
+        for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+            for (int i = 0; i < buffer.getNumSamples(); ++i)
+                buffer.setSample (channel, i, random.nextFloat() * 0.5f - 0.25f);
+    }
+
+    void automate (Waylochorus2AudioProcessor& plugin, const Options& options, int step)
+    {
+        // walk through the things a user is likely to move while playing
+        switch (step % 4)
+        {
+            case 0:  setParameter (plugin, ChorusParameters::numVoicesId, (float) (step % 8 < 4 ? options.numVoices * 2 : options.numVoices)); break;
+            case 1:  setParameter (plugin, juce::String (ChorusParameters::rateId) + "1", step % 8 < 4 ? 2.0f : 0.65f); break;
+            case 2:  setParameter (plugin, ChorusParameters::depthMaxId, step % 8 < 4 ? 0.2f : 0.1f); break;
+            default: setParameter (plugin, ChorusParameters::lfoShapeId, (float) (step / 4 % 3)); break;
+        }
+    }
+
+    void printLine (const char* name, double nanoseconds, double budgetNanoseconds)
+    {
+        std::printf ("%-10s %10.1f us  %6.1f %% of budget\n", name, nanoseconds / 1000.0, 100.0 * nanoseconds / budgetNanoseconds);
+    }
+}
+
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI gui;
+
+    const Options options (juce::ArgumentList (argc, argv));
+    const auto budgetNanoseconds = 1.0e9 * options.blockSize / options.sampleRate;
+
+    // 0.1 % of the budget per bucket, up to four times the budget
+    LatencyHistogram histogram ((int64_t) (budgetNanoseconds / 1000.0), (int64_t) (4.0 * budgetNanoseconds));
+
+    Waylochorus2AudioProcessor plugin;
+    plugin.setNumVoices (options.numVoices);
+    setParameter (plugin, ChorusParameters::interpolationId, (float) options.interpolation);
+    plugin.setRateAndBufferSizeDetails (options.sampleRate, options.blockSize);
+    plugin.prepareToPlay (options.sampleRate, options.blockSize);
+
+    juce::AudioBuffer<float> buffer (2, options.blockSize);
+    juce::MidiBuffer midi;
+    juce::Random random (1);
+
+    std::printf ("%d blocks of %d samples at %.0f Hz, %d voices, interpolation %d, %s input, budget %.1f us\n",
+                 options.numBlocks, options.blockSize, options.sampleRate, options.numVoices, options.interpolation,
+                 options.input.toRawUTF8(), budgetNanoseconds / 1000.0);
+
+    setUpThread (options);
+
+    int64_t firstCall = 0;
+
+    for (int block = 0; block < options.numBlocks; ++block)
+    {
+        fillInput (buffer, options, block, random);
+
+        if (options.automateEvery > 0 && block > 0 && block % options.automateEvery == 0)
+            automate (plugin, options, block / options.automateEvery);
+
+        const auto start = std::chrono::steady_clock::now();
+        plugin.processBlock (buffer, midi);
+        const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now() - start).count();
+
+        // the first call touches everything for the first time, keep it out of the histogram
+        if (block == 0)
+            firstCall = nanoseconds;
+        else
+            histogram.record (nanoseconds);
+    }
+
+    printLine ("first call", (double) firstCall, budgetNanoseconds);
+    printLine ("mean", histogram.getMean(), budgetNanoseconds);
+    printLine ("p50", (double) histogram.getPercentile (0.5), budgetNanoseconds);
+    printLine ("p99", (double) histogram.getPercentile (0.99), budgetNanoseconds);
+    printLine ("p99.9", (double) histogram.getPercentile (0.999), budgetNanoseconds);
+    printLine ("p99.99", (double) histogram.getPercentile (0.9999), budgetNanoseconds);
+    printLine ("max", (double) histogram.getSlowest(), budgetNanoseconds);
+
+    std::printf ("%llu calls over half the budget, %llu over the budget\n",
+                 (unsigned long long) histogram.countAbove ((int64_t) (budgetNanoseconds / 2.0)),
+                 (unsigned long long) histogram.countAbove ((int64_t) budgetNanoseconds));
+
+    if (options.histogramFile.isNotEmpty())
+    {
+        std::ofstream csv (options.histogramFile.toStdString());
+        csv << "bucket_start_ns,count\n";
+
+        for (size_t i = 0; i < histogram.getBuckets().size(); ++i)
+            if (histogram.getBuckets()[i] > 0)
+                csv << (int64_t) i * histogram.getBucketWidth() << ',' << histogram.getBuckets()[i] << '\n';
+
+        csv << "overflow," << histogram.getOverflow() << '\n';
+    }
+
+    if (options.limit > 0.0 && (double) histogram.getSlowest() > options.limit * budgetNanoseconds)
+    {
+        std::printf ("FAILED: slowest call is over %.1f %% of the budget\n", 100.0 * options.limit);
+        return 1;
+    }
+
+    return 0;
+}
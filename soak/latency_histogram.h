@@ -0,0 +1,81 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+/* Fixed-width histogram of callback times, in nanoseconds.
+ *
+ * The buckets cover 0 to maxNanoseconds; anything slower lands in the overflow
+ * count, and the exact slowest time is kept separately, so the tail is never
+ * lost. All the memory is allocated up front, recording is a divide and an
+ * increment.
+ */
+class LatencyHistogram
+{
+public:
+    LatencyHistogram (int64_t bucketWidthNanoseconds, int64_t maxNanoseconds)
+        : bucketWidth (std::max<int64_t> (1, bucketWidthNanoseconds)),
+          buckets ((size_t) (maxNanoseconds / bucketWidth + 1), 0)
+    {
+    }
+
+    void record (int64_t nanoseconds)
+    {
+        const auto bucket = (size_t) (nanoseconds / bucketWidth);
+
+        if (bucket < buckets.size())
+            ++buckets[bucket];
+        else
+            ++overflow;
+
+        ++count;
+        total += nanoseconds;
+        slowest = std::max (slowest, nanoseconds);
+    }
+
+    /* The time below which the given fraction of calls finished, to the nearest bucket (upper edge).
+     * Returns the slowest time if the percentile falls in the overflow.
+     */
+    int64_t getPercentile (double fraction) const
+    {
+        const auto target = (uint64_t) std::max (1.0, fraction * (double) count);
+        uint64_t seen = 0;
+
+        for (size_t i = 0; i < buckets.size(); ++i)
+        {
+            seen += buckets[i];
+
+            if (seen >= target)
+                return std::min (slowest, (int64_t) (i + 1) * bucketWidth);
+        }
+
+        return slowest;
+    }
+
+    /* How many calls took longer than the given time, to the nearest bucket. */
+    uint64_t countAbove (int64_t nanoseconds) const
+    {
+        uint64_t result = overflow;
+
+        for (auto i = (size_t) (nanoseconds / bucketWidth + 1); i < buckets.size(); ++i)
+            result += buckets[i];
+
+        return result;
+    }
+
+    uint64_t getCount() const { return count; }
+    int64_t getSlowest() const { return slowest; }
+    double getMean() const { return count > 0 ? (double) total / (double) count : 0.0; }
+    int64_t getBucketWidth() const { return bucketWidth; }
+    const std::vector<uint64_t>& getBuckets() const { return buckets; }
+    uint64_t getOverflow() const { return overflow; }
+
+private:
+    int64_t bucketWidth;
+    std::vector<uint64_t> buckets;
+    uint64_t overflow = 0;
+    uint64_t count = 0;
+    int64_t total = 0;
+    int64_t slowest = 0;
+};
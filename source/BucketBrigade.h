@@ -0,0 +1,382 @@
+/*
+  ==============================================================================
+
+    BucketBrigade.h
+
+    The filters and compander around a bucket brigade delay chip.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "ChorusVoiceTable.h"
+
+//==============================================================================
+/**
+    Models what a bucket brigade (BBD) chip and the circuit around it do to
+    the chorus voices, for the vintage mode.
+
+    A BBD holds numStages samples taken at its clock rate, so a voice's delay
+    sets its clock, and its clock sets its bandwidth. In the hardware the
+    input goes through an anti-alias filter and the compressor half of a 2:1
+    compander before the chip. The chip's output goes through a reconstruction
+    filter and the expander half.
+
+    Here the input side runs once on the shared input before it is written to
+    the delay line. It is a fourth order lowpass, the compressor, and a soft
+    clip for the chip running out of headroom. Each voice is one chip, so the
+    output side runs on every voice read. That is a fourth order lowpass at the
+    voice's clock dependent cutoff, then the expander. The expander follows
+    what comes out of the filter rather than what went into the compressor,
+    so it breathes a little the way the real thing does.
+
+    The voice side keeps its state per voice in arrays, and runs the same code
+    on plain samples or juce::dsp::SIMDRegister, a register's worth of voices
+    at a time. The filter coefficients are worked out once per block by
+    beginBlock(). The sample loops only multiply and add, apart from one
+    square root per input sample in the compressor.
+*/
+template <typename SampleType>
+class BucketBrigade
+{
+public:
+    //==============================================================================
+    /** Biquads per lowpass, each a pair of poles of a fourth order Butterworth. */
+    static constexpr int numSections = 2;
+
+    static constexpr int defaultNumStages = 1024;
+
+    /** The reconstruction cutoff as a fraction of the clock rate, a little under the clock's Nyquist frequency. */
+    static constexpr double clockBandwidth = 0.4;
+
+    /** How fast the compander follows the level. */
+    static constexpr double envelopeTimeSeconds = 0.01;
+
+    //==============================================================================
+    BucketBrigade() = default;
+
+    /** Allocates the working buffers for blocks of up to maxBlockSize and clears
+        the state. Allocates, so it isn't realtime safe.
+    */
+    void prepare (double sampleRate, int maxBlockSize)
+    {
+        jassert (sampleRate > 0.0 && maxBlockSize > 0);
+
+        mSampleRate = sampleRate;
+        mMaxCutoff = juce::jmin (20000.0, 0.45 * sampleRate);
+        mEnvelopeCoefficient = (SampleType) (1.0 - std::exp (-1.0 / (envelopeTimeSeconds * sampleRate)));
+
+        // the processed input, then a row per voice, then the same samples a frame of voices per sample
+        constexpr int cacheLineSize = 64;
+        constexpr int samplesPerCacheLine = cacheLineSize / (int) sizeof (SampleType);
+        mRowStride = (maxBlockSize + samplesPerCacheLine - 1) & ~(samplesPerCacheLine - 1);
+
+        const auto numSamples = (size_t) ((1 + maxVoices) * mRowStride + maxBlockSize * maxVoices);
+        mStorage.allocate (numSamples * sizeof (SampleType) + cacheLineSize, true);
+
+        const auto address = reinterpret_cast<std::uintptr_t> (mStorage.get());
+        mInputRow = reinterpret_cast<SampleType*> ((address + cacheLineSize - 1) & ~(std::uintptr_t) (cacheLineSize - 1));
+        mFrames = mInputRow + (1 + maxVoices) * mRowStride;
+
+        // every voice starts with working coefficients, the idle ones included
+        for (int v = 0; v < maxVoices; ++v)
+            setVoiceLowpass (v, mMaxCutoff);
+
+        setLowpass (mMaxCutoff, mInputB0, mInputA1, mInputA2, 1);
+        clear();
+    }
+
+    /** Silences the filters and lets the compander settle from nothing. */
+    void clear() noexcept
+    {
+        for (int section = 0; section < numSections; ++section)
+        {
+            std::fill (std::begin (mVoiceS1[section]), std::end (mVoiceS1[section]), SampleType());
+            std::fill (std::begin (mVoiceS2[section]), std::end (mVoiceS2[section]), SampleType());
+        }
+
+        std::fill (std::begin (mVoiceEnvelope), std::end (mVoiceEnvelope), SampleType());
+        std::fill (std::begin (mInputS1), std::end (mInputS1), SampleType());
+        std::fill (std::begin (mInputS2), std::end (mInputS2), SampleType());
+        mInputEnvelope = 0;
+    }
+
+    /** Sets how long the modelled chip is. Longer chips clock faster for the same delay, so they sound brighter. */
+    void setNumStages (int newNumStages) noexcept { mNumStages = newNumStages; }
+    int getNumStages() const noexcept { return mNumStages; }
+
+    /** The reconstruction cutoff in Hz for a voice reading at delayInSamples. */
+    double getCutoff (float delayInSamples) const noexcept
+    {
+        // the chip holds numStages / 2 samples, so the clock runs at numStages / (2 * delay)
+        const auto clockRate = (double) mNumStages * mSampleRate / (2.0 * juce::jmax (1.0f, delayInSamples));
+        return juce::jmin (clockBandwidth * clockRate, mMaxCutoff);
+    }
+
+    //==============================================================================
+    /** Sets the filters for the next numSamples samples, from the delay times the
+        voices read at. Voice v's delays start at delayTimes + v * stride.
+    */
+    void beginBlock (const float* delayTimes, int stride, int numVoices, int numSamples) noexcept
+    {
+        jassert (numSamples > 0 && numVoices <= maxVoices);
+
+        auto highestCutoff = 0.0;
+
+        for (int v = 0; v < numVoices; ++v)
+        {
+            // the delay glides through the block, so the clock in the middle of it stands for the whole block
+            const auto* delays = delayTimes + v * stride;
+            const auto cutoff = getCutoff (0.5f * (delays[0] + delays[numSamples - 1]));
+
+            setVoiceLowpass (v, cutoff);
+            highestCutoff = juce::jmax (highestCutoff, cutoff);
+        }
+
+        // the input filter has to let through what the fastest clocked voice can carry
+        setLowpass (highestCutoff, mInputB0, mInputA1, mInputA2, 1);
+    }
+
+    /** Filters, compresses and clips numSamples of input into output, ready to be
+        written to the delay line. Input and output may be the same.
+    */
+    void processInput (const SampleType* input, SampleType* output, int numSamples) noexcept
+    {
+        auto envelope = mInputEnvelope;
+
+        for (int n = 0; n < numSamples; ++n)
+        {
+            auto x = input[n];
+
+            for (int section = 0; section < numSections; ++section)
+                x = filter (x, mInputB0[section], mInputA1[section], mInputA2[section], mInputS1[section], mInputS2[section]);
+
+            // 2:1 in dB: dividing by the square root of the level leaves the square root of the level
+            envelope += mEnvelopeCoefficient * (std::abs (x) - envelope);
+            output[n] = saturate (x / std::sqrt (envelope + compressorFloor));
+        }
+
+        mInputEnvelope = envelope;
+    }
+
+    /** The row processInput() can write into, for blocks of up to the prepared size. */
+    SampleType* getInputRow() const noexcept { return mInputRow; }
+
+    /** The row the block kernel reads voice v into before gatherFrames(), SIMD aligned. */
+    SampleType* getVoiceRow (int voice) const noexcept { return mInputRow + (1 + voice) * mRowStride; }
+
+    /** Sample n of every voice, side by side; the sample by sample kernel reads into it directly. */
+    SampleType* getFrame (int n) const noexcept { return mFrames + n * maxVoices; }
+
+    /** Copies the voice rows into the frames, with silence in the lanes after the
+        last voice that a register's worth of voices reaches into.
+    */
+    void gatherFrames (int numVoices, int numSamples) noexcept
+    {
+        const auto numLanes = roundUpToRegister (numVoices);
+
+        for (int v = 0; v < numLanes; ++v)
+        {
+            const auto* row = getVoiceRow (v);
+
+            for (int n = 0; n < numSamples; ++n)
+                mFrames[n * maxVoices + v] = v < numVoices ? row[n] : SampleType();
+        }
+    }
+
+    //==============================================================================
+    /** Runs each voice's reconstruction filter and expander over its samples in
+        the frames, in place. Value is SampleType for one voice at a time, or
+        juce::dsp::SIMDRegister<SampleType> for a register's worth.
+    */
+    template <typename Value>
+    void processVoices (int numVoices, int numSamples) noexcept
+    {
+        constexpr auto numLanes = getNumLanes<Value>();
+        const auto envelopeCoefficient = mEnvelopeCoefficient;
+
+        // the state stays in registers along the block, a group of voices at a time
+        for (int v = 0; v < numVoices; v += numLanes)
+        {
+            Value b0[numSections], a1[numSections], a2[numSections], s1[numSections], s2[numSections], envelope;
+
+            for (int section = 0; section < numSections; ++section)
+            {
+                load (mVoiceB0[section] + v, b0[section]);
+                load (mVoiceA1[section] + v, a1[section]);
+                load (mVoiceA2[section] + v, a2[section]);
+                load (mVoiceS1[section] + v, s1[section]);
+                load (mVoiceS2[section] + v, s2[section]);
+            }
+
+            load (mVoiceEnvelope + v, envelope);
+
+            for (int n = 0; n < numSamples; ++n)
+            {
+                auto* frame = mFrames + n * maxVoices + v;
+                Value x;
+                load (frame, x);
+
+                for (int section = 0; section < numSections; ++section)
+                    x = filter (x, b0[section], a1[section], a2[section], s1[section], s2[section]);
+
+                envelope += (magnitude (x) - envelope) * envelopeCoefficient;
+                store (frame, x * envelope);
+            }
+
+            for (int section = 0; section < numSections; ++section)
+            {
+                store (mVoiceS1[section] + v, s1[section]);
+                store (mVoiceS2[section] + v, s2[section]);
+            }
+
+            store (mVoiceEnvelope + v, envelope);
+        }
+    }
+
+    /** Mixes the processed voices into numSamples samples of destination,
+        replacing what was there. Voice v's gain ramps from gains[v] by
+        gainSteps[v] per sample. Value works as in processVoices().
+    */
+    template <typename Value>
+    void mix (const float* gains, const float* gainSteps, int numVoices, SampleType* destination, int numSamples) const noexcept
+    {
+        constexpr auto numLanes = getNumLanes<Value>();
+        const auto numVoicesToMix = numLanes > 1 ? roundUpToRegister (numVoices) : numVoices;
+
+        // the lanes past the last voice get no gain, so whatever they hold stays out of the mix
+        alignas (64) SampleType firstGains[maxVoices] {};
+        alignas (64) SampleType steps[maxVoices] {};
+
+        for (int v = 0; v < numVoices; ++v)
+        {
+            firstGains[v] = (SampleType) gains[v];
+            steps[v] = (SampleType) gainSteps[v];
+        }
+
+        for (int n = 0; n < numSamples; ++n)
+        {
+            const auto* frame = mFrames + n * maxVoices;
+            auto sum = broadcast<Value> (0);
+
+            for (int v = 0; v < numVoicesToMix; v += numLanes)
+            {
+                Value x, gain, step;
+                load (frame + v, x);
+                load (firstGains + v, gain);
+                load (steps + v, step);
+
+                sum += x * (gain + step * (SampleType) n);
+            }
+
+            destination[n] = total (sum);
+        }
+    }
+
+private:
+    //==============================================================================
+    static constexpr int maxVoices = ChorusVoiceTable::maxVoices;
+    static constexpr SampleType compressorFloor = (SampleType) 1.0e-4;
+
+    using Vector = juce::dsp::SIMDRegister<SampleType>;
+    static_assert (maxVoices % Vector::size() == 0);
+
+    template <typename Value>
+    static constexpr int getNumLanes() noexcept
+    {
+        if constexpr (std::is_same_v<Value, SampleType>)
+            return 1;
+        else
+            return (int) Value::size();
+    }
+
+    static int roundUpToRegister (int numVoices) noexcept
+    {
+        constexpr auto numLanes = (int) Vector::size();
+        return (numVoices + numLanes - 1) / numLanes * numLanes;
+    }
+
+    static void load (const SampleType* source, SampleType& x) noexcept { x = *source; }
+    static void load (const SampleType* source, Vector& x) noexcept { x = Vector::fromRawArray (source); }
+    static void store (SampleType* destination, SampleType x) noexcept { *destination = x; }
+    static void store (SampleType* destination, Vector x) noexcept { x.copyToRawArray (destination); }
+    static SampleType magnitude (SampleType x) noexcept { return std::abs (x); }
+    static Vector magnitude (Vector x) noexcept { return Vector::abs (x); }
+    static SampleType total (SampleType x) noexcept { return x; }
+
+    template <typename Value>
+    static Value broadcast (SampleType x) noexcept
+    {
+        if constexpr (std::is_same_v<Value, SampleType>)
+            return x;
+        else
+            return Value::expand (x);
+    }
+    static SampleType total (Vector x) noexcept { return x.sum(); }
+
+    /** One lowpass biquad in transposed direct form II. A lowpass has b1 = 2 b0 and b2 = b0. */
+    template <typename Value>
+    static Value filter (Value x, Value b0, Value a1, Value a2, Value& s1, Value& s2) noexcept
+    {
+        const auto scaled = x * b0;
+        const auto y = scaled + s1;
+        s1 = scaled + scaled - y * a1 + s2;
+        s2 = scaled - y * a2;
+        return y;
+    }
+
+    /** A tanh shaped curve from a rational approximation, reaching +-1 at +-3 and flat beyond. */
+    static SampleType saturate (SampleType x) noexcept
+    {
+        x = juce::jlimit ((SampleType) -3, (SampleType) 3, x);
+        return x * (27 + x * x) / (27 + 9 * x * x);
+    }
+
+    /** Designs a fourth order Butterworth lowpass at cutoff Hz by the bilinear
+        transform. Section s's coefficients go to b0[s * stride] and so on.
+    */
+    void setLowpass (double cutoff, SampleType* b0, SampleType* a1, SampleType* a2, int stride) const noexcept
+    {
+        static constexpr double q[numSections] = { 0.54119610014619698, 1.3065629648763766 };
+        const auto k = std::tan (juce::MathConstants<double>::pi * cutoff / mSampleRate);
+
+        for (int section = 0; section < numSections; ++section)
+        {
+            const auto norm = 1.0 / (1.0 + k / q[section] + k * k);
+
+            b0[section * stride] = (SampleType) (k * k * norm);
+            a1[section * stride] = (SampleType) (2.0 * (k * k - 1.0) * norm);
+            a2[section * stride] = (SampleType) ((1.0 - k / q[section] + k * k) * norm);
+        }
+    }
+
+    void setVoiceLowpass (int v, double cutoff) noexcept
+    {
+        setLowpass (cutoff, &mVoiceB0[0][v], &mVoiceA1[0][v], &mVoiceA2[0][v], maxVoices);
+    }
+
+    double mSampleRate = 44100.0;
+    double mMaxCutoff = 20000.0;
+    int mNumStages = defaultNumStages;
+    SampleType mEnvelopeCoefficient = 0;
+
+    SampleType mInputB0[numSections] {}, mInputA1[numSections] {}, mInputA2[numSections] {};
+    SampleType mInputS1[numSections] {}, mInputS2[numSections] {};
+    SampleType mInputEnvelope = 0;
+
+    alignas (64) SampleType mVoiceB0[numSections][maxVoices] {};
+    alignas (64) SampleType mVoiceA1[numSections][maxVoices] {};
+    alignas (64) SampleType mVoiceA2[numSections][maxVoices] {};
+    alignas (64) SampleType mVoiceS1[numSections][maxVoices] {};
+    alignas (64) SampleType mVoiceS2[numSections][maxVoices] {};
+    alignas (64) SampleType mVoiceEnvelope[maxVoices] {};
+
+    juce::HeapBlock<char> mStorage;
+    SampleType* mInputRow = nullptr;
+    SampleType* mFrames = nullptr;
+    int mRowStride = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (BucketBrigade)
+};
@@ -0,0 +1,207 @@
+/*
+  ==============================================================================
+
+    ChorusControl.h
+
+    Block-rate control plane: turns the voice table into the numbers the
+    audio kernel needs.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "ChorusVoiceTable.h"
+
+//==============================================================================
+/**
+    Per-block constants for the audio kernel, in samples rather than Hz and ms.
+
+    The modulated delay of voice v at sample n of the block is
+    (delayOffset[v] + n * delayOffsetStep[v]) + (delayScale[v] + n * delayScaleStep[v]) * lfo,
+    with the LFO running from -1 to 1. The gains ramp the same way. So the
+    kernel only does multiply-adds, and parameter changes are spread linearly
+    across the block.
+
+    gain is for a voice that feeds one output from its own delay line.
+    gainLeft and gainRight have the voice's pan position folded in, for one
+    delay line feeding both outputs.
+
+    feedback ramps the same way, and dampingCoefficient is the one-pole
+    lowpass coefficient of the feedback network's damping at this sample rate.
+*/
+struct ChorusControlSnapshot
+{
+    /** Voices to render. Can be more than the active count while removed voices fade out. */
+    int numVoices = 0;
+
+    double phaseIncrement[ChorusVoiceTable::maxVoices] {}; // LFO cycles per sample
+    float delayOffset[ChorusVoiceTable::maxVoices] {};     // delay at the centre of the LFO swing, in samples
+    float delayOffsetStep[ChorusVoiceTable::maxVoices] {};
+    float delayScale[ChorusVoiceTable::maxVoices] {};      // half the LFO swing, in samples
+    float delayScaleStep[ChorusVoiceTable::maxVoices] {};
+    float gain[ChorusVoiceTable::maxVoices] {};
+    float gainStep[ChorusVoiceTable::maxVoices] {};
+    float gainLeft[ChorusVoiceTable::maxVoices] {};
+    float gainLeftStep[ChorusVoiceTable::maxVoices] {};
+    float gainRight[ChorusVoiceTable::maxVoices] {};
+    float gainRightStep[ChorusVoiceTable::maxVoices] {};
+
+    float feedback = 0.0f;
+    float feedbackStep = 0.0f;
+    float dampingCoefficient = 1.0f;
+};
+
+//==============================================================================
+/**
+    Builds the ChorusControlSnapshot for each block.
+
+    Everything that depends on the sample rate or the voice settings is worked
+    out here once per block, so the sample loop doesn't touch getSampleRate()
+    or do any unit conversion.
+
+    Delays and gains glide linearly to new settings over smoothingTimeSeconds.
+    Voices that are switched on fade in from silence, and voices that are
+    switched off keep running until they have faded out.
+*/
+class ChorusControlPlane
+{
+public:
+    //==============================================================================
+    static constexpr double smoothingTimeSeconds = 0.05;
+
+    void prepare (double sampleRate) noexcept
+    {
+        jassert (sampleRate > 0.0);
+        mSampleRate = sampleRate;
+        mDampingToneHz = -1.0f; // the damping coefficient depends on the rate too
+
+        for (int v = 0; v < ChorusVoiceTable::maxVoices; ++v)
+        {
+            mDelayOffset[v].reset (sampleRate, smoothingTimeSeconds);
+            mDelayScale[v].reset (sampleRate, smoothingTimeSeconds);
+            mGain[v].reset (sampleRate, smoothingTimeSeconds);
+            mGainLeft[v].reset (sampleRate, smoothingTimeSeconds);
+            mGainRight[v].reset (sampleRate, smoothingTimeSeconds);
+        }
+
+        mFeedback.reset (sampleRate, smoothingTimeSeconds);
+    }
+
+    /** Jumps straight to the voice table's settings, without smoothing. */
+    void reset (const ChorusVoiceTable& voices) noexcept
+    {
+        for (int v = 0; v < ChorusVoiceTable::maxVoices; ++v)
+        {
+            const auto target = getTarget (voices, v);
+
+            mDelayOffset[v].setCurrentAndTargetValue (target.delayOffset);
+            mDelayScale[v].setCurrentAndTargetValue (target.delayScale);
+            mGain[v].setCurrentAndTargetValue (target.gain);
+            mGainLeft[v].setCurrentAndTargetValue (target.gainLeft);
+            mGainRight[v].setCurrentAndTargetValue (target.gainRight);
+        }
+
+        mFeedback.setCurrentAndTargetValue (voices.feedback);
+        update (voices, 0);
+    }
+
+    /** Builds the snapshot for the next numSamples samples. Cheap enough to call every block. */
+    void update (const ChorusVoiceTable& voices, int numSamples) noexcept
+    {
+        const auto rampScale = numSamples > 0 ? 1.0f / (float) numSamples : 0.0f;
+        mSnapshot.numVoices = 0;
+
+        for (int v = 0; v < ChorusVoiceTable::maxVoices; ++v)
+        {
+            const auto target = getTarget (voices, v);
+            const auto isActive = v < voices.numVoices;
+
+            // a silent, inactive voice can jump anywhere, so it fades back in from the right place
+            if (! isActive && ! mGain[v].isSmoothing() && mGain[v].getCurrentValue() == 0.0f)
+            {
+                mDelayOffset[v].setCurrentAndTargetValue (target.delayOffset);
+                mDelayScale[v].setCurrentAndTargetValue (target.delayScale);
+            }
+            else
+            {
+                mDelayOffset[v].setTargetValue (target.delayOffset);
+                mDelayScale[v].setTargetValue (target.delayScale);
+                mGain[v].setTargetValue (target.gain);
+                mGainLeft[v].setTargetValue (target.gainLeft);
+                mGainRight[v].setTargetValue (target.gainRight);
+
+                mSnapshot.numVoices = v + 1;
+            }
+
+            mSnapshot.phaseIncrement[v] = voices.rate[v] / mSampleRate;
+
+            rampOver (mDelayOffset[v], numSamples, rampScale, mSnapshot.delayOffset[v], mSnapshot.delayOffsetStep[v]);
+            rampOver (mDelayScale[v], numSamples, rampScale, mSnapshot.delayScale[v], mSnapshot.delayScaleStep[v]);
+            rampOver (mGain[v], numSamples, rampScale, mSnapshot.gain[v], mSnapshot.gainStep[v]);
+            rampOver (mGainLeft[v], numSamples, rampScale, mSnapshot.gainLeft[v], mSnapshot.gainLeftStep[v]);
+            rampOver (mGainRight[v], numSamples, rampScale, mSnapshot.gainRight[v], mSnapshot.gainRightStep[v]);
+        }
+
+        mFeedback.setTargetValue (voices.feedback);
+        rampOver (mFeedback, numSamples, rampScale, mSnapshot.feedback, mSnapshot.feedbackStep);
+
+        // only worked out again when the tone moves
+        if (voices.feedbackToneHz != mDampingToneHz)
+        {
+            mDampingToneHz = voices.feedbackToneHz;
+            mSnapshot.dampingCoefficient = (float) (1.0 - std::exp (-juce::MathConstants<double>::twoPi * mDampingToneHz / mSampleRate));
+        }
+    }
+
+    const ChorusControlSnapshot& getSnapshot() const noexcept { return mSnapshot; }
+    double getSampleRate() const noexcept { return mSampleRate; }
+
+private:
+    //==============================================================================
+    struct Target
+    {
+        float delayOffset, delayScale, gain, gainLeft, gainRight;
+    };
+
+    Target getTarget (const ChorusVoiceTable& voices, int v) const noexcept
+    {
+        const auto dtime = (float) (voices.baseDelay[v] / 1000.0 * mSampleRate);
+
+        // dtime * (1 + jmap (lfo, -1, 1, minDepth, depth)) written as offset + scale * lfo
+        const auto depthCentre = 0.5f * (voices.minDepth + voices.depth[v]);
+        const auto depthSwing = 0.5f * (voices.depth[v] - voices.minDepth);
+
+        const auto gain = v < voices.numVoices ? voices.gain[v] : 0.0f;
+
+        // constant power, so a voice is as loud in the middle as at either side
+        const auto panAngle = juce::MathConstants<float>::halfPi * voices.pan[v];
+
+        return { dtime * (1.0f + depthCentre),
+                 dtime * depthSwing,
+                 gain,
+                 gain * std::cos (panAngle),
+                 gain * std::sin (panAngle) };
+    }
+
+    static void rampOver (juce::SmoothedValue<float>& value, int numSamples, float rampScale, float& start, float& step) noexcept
+    {
+        start = value.getCurrentValue();
+        step = (value.skip (numSamples) - start) * rampScale;
+    }
+
+    //==============================================================================
+    double mSampleRate = 44100.0;
+    ChorusControlSnapshot mSnapshot;
+
+    juce::SmoothedValue<float> mDelayOffset[ChorusVoiceTable::maxVoices];
+    juce::SmoothedValue<float> mDelayScale[ChorusVoiceTable::maxVoices];
+    juce::SmoothedValue<float> mGain[ChorusVoiceTable::maxVoices];
+    juce::SmoothedValue<float> mGainLeft[ChorusVoiceTable::maxVoices];
+    juce::SmoothedValue<float> mGainRight[ChorusVoiceTable::maxVoices];
+    juce::SmoothedValue<float> mFeedback;
+    float mDampingToneHz = -1.0f;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ChorusControlPlane)
+};
@@ -0,0 +1,360 @@
+/*
+  ==============================================================================
+
+    ChorusParameters.cpp
+
+  ==============================================================================
+*/
+
+#include "ChorusParameters.h"
+
+namespace
+{
+    juce::String voiceParameterId (const char* prefix, int voiceIndex)
+    {
+        return juce::String (prefix) + juce::String (voiceIndex + 1);
+    }
+
+    void writeUint16 (char* destination, std::uint16_t value)
+    {
+        value = juce::ByteOrder::swapIfBigEndian (value);
+        std::memcpy (destination, &value, sizeof (value));
+    }
+
+    void writeUint32 (char* destination, std::uint32_t value)
+    {
+        value = juce::ByteOrder::swapIfBigEndian (value);
+        std::memcpy (destination, &value, sizeof (value));
+    }
+
+    float readFloat (const char* source)
+    {
+        const auto bits = juce::ByteOrder::littleEndianInt (source);
+        float value;
+        std::memcpy (&value, &bits, sizeof (value));
+        return value;
+    }
+}
+
+//==============================================================================
+juce::AudioProcessorValueTreeState::ParameterLayout ChorusParameters::createParameterLayout()
+{
+    juce::AudioProcessorValueTreeState::ParameterLayout layout;
+
+    layout.add (std::make_unique<juce::AudioParameterInt> (juce::ParameterID { numVoicesId, 1 },
+        "Voices",
+        ChorusVoiceTable::minVoices,
+        ChorusVoiceTable::maxVoices,
+        ChorusVoiceTable::defaultVoices));
+
+    for (int i = 0; i < ChorusVoiceTable::numSourceVoices; ++i)
+    {
+        const auto& defaults = ChorusVoiceTable::defaultSourceVoices[i];
+        const auto name = "Voice " + juce::String (i + 1) + " ";
+
+        layout.add (std::make_unique<juce::AudioParameterFloat> (juce::ParameterID { voiceParameterId (rateId, i), 1 },
+            name + "Rate",
+            juce::NormalisableRange<float> (0.05f, 5.0f, 0.0f, 0.4f),
+            defaults.rate));
+
+        layout.add (std::make_unique<juce::AudioParameterFloat> (juce::ParameterID { voiceParameterId (delayId, i), 1 },
+            name + "Delay",
+            juce::NormalisableRange<float> (5.0f, 50.0f),
+            defaults.delayMs));
+
+        layout.add (std::make_unique<juce::AudioParameterFloat> (juce::ParameterID { voiceParameterId (gainId, i), 1 },
+            name + "Gain",
+            juce::NormalisableRange<float> (0.0f, 1.0f),
+            defaults.gain));
+
+        // shown to the host as -1 (left) to 1 (right), the voice table uses 0 to 1
+        layout.add (std::make_unique<juce::AudioParameterFloat> (juce::ParameterID { voiceParameterId (panId, i), 1 },
+            name + "Pan",
+            juce::NormalisableRange<float> (-1.0f, 1.0f),
+            defaults.pan * 2.0f - 1.0f));
+    }
+
+    layout.add (std::make_unique<juce::AudioParameterFloat> (juce::ParameterID { depthMinId, 1 },
+        "Depth Min",
+        juce::NormalisableRange<float> (0.0f, 0.05f),
+        0.001f));
+
+    layout.add (std::make_unique<juce::AudioParameterFloat> (juce::ParameterID { depthMaxId, 1 },
+        "Depth Max",
+        juce::NormalisableRange<float> (0.0f, 0.25f),
+        0.1f));
+
+    layout.add (std::make_unique<juce::AudioParameterChoice> (juce::ParameterID { lfoShapeId, 1 },
+        "LFO Shape",
+        juce::StringArray { "Sine", "Triangle", "Random" },
+        0));
+
+    // in the same order as Interpolation::Mode
+    layout.add (std::make_unique<juce::AudioParameterChoice> (juce::ParameterID { interpolationId, 1 },
+        "Interpolation",
+        juce::StringArray { "Linear", "Hermite", "Lagrange", "Allpass" },
+        0));
+
+    // in the same order as StereoMode
+    layout.add (std::make_unique<juce::AudioParameterChoice> (juce::ParameterID { stereoModeId, 1 },
+        "Stereo Mode",
+        juce::StringArray { "Panned Mono", "Dual" },
+        0));
+
+    layout.add (std::make_unique<juce::AudioParameterBool> (juce::ParameterID { feedbackNetworkId, 1 },
+        "Feedback Network",
+        false));
+
+    layout.add (std::make_unique<juce::AudioParameterFloat> (juce::ParameterID { feedbackId, 1 },
+        "Feedback",
+        juce::NormalisableRange<float> (0.0f, maxFeedback),
+        0.5f));
+
+    layout.add (std::make_unique<juce::AudioParameterFloat> (juce::ParameterID { feedbackToneId, 1 },
+        "Feedback Tone",
+        juce::NormalisableRange<float> (500.0f, 20000.0f, 0.0f, 0.3f),
+        6000.0f));
+
+    // the feedback network takes precedence when both are on
+    layout.add (std::make_unique<juce::AudioParameterBool> (juce::ParameterID { bbdId, 1 },
+        "BBD Emulation",
+        false));
+
+    // each choice doubles the one before, from 512
+    layout.add (std::make_unique<juce::AudioParameterChoice> (juce::ParameterID { bbdStagesId, 1 },
+        "BBD Stages",
+        juce::StringArray { "512", "1024", "2048", "4096" },
+        1));
+
+    // in the same order as EcoMode::Setting
+    layout.add (std::make_unique<juce::AudioParameterChoice> (juce::ParameterID { ecoId, 1 },
+        "Eco",
+        juce::StringArray { "Off", "Auto", "Eco 1", "Eco 2", "Eco 3" },
+        0));
+
+    return layout;
+}
+
+juce::StringArray ChorusParameters::getAllParameterIds()
+{
+    juce::StringArray ids { numVoicesId, depthMinId, depthMaxId, lfoShapeId, feedbackId, feedbackToneId };
+
+    for (int i = 0; i < ChorusVoiceTable::numSourceVoices; ++i)
+        for (auto* prefix : { rateId, delayId, gainId, panId })
+            ids.add (voiceParameterId (prefix, i));
+
+    return ids;
+}
+
+juce::StringArray ChorusParameters::getStateParameterIds()
+{
+    auto ids = getAllParameterIds();
+
+    for (auto* id : { interpolationId, stereoModeId, feedbackNetworkId, bbdId, bbdStagesId, ecoId })
+        ids.add (id);
+
+    return ids;
+}
+
+//==============================================================================
+ChorusParameters::ChorusParameters (juce::AudioProcessorValueTreeState& state)
+    : mState (state)
+{
+    mNumVoices = mState.getRawParameterValue (numVoicesId);
+    mDepthMin = mState.getRawParameterValue (depthMinId);
+    mDepthMax = mState.getRawParameterValue (depthMaxId);
+    mLfoShape = mState.getRawParameterValue (lfoShapeId);
+    mInterpolation = mState.getRawParameterValue (interpolationId);
+    mStereoMode = mState.getRawParameterValue (stereoModeId);
+    mFeedbackNetwork = mState.getRawParameterValue (feedbackNetworkId);
+    mFeedback = mState.getRawParameterValue (feedbackId);
+    mFeedbackTone = mState.getRawParameterValue (feedbackToneId);
+    mBbd = mState.getRawParameterValue (bbdId);
+    mBbdStages = mState.getRawParameterValue (bbdStagesId);
+    mEco = mState.getRawParameterValue (ecoId);
+
+    for (int i = 0; i < ChorusVoiceTable::numSourceVoices; ++i)
+    {
+        mRate[i] = mState.getRawParameterValue (voiceParameterId (rateId, i));
+        mDelay[i] = mState.getRawParameterValue (voiceParameterId (delayId, i));
+        mGain[i] = mState.getRawParameterValue (voiceParameterId (gainId, i));
+        mPan[i] = mState.getRawParameterValue (voiceParameterId (panId, i));
+    }
+
+    for (auto& id : getAllParameterIds())
+        mState.addParameterListener (id, this);
+
+    for (auto& id : getStateParameterIds())
+    {
+        auto* parameter = mState.getParameter (id);
+        jassert (parameter != nullptr);
+
+        mStateEntries.push_back ({ hashId (id.toRawUTF8()), parameter, id != ecoId });
+    }
+}
+
+ChorusParameters::~ChorusParameters()
+{
+    for (auto& id : getAllParameterIds())
+        mState.removeParameterListener (id, this);
+}
+
+void ChorusParameters::parameterChanged (const juce::String&, float)
+{
+    invalidate();
+}
+
+//==============================================================================
+bool ChorusParameters::updateVoiceTable (ChorusVoiceTable& voices) noexcept
+{
+    const auto version = mVersion.load (std::memory_order_acquire);
+
+    if (version == mLastVersion)
+        return false;
+
+    mLastVersion = version;
+
+    for (int i = 0; i < ChorusVoiceTable::numSourceVoices; ++i)
+    {
+        voices.sources[i] = { mRate[i]->load (std::memory_order_relaxed),
+                              mDelay[i]->load (std::memory_order_relaxed),
+                              mGain[i]->load (std::memory_order_relaxed),
+                              0.5f * (mPan[i]->load (std::memory_order_relaxed) + 1.0f) };
+    }
+
+    // keep the range the right way round even if the host sets min above max
+    const auto depthMin = mDepthMin->load (std::memory_order_relaxed);
+    const auto depthMax = mDepthMax->load (std::memory_order_relaxed);
+    voices.minDepth = juce::jmin (depthMin, depthMax);
+    voices.maxDepth = juce::jmax (depthMin, depthMax);
+
+    voices.feedback = mFeedback->load (std::memory_order_relaxed);
+    voices.feedbackToneHz = mFeedbackTone->load (std::memory_order_relaxed);
+
+    voices.setNumVoices (juce::roundToInt (mNumVoices->load (std::memory_order_relaxed)));
+
+    return true;
+}
+
+ChorusLfo::Shape ChorusParameters::getLfoShape() const noexcept
+{
+    return (ChorusLfo::Shape) juce::roundToInt (mLfoShape->load (std::memory_order_relaxed));
+}
+
+Interpolation::Mode ChorusParameters::getInterpolationMode() const noexcept
+{
+    return (Interpolation::Mode) juce::roundToInt (mInterpolation->load (std::memory_order_relaxed));
+}
+
+ChorusParameters::StereoMode ChorusParameters::getStereoMode() const noexcept
+{
+    return (StereoMode) juce::roundToInt (mStereoMode->load (std::memory_order_relaxed));
+}
+
+bool ChorusParameters::isFeedbackNetworkEnabled() const noexcept
+{
+    return mFeedbackNetwork->load (std::memory_order_relaxed) >= 0.5f;
+}
+
+float ChorusParameters::getFeedback() const noexcept
+{
+    return mFeedback->load (std::memory_order_relaxed);
+}
+
+bool ChorusParameters::isBbdEnabled() const noexcept
+{
+    return mBbd->load (std::memory_order_relaxed) >= 0.5f;
+}
+
+int ChorusParameters::getBbdStages() const noexcept
+{
+    return 512 << juce::roundToInt (mBbdStages->load (std::memory_order_relaxed));
+}
+
+EcoMode::Setting ChorusParameters::getEcoSetting() const noexcept
+{
+    return (EcoMode::Setting) juce::roundToInt (mEco->load (std::memory_order_relaxed));
+}
+
+//==============================================================================
+void ChorusParameters::setAll (const HashedValue* values, int numValues)
+{
+    // odd from here until every parameter has its new value; the fence keeps the parameter
+    // stores below from being seen before the sequence turns odd
+    mPresetSequence.fetch_add (1, std::memory_order_relaxed);
+    std::atomic_thread_fence (std::memory_order_release);
+
+    for (const auto& entry : mStateEntries)
+    {
+        auto normalisedValue = entry.defaultsIfMissing ? entry.parameter->getDefaultValue() : entry.parameter->getValue();
+
+        for (int i = 0; i < numValues; ++i)
+            if (values[i].idHash == entry.idHash)
+                normalisedValue = entry.parameter->convertTo0to1 (values[i].value);
+
+        entry.parameter->setValueNotifyingHost (normalisedValue);
+    }
+
+    mPresetSequence.fetch_add (1, std::memory_order_release);
+}
+
+void ChorusParameters::writeState (juce::MemoryBlock& destination, int program) const
+{
+    const auto numValues = (int) mStateEntries.size();
+    destination.setSize ((size_t) (stateHeaderSize + numValues * stateValueSize));
+
+    auto* data = static_cast<char*> (destination.getData());
+    writeUint32 (data, stateMagic);
+    writeUint16 (data + 4, stateVersion);
+    writeUint16 (data + 6, (std::uint16_t) juce::jmax (0, program));
+    writeUint32 (data + 8, (std::uint32_t) numValues);
+
+    for (int i = 0; i < numValues; ++i)
+    {
+        const auto& entry = mStateEntries[(size_t) i];
+        const auto value = entry.parameter->convertFrom0to1 (entry.parameter->getValue());
+
+        std::uint32_t bits;
+        std::memcpy (&bits, &value, sizeof (bits));
+
+        auto* record = data + stateHeaderSize + i * stateValueSize;
+        writeUint32 (record, entry.idHash);
+        writeUint32 (record + 4, bits);
+    }
+}
+
+bool ChorusParameters::readState (const void* data, int sizeInBytes, int& program)
+{
+    const auto* bytes = static_cast<const char*> (data);
+
+    if (bytes == nullptr || sizeInBytes < stateHeaderSize || juce::ByteOrder::littleEndianInt (bytes) != stateMagic)
+        return false;
+
+    const auto version = juce::ByteOrder::littleEndianShort (bytes + 4);
+    const auto numValues = (std::int64_t) juce::ByteOrder::littleEndianInt (bytes + 8);
+
+    if (version == 0 || version > stateVersion || sizeInBytes < stateHeaderSize + numValues * stateValueSize)
+        return false;
+
+    // parsed straight out of the block into a fixed array, each value matched up by its ID hash;
+    // a state from a build with parameters this one doesn't have fills the array with extras it ignores
+    constexpr int maxValues = 256;
+    HashedValue values[maxValues];
+    const auto numToRead = (int) juce::jmin ((std::int64_t) maxValues, numValues);
+    int numRead = 0;
+
+    for (int i = 0; i < numToRead; ++i)
+    {
+        const auto* record = bytes + stateHeaderSize + i * stateValueSize;
+        const auto value = readFloat (record + 4);
+
+        // a NaN or infinity would get past the parameter ranges and into the audio, so a corrupt
+        // value counts as missing and its parameter is treated as it would be if it weren't saved
+        if (std::isfinite (value))
+            values[numRead++] = { juce::ByteOrder::littleEndianInt (record), value };
+    }
+
+    program = juce::ByteOrder::littleEndianShort (bytes + 6);
+    setAll (values, numRead);
+    return true;
+}
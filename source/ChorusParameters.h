@@ -0,0 +1,198 @@
+/*
+  ==============================================================================
+
+    ChorusParameters.h
+
+    Host-automatable parameters and their hand-off to the audio thread.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "ChorusLfo.h"
+#include "ChorusVoiceTable.h"
+#include "EcoMode.h"
+#include "Interpolation.h"
+
+//==============================================================================
+/**
+    Owns the link between the AudioProcessorValueTreeState parameters and the
+    voice table used by the audio thread.
+
+    The raw parameter atomics are looked up once, in the constructor. Every
+    parameter change bumps a version counter from whichever thread made it. The
+    audio thread checks that counter once per block, and only when it has moved
+    does it read the atomics and rebuild the voice table. There are no string
+    lookups, locks or allocations on the audio thread, and no per-sample atomic
+    loads; ChorusControlPlane then glides to the new values.
+*/
+class ChorusParameters : private juce::AudioProcessorValueTreeState::Listener
+{
+public:
+    //==============================================================================
+    static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
+
+    explicit ChorusParameters (juce::AudioProcessorValueTreeState& state);
+    ~ChorusParameters() override;
+
+    /** Audio thread: copies the parameters into the voice table if any of them
+        changed since the last call. Returns true if the table was rebuilt.
+    */
+    bool updateVoiceTable (ChorusVoiceTable& voices) noexcept;
+
+    /** Makes the next updateVoiceTable() call rebuild the table, even if nothing changed. */
+    void invalidate() noexcept { mVersion.fetch_add (1, std::memory_order_release); }
+
+    /** How a stereo input reaches the voices. */
+    enum class StereoMode
+    {
+        monoSum,    // one delay line fed with both channels, each voice panned across the outputs
+        dual        // a delay line per channel, each voice on both
+    };
+
+    ChorusLfo::Shape getLfoShape() const noexcept;
+    Interpolation::Mode getInterpolationMode() const noexcept;
+    StereoMode getStereoMode() const noexcept;
+
+    /** True when the voices run through the feedback network, see FeedbackNetwork. */
+    bool isFeedbackNetworkEnabled() const noexcept;
+
+    /** The feedback amount the host has set, for working out the tail length. */
+    float getFeedback() const noexcept;
+
+    /** The most the network sends round; below one, so its tail always dies away. */
+    static constexpr float maxFeedback = 0.95f;
+
+    /** True when the voices go through the bucket brigade emulation, see BucketBrigade. */
+    bool isBbdEnabled() const noexcept;
+
+    /** The length of the modelled bucket brigade chip. */
+    int getBbdStages() const noexcept;
+
+    /** How much quality to give up for CPU, see EcoMode. */
+    EcoMode::Setting getEcoSetting() const noexcept;
+
+    //==============================================================================
+    /** A parameter value for setAll(), with the parameter named by hashId() of its
+        ID, in the parameter's own units.
+    */
+    struct HashedValue
+    {
+        std::uint32_t idHash;
+        float value;
+    };
+
+    /** A 32-bit FNV-1a hash of a parameter ID, which is what the binary state stores. */
+    static constexpr std::uint32_t hashId (const char* id) noexcept
+    {
+        std::uint32_t hash = 2166136261u;
+
+        for (; *id != 0; ++id)
+            hash = (hash ^ (std::uint8_t) *id) * 16777619u;
+
+        return hash;
+    }
+
+    /** Message thread: sets every parameter to its value in values, and the ones
+        values leaves out to their defaults, as a preset or a restored state does.
+        Values for parameters that don't exist are ignored. The eco setting is about
+        the machine rather than the sound, so when values leave it out it stays as it is.
+
+        The preset sequence is odd while it is at it. The audio thread keeps the
+        settings it has until the sequence is even and has moved, then takes all
+        of them at once, see getPresetSequence().
+    */
+    void setAll (const HashedValue* values, int numValues);
+
+    /** Goes up once when setAll() starts and once when it is done, so it's odd while
+        the parameters are half set. Safe to call from any thread.
+    */
+    std::uint32_t getPresetSequence() const noexcept { return mPresetSequence.load (std::memory_order_acquire); }
+
+    /** Message thread: stores every parameter in destination, in the binary state
+        format, along with the program the host last picked.
+    */
+    void writeState (juce::MemoryBlock& destination, int program) const;
+
+    /** Message thread: applies a block written by writeState() with setAll(), and
+        returns the program it was saved with. For anything it can't read it returns
+        false and changes nothing. A value that isn't finite is left out, as if it
+        hadn't been saved.
+    */
+    bool readState (const void* data, int sizeInBytes, int& program);
+
+    /** The binary state is a header of the magic number, the format version, the
+        program and the number of values, then a parameter ID hash and a float
+        value for each parameter, all little endian. States from a newer version
+        are refused rather than half read.
+    */
+    static constexpr std::uint32_t stateMagic = 0x53434c57; // "WLCS"
+    static constexpr std::uint16_t stateVersion = 1;
+    static constexpr int stateHeaderSize = 12;
+    static constexpr int stateValueSize = 8;
+
+    //==============================================================================
+    // parameter IDs; the per-voice ones have the voice number appended, e.g. "rate1"
+    static constexpr const char* numVoicesId = "voices";
+    static constexpr const char* rateId = "rate";
+    static constexpr const char* delayId = "delay";
+    static constexpr const char* gainId = "gain";
+    static constexpr const char* panId = "pan";
+    static constexpr const char* depthMinId = "depthMin";
+    static constexpr const char* depthMaxId = "depthMax";
+    static constexpr const char* lfoShapeId = "lfoShape";
+    static constexpr const char* interpolationId = "interpolation";
+    static constexpr const char* stereoModeId = "stereoMode";
+    static constexpr const char* feedbackNetworkId = "feedbackNetwork";
+    static constexpr const char* feedbackId = "feedback";
+    static constexpr const char* feedbackToneId = "feedbackTone";
+    static constexpr const char* bbdId = "bbd";
+    static constexpr const char* bbdStagesId = "bbdStages";
+    static constexpr const char* ecoId = "eco";
+
+private:
+    //==============================================================================
+    void parameterChanged (const juce::String& parameterID, float newValue) override;
+
+    static juce::StringArray getAllParameterIds();
+
+    // every parameter, including the ones read directly rather than through the voice table
+    static juce::StringArray getStateParameterIds();
+
+    juce::AudioProcessorValueTreeState& mState;
+
+    std::atomic<std::uint32_t> mVersion { 1 };
+    std::atomic<std::uint32_t> mPresetSequence { 0 };
+
+    // every parameter with its hashed ID, in the order the state stores them
+    struct StateEntry
+    {
+        std::uint32_t idHash;
+        juce::RangedAudioParameter* parameter;
+        bool defaultsIfMissing;
+    };
+
+    std::vector<StateEntry> mStateEntries;
+    std::uint32_t mLastVersion = 0;
+
+    std::atomic<float>* mNumVoices = nullptr;
+    std::atomic<float>* mRate[ChorusVoiceTable::numSourceVoices] {};
+    std::atomic<float>* mDelay[ChorusVoiceTable::numSourceVoices] {};
+    std::atomic<float>* mGain[ChorusVoiceTable::numSourceVoices] {};
+    std::atomic<float>* mPan[ChorusVoiceTable::numSourceVoices] {};
+    std::atomic<float>* mDepthMin = nullptr;
+    std::atomic<float>* mDepthMax = nullptr;
+    std::atomic<float>* mLfoShape = nullptr;
+    std::atomic<float>* mInterpolation = nullptr;
+    std::atomic<float>* mStereoMode = nullptr;
+    std::atomic<float>* mFeedbackNetwork = nullptr;
+    std::atomic<float>* mFeedback = nullptr;
+    std::atomic<float>* mFeedbackTone = nullptr;
+    std::atomic<float>* mBbd = nullptr;
+    std::atomic<float>* mBbdStages = nullptr;
+    std::atomic<float>* mEco = nullptr;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ChorusParameters)
+};
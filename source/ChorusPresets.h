@@ -0,0 +1,61 @@
+/*
+  ==============================================================================
+
+    ChorusPresets.h
+
+    The built-in preset bank behind the host's program list.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    The presets the processor offers as programs.
+
+    A preset only lists the parameters it moves away from their defaults, by
+    parameter ID and in the parameter's own units. Everything it leaves out
+    goes back to the default when it is loaded, so a preset always sounds the
+    same whatever was set before it. The first one is the defaults.
+*/
+struct ChorusPresets
+{
+    /** The most parameters one preset can set. */
+    static constexpr int maxValues = 12;
+
+    struct Value
+    {
+        const char* id;
+        float value;
+    };
+
+    /** A name and its values; the list ends at the first Value without an ID. */
+    struct Preset
+    {
+        const char* name;
+        Value values[maxValues];
+    };
+
+    static constexpr Preset presets[] = {
+        { "Waylochorus", {} },
+
+        { "Doubler", { { "voices", 2.0f }, { "depthMin", 0.0005f }, { "depthMax", 0.02f },
+                       { "delay1", 12.0f }, { "delay2", 18.0f } } },
+
+        { "Wide Ensemble", { { "voices", 12.0f }, { "stereoMode", 1.0f }, { "interpolation", 1.0f },
+                             { "depthMax", 0.15f } } },
+
+        { "Dimension", { { "voices", 8.0f }, { "feedbackNetwork", 1.0f }, { "feedback", 0.6f },
+                         { "feedbackTone", 4000.0f } } },
+
+        { "Vintage BBD", { { "bbd", 1.0f }, { "bbdStages", 1.0f }, { "lfoShape", 1.0f },
+                           { "rate1", 0.5f }, { "rate2", 0.83f } } },
+
+        { "Lush 32", { { "voices", 32.0f }, { "interpolation", 1.0f }, { "depthMax", 0.2f } } }
+    };
+
+    static constexpr int numPresets = (int) std::size (presets);
+};
@@ -0,0 +1,120 @@
+/*
+  ==============================================================================
+
+    ChorusVoiceTable.h
+
+    Per-voice settings for the chorus, stored as a structure of arrays.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    The state of every chorus voice, one array per field.
+
+    A voice is a single modulated delay tap with its own LFO phase and rate,
+    base delay, modulation depth, output gain and pan position. Each field lives
+    in its own contiguous array so the processing loop walks all voices with
+    unit stride. Adding voices costs a few floats per field, not another group
+    of members.
+
+    Only the four source voices are set directly; they default to the original
+    Waylochorus voices. Voices beyond those reuse the four sources, detuned a
+    little further each time round, so an ensemble patch of any size keeps the
+    character of the four-voice patch.
+*/
+struct ChorusVoiceTable
+{
+    static constexpr int minVoices = 2;
+    static constexpr int maxVoices = 32;
+    static constexpr int numSourceVoices = 4;
+    static constexpr int defaultVoices = numSourceVoices;
+
+    /** The longest modulated delay any voice may reach. The delay lines are sized from this. */
+    static constexpr float maxDelayMs = 100.0f;
+
+    /** The settings of one source voice. */
+    struct SourceVoice
+    {
+        float rate;    // LFO rate in Hz
+        float delayMs; // unmodulated delay
+        float gain;
+        float pan;     // 0 = left, 1 = right
+    };
+
+    static constexpr SourceVoice defaultSourceVoices[numSourceVoices] = {
+        { 0.65f, 23.6f, 1.0f, 0.0f },
+        { 0.57f, 30.0f, 1.0f, 1.0f },
+        { 0.48f, 36.0f, 0.7f, 0.0f },
+        { 0.44f, 28.0f, 0.57f, 1.0f }
+    };
+
+    ChorusVoiceTable()
+    {
+        std::copy (std::begin (defaultSourceVoices), std::end (defaultSourceVoices), sources);
+        rebuild();
+        resetPhases();
+    }
+
+    /** Sets how many voices are active (clamped to 2..32) and rebuilds the table. */
+    void setNumVoices (int newNumVoices)
+    {
+        numVoices = juce::jlimit (minVoices, maxVoices, newNumVoices);
+        rebuild();
+    }
+
+    /** Recomputes every voice from the source voices and depth range. Doesn't touch the phases. */
+    void rebuild()
+    {
+        // keep the summed level of large ensembles close to the four-voice patch
+        const auto ensembleGain = numVoices > defaultVoices
+                                    ? std::sqrt ((float) defaultVoices / (float) numVoices)
+                                    : 1.0f;
+
+        for (int v = 0; v < maxVoices; ++v)
+        {
+            const auto& source = sources[v % numSourceVoices];
+            const auto generation = (float) (v / numSourceVoices);
+
+            rate[v] = source.rate * (1.0f + 0.06f * generation);
+            depth[v] = maxDepth;
+            gain[v] = source.gain * ensembleGain;
+            pan[v] = source.pan;
+
+            // never let the modulation reach past the end of the delay lines
+            baseDelay[v] = juce::jmin (source.delayMs * (1.0f + 0.045f * generation),
+                                       maxDelayMs / (1.0f + maxDepth));
+        }
+    }
+
+    /** Puts every LFO back at its starting phase. */
+    void resetPhases()
+    {
+        // the source voices start at zero, the extra ones are spread out so they don't move in step
+        for (int v = 0; v < maxVoices; ++v)
+            phase[v] = std::fmod (0.618034 * (v / numSourceVoices), 1.0);
+    }
+
+    int numVoices = defaultVoices;
+
+    SourceVoice sources[numSourceVoices] {};
+
+    // modulation range, as fractions of the base delay
+    float minDepth = 0.001f;
+    float maxDepth = 0.1f;
+
+    // how much of the voices the feedback network sends back round, and the cutoff of its damping
+    float feedback = 0.0f;
+    float feedbackToneHz = 6000.0f;
+
+    double phase[maxVoices] {};    // LFO phase, 0..1, kept in double so it doesn't drift over long sessions
+    float rate[maxVoices] {};      // LFO rate in Hz
+    float baseDelay[maxVoices] {}; // unmodulated delay in milliseconds
+    float depth[maxVoices] {};     // upper end of the modulation range, as a fraction of baseDelay
+    float gain[maxVoices] {};      // output gain
+    float pan[maxVoices] {};       // stereo position, 0 = left, 1 = right
+};
@@ -0,0 +1,521 @@
+/*
+  ==============================================================================
+
+    DelayLine.h
+
+    Circular buffer shared by all chorus voices, read through multiple taps.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include "DelayStorage.h"
+#include "Interpolation.h"
+
+//==============================================================================
+/**
+    A circular buffer with one write head and any number of fractional read taps.
+
+    Every chorus voice hears the same input, so one buffer per channel is enough:
+    each voice is just another tap at its own modulated delay.
+
+    numChannels is 1, or 2 for both channels of a stereo signal interleaved as
+    frames, so frame i is stored as buffer[2 * i] and buffer[2 * i + 1]. Each
+    voice of the dual stereo mode reads both channels at the same delay, so
+    with them side by side a tap's reads land on one cache line instead of two
+    that are a buffer apart, the read positions are worked out once for both,
+    and the block kernel interpolates a register of frames at a time. Lengths,
+    delays and positions are in frames, and the stereo versions of write(),
+    readTaps(), writeBlock() and addTap() take or give interleaved frames.
+
+    The buffer length is rounded up to a power of two so positions wrap with a
+    mask instead of a compare and subtract, and the storage starts on a cache
+    line boundary.
+
+    SampleType is float or double, to match the precision the host processes
+    in. The delay times stay float either way; the read positions and
+    everything read from the buffer use SampleType. Stored is what the buffer
+    keeps, the samples themselves unless a more compact DelayStorage format
+    is asked for; samples are converted on the way in and out.
+*/
+template <typename SampleType, typename Stored = SampleType, int numChannels = 1>
+class DelayLine
+{
+    static_assert (numChannels == 1 || numChannels == 2);
+
+public:
+    //==============================================================================
+    DelayLine() = default;
+
+    /** Makes room for delays of up to maxDelayInSamples, read across blocks of up
+        to maxBlockSize samples, and clears the buffer.
+
+        The block kernel works taps out in a workspace. Threads reading taps at
+        the same time need one each, so numWorkspaces sets how many there are.
+
+        Only allocates when the storage has to grow, so it isn't realtime safe.
+    */
+    void prepare (int maxDelayInSamples, int maxBlockSize, int numWorkspaces = 1)
+    {
+        jassert (maxDelayInSamples > 0 && maxBlockSize > 0 && numWorkspaces > 0);
+
+        // room for the extra samples the interpolators read around the oldest tap, and for
+        // the block that writeBlock() stores before any of it is read
+        const auto newLength = juce::nextPowerOfTwo (juce::jmax (samplesPerCacheLine, maxDelayInSamples + maxBlockSize + Interpolation::maxExtraSamples + 1));
+
+        // the block kernel's fractions and gathered frames, one cache aligned row each, after the buffer
+        const auto newWorkspaceStride = (maxBlockSize + samplesPerCacheLine - 1) & ~(samplesPerCacheLine - 1);
+        const auto bufferBytes = ((size_t) (numChannels * newLength) * sizeof (Stored) + cacheLineSize - 1) & ~(size_t) (cacheLineSize - 1);
+        const auto numBytes = bufferBytes + (size_t) (numWorkspaces * (1 + Interpolation::maxPoints) * numChannels * newWorkspaceStride) * sizeof (SampleType);
+
+        if (numBytes > mCapacity)
+        {
+            mStorage.malloc (numBytes + cacheLineSize);
+
+            const auto address = reinterpret_cast<std::uintptr_t> (mStorage.get());
+            mBuffer = reinterpret_cast<Stored*> ((address + cacheLineSize - 1) & ~(std::uintptr_t) (cacheLineSize - 1));
+            mCapacity = numBytes;
+        }
+
+        if (numWorkspaces * newWorkspaceStride > mNumWorkspaces * mWorkspaceStride)
+            mReadIndices.malloc ((size_t) (numWorkspaces * newWorkspaceStride));
+
+        mLength = newLength;
+        mMask = newLength - 1;
+        mWorkspace = reinterpret_cast<SampleType*> (reinterpret_cast<char*> (mBuffer) + bufferBytes);
+        mWorkspaceStride = newWorkspaceStride;
+        mNumWorkspaces = numWorkspaces;
+
+        reset();
+    }
+
+    /** Frees the storage, for a line the processor has no use for in its current layout.
+        getSize() is zero again until the next prepare(), and clear() and skip() do nothing.
+    */
+    void release()
+    {
+        mStorage.free();
+        mReadIndices.free();
+        mBuffer = nullptr;
+        mWorkspace = nullptr;
+        mCapacity = 0;
+        mLength = 0;
+        mMask = 0;
+        mWriteHead = 0;
+        mWorkspaceStride = 0;
+        mNumWorkspaces = 0;
+    }
+
+    /** Clears the stored audio and rewinds the write head. */
+    void reset() noexcept
+    {
+        clear();
+        mWriteHead = 0;
+    }
+
+    /** Fills the buffer with silence, leaving the write head where it is. */
+    void clear() noexcept
+    {
+        if (mBuffer != nullptr)
+            std::fill (mBuffer, mBuffer + numChannels * mLength, Format::store (SampleType()));
+    }
+
+    /** Returns the buffer length in frames, zero until prepare() has been called. */
+    int getSize() const noexcept { return mLength; }
+
+    /** How many threads can read taps with addTap() at once. */
+    int getNumWorkspaces() const noexcept { return mNumWorkspaces; }
+
+    //==============================================================================
+    /** Stores a sample at the write head. Call advance() once all taps have been read. */
+    void write (SampleType sample) noexcept
+    {
+        static_assert (numChannels == 1);
+        mBuffer[mWriteHead] = Format::store (sample);
+    }
+
+    /** Stores a frame at the write head of a stereo line. */
+    void write (SampleType left, SampleType right) noexcept
+    {
+        static_assert (numChannels == 2);
+        mBuffer[2 * mWriteHead] = Format::store (left);
+        mBuffer[2 * mWriteHead + 1] = Format::store (right);
+    }
+
+    /** Moves the write head on by one sample. */
+    void advance() noexcept { mWriteHead = (mWriteHead + 1) & mMask; }
+
+    /** Moves the write head on by numSamples without writing anything. Only
+        right when what it passes over is already silent, after clear() say.
+    */
+    void skip (int numSamples) noexcept { mWriteHead = (mWriteHead + numSamples) & mMask; }
+
+    /** Returns the sample delayInSamples behind the write head, read with the
+        given Interpolation policy. The state belongs to the tap being read.
+    */
+    template <typename Interpolator>
+    SampleType read (float delayInSamples, SampleType& state) const noexcept
+    {
+        static_assert (numChannels == 1);
+
+        const auto readHead = getReadHead (mWriteHead, delayInSamples);
+
+        // get the integer part of the read head
+        const int readHeadX = (int) readHead;
+        // get the part of the readHead after the decimal point
+        const SampleType readHeadFloat = readHead - (SampleType) readHeadX;
+
+        return Interpolator::read (mBuffer, mMask, readHeadX, readHeadFloat, state);
+    }
+
+    /** Reads numTaps taps and returns their sum, each tap scaled by its gain.
+        The delay of tap t is delaysInSamples[t * stride], and its interpolator state is states[t].
+    */
+    template <typename Interpolator>
+    SampleType readTaps (const float* delaysInSamples, int stride, const float* gains, SampleType* states, int numTaps) const noexcept
+    {
+        SampleType sum = 0;
+
+        for (int tap = 0; tap < numTaps; ++tap)
+            sum += gains[tap] * read<Interpolator> (delaysInSamples[tap * stride], states[tap]);
+
+        return sum;
+    }
+
+    /** readTaps() for a stereo line: each tap reads both channels of its frames,
+        with an interpolator state for each, and adds them to a sum per channel.
+    */
+    template <typename Interpolator>
+    void readTaps (const float* delaysInSamples, int stride, const float* gains, SampleType* statesLeft, SampleType* statesRight,
+                   int numTaps, SampleType& left, SampleType& right) const noexcept
+    {
+        static_assert (numChannels == 2);
+
+        left = 0;
+        right = 0;
+
+        for (int tap = 0; tap < numTaps; ++tap)
+        {
+            const auto readHead = getReadHead (mWriteHead, delaysInSamples[tap * stride]);
+            const int readHeadX = (int) readHead;
+            const SampleType readHeadFloat = readHead - (SampleType) readHeadX;
+
+            SampleType tapLeft, tapRight;
+            Interpolator::readStereo (mBuffer, mMask, readHeadX, readHeadFloat, statesLeft[tap], statesRight[tap], tapLeft, tapRight);
+
+            left += gains[tap] * tapLeft;
+            right += gains[tap] * tapRight;
+        }
+    }
+
+    /** Like readTaps(), but reads each tap once and adds it to two sums with
+        separate gains, for one channel spread across two outputs.
+    */
+    template <typename Interpolator>
+    void readTapsPanned (const float* delaysInSamples, int stride, const float* gainsLeft, const float* gainsRight,
+                         SampleType* states, int numTaps, SampleType& left, SampleType& right) const noexcept
+    {
+        left = 0;
+        right = 0;
+
+        for (int tap = 0; tap < numTaps; ++tap)
+        {
+            const auto sample = read<Interpolator> (delaysInSamples[tap * stride], states[tap]);
+            left += gainsLeft[tap] * sample;
+            right += gainsRight[tap] * sample;
+        }
+    }
+
+    //==============================================================================
+    /** Stores numSamples samples and moves the write head past them, for the
+        block-at-a-time kernel. The buffer must be at least numSamples longer
+        than the longest delay that will be read, or the block overwrites the
+        oldest samples before they are read.
+    */
+    void writeBlock (const SampleType* input, int numSamples) noexcept
+    {
+        static_assert (numChannels == 1);
+        jassert (numSamples <= mLength);
+
+        const auto firstPart = juce::jmin (numSamples, mLength - mWriteHead);
+        store (mBuffer + mWriteHead, input, firstPart);
+        store (mBuffer, input + firstPart, numSamples - firstPart);
+
+        mWriteHead = (mWriteHead + numSamples) & mMask;
+    }
+
+    /** writeBlock() for a stereo line, interleaving numSamples samples of each channel into frames. */
+    void writeBlock (const SampleType* left, const SampleType* right, int numSamples) noexcept
+    {
+        static_assert (numChannels == 2);
+        jassert (numSamples <= mLength);
+
+        const auto firstPart = juce::jmin (numSamples, mLength - mWriteHead);
+        storeFrames (mBuffer + 2 * mWriteHead, left, right, firstPart);
+        storeFrames (mBuffer, left + firstPart, right + firstPart, numSamples - firstPart);
+
+        mWriteHead = (mWriteHead + numSamples) & mMask;
+    }
+
+    /** Reads one tap across the block that writeBlock() has just stored, and
+        adds it to destination with a gain ramping from gain by gainStep per sample.
+        Sample n of the tap is read delaysInSamples[n] behind sample n of the block,
+        so it hears exactly what read() would have heard at that point.
+
+        This works in passes. The first works out the read positions, the second
+        gathers the frames around them into rows, one at a time since the reads
+        are scattered. The last interpolates and mixes a juce::dsp::SIMDRegister's
+        worth of samples at a time from those rows; JUCE picks NEON, SSE or AVX
+        for it from the build's target flags. destination must be SIMD aligned.
+
+        On a stereo line the rows and destination hold interleaved frames, so
+        destination has room for 2 * numSamples samples. Each gathered frame is
+        one copy, and a register interpolates both channels of half as many frames.
+
+        Only for stateless interpolators; the allpass needs each output before
+        it can work out the next, so it has to go through readTaps().
+
+        The passes run in one of the workspaces prepare() made. Taps can be read
+        from several threads at once, as long as each uses its own workspace and
+        nothing writes to the line meanwhile.
+    */
+    template <typename Interpolator>
+    void addTap (const float* delaysInSamples, float gain, float gainStep, SampleType* destination, int numSamples, int workspace = 0) noexcept
+    {
+        gatherTap<Interpolator> (delaysInSamples, numSamples, workspace);
+        mixTap<Interpolator, 1> ({ gain }, { gainStep }, { destination }, numSamples, workspace);
+    }
+
+    /** Like addTap(), but interpolates the tap once and adds it to two
+        destinations, each with its own gain ramp. Both must be SIMD aligned.
+    */
+    template <typename Interpolator>
+    void addTapPanned (const float* delaysInSamples, float gainLeft, float gainLeftStep, float gainRight, float gainRightStep,
+                       SampleType* left, SampleType* right, int numSamples, int workspace = 0) noexcept
+    {
+        gatherTap<Interpolator> (delaysInSamples, numSamples, workspace);
+        mixTap<Interpolator, 2> ({ gainLeft, gainRight }, { gainLeftStep, gainRightStep }, { left, right }, numSamples, workspace);
+    }
+
+    /** Like addTap(), but interpolates the tap once and adds it to every one
+        of the destinations, each with its own gain ramp. All must be SIMD aligned.
+    */
+    template <typename Interpolator, int numDestinations>
+    void addTapToEach (const float* delaysInSamples, std::array<float, numDestinations> gains, std::array<float, numDestinations> gainSteps,
+                       std::array<SampleType*, numDestinations> destinations, int numSamples) noexcept
+    {
+        gatherTap<Interpolator> (delaysInSamples, numSamples, 0);
+        mixTap<Interpolator, numDestinations> (gains, gainSteps, destinations, numSamples, 0);
+    }
+
+    /** Adds source to the numSamples samples writeBlock() has just stored. For
+        feeding a block's own output back in, when no tap reads that close to
+        the write head.
+    */
+    void addToBlock (const SampleType* source, int numSamples) noexcept
+    {
+        static_assert (numChannels == 1);
+        jassert (numSamples <= mLength);
+
+        const auto blockStart = (mWriteHead - numSamples) & mMask;
+        const auto firstPart = juce::jmin (numSamples, mLength - blockStart);
+        accumulate (mBuffer + blockStart, source, firstPart);
+        accumulate (mBuffer, source + firstPart, numSamples - firstPart);
+    }
+
+private:
+    //==============================================================================
+    // the first two passes of addTap(): read positions, then the frames around them, one row per point
+    template <typename Interpolator>
+    void gatherTap (const float* delaysInSamples, int numSamples, int workspace) noexcept
+    {
+        static_assert (! Interpolator::isRecursive, "recursive interpolators have to be read with readTaps()");
+
+        constexpr auto numPoints = Interpolator::numPoints;
+
+        jassert (numSamples <= mWorkspaceStride);
+        jassert (juce::isPositiveAndBelow (workspace, mNumWorkspaces));
+
+        auto* fracs = getWorkspace (workspace);
+        auto* indices = mReadIndices.get() + workspace * mWorkspaceStride;
+        SampleType* points[numPoints];
+
+        for (int p = 0; p < numPoints; ++p)
+            points[p] = getPointRow (workspace, p);
+
+        // where the write head was for the first sample of the block
+        const auto blockStart = mWriteHead - numSamples + mLength;
+
+        // the read positions are plain arithmetic, kept apart from the scattered reads so the compiler can vectorise them.
+        // Each channel of a frame gets the fraction, so the rows line up with the frames
+        for (int n = 0; n < numSamples; ++n)
+        {
+            const auto readHead = getReadHead (blockStart + n, delaysInSamples[n]);
+            const auto index = (int) readHead;
+
+            for (int c = 0; c < numChannels; ++c)
+                fracs[numChannels * n + c] = readHead - (SampleType) index;
+
+            indices[n] = index + Interpolator::firstPoint;
+        }
+
+        for (int n = 0; n < numSamples; ++n)
+        {
+            for (int p = 0; p < numPoints; ++p)
+            {
+                // the channels of a frame sit side by side, so this is one short copy
+                const auto* frame = mBuffer + numChannels * ((indices[n] + p) & mMask);
+
+                for (int c = 0; c < numChannels; ++c)
+                    points[p][numChannels * n + c] = (SampleType) Format::load (frame[c]);
+            }
+        }
+    }
+
+    // the last pass: interpolate what gatherTap() left in the workspace, and mix it into each destination.
+    // A step covers a register of frames, so on a stereo line each point is two registers of interleaved frames
+    template <typename Interpolator, int numDestinations>
+    void mixTap (std::array<float, numDestinations> gains, std::array<float, numDestinations> gainSteps,
+                 std::array<SampleType*, numDestinations> destinations, int numSamples, int workspace) noexcept
+    {
+        using Vector = juce::dsp::SIMDRegister<SampleType>;
+        constexpr auto numLanes = (int) Vector::size();
+        constexpr auto numPoints = Interpolator::numPoints;
+
+        const auto* fracs = getWorkspace (workspace);
+        const SampleType* points[numPoints];
+
+        for (int p = 0; p < numPoints; ++p)
+            points[p] = getPointRow (workspace, p);
+
+        // the frame each lane belongs to, counted from the start of a step
+        alignas (Vector::SIMDRegisterSize) static constexpr SampleType laneFrames[2][32] =
+        {
+            { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31 },
+            { 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13, 14, 14, 15, 15 }
+        };
+        static_assert (numChannels * numLanes <= 32);
+
+        Vector firstGains[numDestinations][numChannels];
+
+        for (int d = 0; d < numDestinations; ++d)
+        {
+            jassert (Vector::isSIMDAligned (destinations[d]));
+
+            for (int r = 0; r < numChannels; ++r)
+                firstGains[d][r] = Vector::fromRawArray (laneFrames[numChannels - 1] + r * numLanes) * (SampleType) gainSteps[d] + (SampleType) gains[d];
+        }
+
+        int n = 0;
+
+        for (; n + numLanes <= numSamples; n += numLanes)
+        {
+            for (int r = 0; r < numChannels; ++r)
+            {
+                const auto offset = numChannels * n + r * numLanes;
+                Vector x[numPoints];
+
+                for (int p = 0; p < numPoints; ++p)
+                    x[p] = Vector::fromRawArray (points[p] + offset);
+
+                const auto tap = Interpolator::interpolate (x, Vector::fromRawArray (fracs + offset));
+
+                for (int d = 0; d < numDestinations; ++d)
+                {
+                    const auto rampedGains = firstGains[d][r] + (SampleType) gainSteps[d] * (SampleType) n;
+                    (Vector::fromRawArray (destinations[d] + offset) + tap * rampedGains).copyToRawArray (destinations[d] + offset);
+                }
+            }
+        }
+
+        // the frames that don't fill a step
+        for (; n < numSamples; ++n)
+        {
+            for (int c = 0; c < numChannels; ++c)
+            {
+                const auto offset = numChannels * n + c;
+                SampleType x[numPoints];
+
+                for (int p = 0; p < numPoints; ++p)
+                    x[p] = points[p][offset];
+
+                const auto tap = Interpolator::interpolate (x, fracs[offset]);
+
+                for (int d = 0; d < numDestinations; ++d)
+                    destinations[d][offset] += (SampleType) (gains[d] + gainSteps[d] * (float) n) * tap;
+            }
+        }
+    }
+
+    static void store (Stored* destination, const SampleType* source, int numSamples) noexcept
+    {
+        if constexpr (std::is_same_v<Stored, SampleType>)
+        {
+            juce::FloatVectorOperations::copy (destination, source, numSamples);
+        }
+        else
+        {
+            // a straight run of conversions, which the compiler vectorises
+            for (int n = 0; n < numSamples; ++n)
+                destination[n] = Format::store (source[n]);
+        }
+    }
+
+    static void accumulate (Stored* destination, const SampleType* source, int numSamples) noexcept
+    {
+        if constexpr (std::is_same_v<Stored, SampleType>)
+        {
+            juce::FloatVectorOperations::add (destination, source, numSamples);
+        }
+        else
+        {
+            for (int n = 0; n < numSamples; ++n)
+                destination[n] = Format::store ((SampleType) Format::load (destination[n]) + source[n]);
+        }
+    }
+
+    static void storeFrames (Stored* frames, const SampleType* left, const SampleType* right, int numSamples) noexcept
+    {
+        for (int n = 0; n < numSamples; ++n)
+        {
+            frames[2 * n] = Format::store (left[n]);
+            frames[2 * n + 1] = Format::store (right[n]);
+        }
+    }
+
+    // each workspace is the fractions row, then a row per point, each a frame per sample
+    SampleType* getWorkspace (int workspace) const noexcept { return mWorkspace + workspace * (1 + Interpolation::maxPoints) * numChannels * mWorkspaceStride; }
+    SampleType* getPointRow (int workspace, int point) const noexcept { return getWorkspace (workspace) + (point + 1) * numChannels * mWorkspaceStride; }
+
+    SampleType getReadHead (int writePosition, float delayInSamples) const noexcept
+    {
+        // adding the length keeps the read head positive, the mask takes care of the wrap
+        return (SampleType) ((writePosition & mMask) + mLength) - (SampleType) delayInSamples;
+    }
+
+    using Format = DelayStorage::Format<Stored>;
+
+    static constexpr std::uintptr_t cacheLineSize = 64;
+    static constexpr int samplesPerCacheLine = (int) (cacheLineSize / sizeof (SampleType));
+
+    juce::HeapBlock<char> mStorage;
+    Stored* mBuffer = nullptr;
+    size_t mCapacity = 0;
+    int mLength = 0;
+    int mMask = 0;
+    int mWriteHead = 0;
+
+    SampleType* mWorkspace = nullptr;
+    juce::HeapBlock<int> mReadIndices;
+    int mWorkspaceStride = 0;
+    int mNumWorkspaces = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DelayLine)
+};
+
+/** Both channels of a stereo signal in one DelayLine, as interleaved frames. */
+template <typename SampleType, typename Stored = SampleType>
+using InterleavedDelayLine = DelayLine<SampleType, Stored, 2>;
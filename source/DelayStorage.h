@@ -0,0 +1,68 @@
+/*
+  ==============================================================================
+
+    DelayStorage.h
+
+    The formats a delay line can keep its samples in.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <cstdint>
+#include <type_traits>
+
+// set WAYLOCHORUS_COMPACT_DELAY_LINES=1 to store the processor's delay lines as 16-bit samples
+#ifndef WAYLOCHORUS_COMPACT_DELAY_LINES
+    #define WAYLOCHORUS_COMPACT_DELAY_LINES 0
+#endif
+
+//==============================================================================
+/**
+    Conversions between the samples a DelayLine is given and what it stores.
+
+    Format<T> has a load() that turns a stored value back into a sample and a
+    store() that goes the other way. Storing the samples as they are costs
+    nothing. 16-bit fixed point halves the buffer, so twice as much of it
+    stays in cache while the voices' read heads sweep around. That matters on
+    small ARM cores, where the scattered reads cost more than the arithmetic.
+
+    The 16-bit format keeps headroom above full scale, so a hot synth doesn't
+    clip in the delay line, and saturates beyond that rather than wrapping.
+    That leaves about 86 dB between a full scale sine and the rounding noise,
+    less as the signal gets quieter.
+*/
+namespace DelayStorage
+{
+    template <typename Stored>
+    struct Format
+    {
+        static_assert (std::is_floating_point_v<Stored>);
+
+        static Stored load (Stored value) noexcept { return value; }
+        static Stored store (Stored sample) noexcept { return sample; }
+    };
+
+    template <>
+    struct Format<std::int16_t>
+    {
+        /** The largest level stored without clipping, +12 dBFS. */
+        static constexpr float headroom = 4.0f;
+
+        static float load (std::int16_t value) noexcept { return (float) value * (headroom / 32767.0f); }
+
+        template <typename SampleType>
+        static std::int16_t store (SampleType sample) noexcept
+        {
+            // clamped and rounded with plain arithmetic, so a loop of these vectorises
+            const auto scaled = juce::jlimit (-32767.0f, 32767.0f, (float) sample * (32767.0f / headroom));
+            return (std::int16_t) (int) (scaled + (scaled < 0.0f ? -0.5f : 0.5f));
+        }
+    };
+
+    /** What the processor's delay lines store for a given sample type. */
+    template <typename SampleType>
+    using Default = std::conditional_t<WAYLOCHORUS_COMPACT_DELAY_LINES != 0, std::int16_t, SampleType>;
+}
@@ -0,0 +1,151 @@
+/*
+  ==============================================================================
+
+    DspLoadMeter.h
+
+    How much of the real-time budget processBlock is using.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// set WAYLOCHORUS_LOAD_METER=0 to compile the measurement out
+#ifndef WAYLOCHORUS_LOAD_METER
+    #define WAYLOCHORUS_LOAD_METER 1
+#endif
+
+//==============================================================================
+/**
+    Times each block against its deadline (block length / sample rate) and keeps
+    running statistics that any thread can read without locking.
+
+    - load is the time spent as a fraction of the deadline, averaged over about
+      averagingTimeSeconds of audio.
+    - peakLoad is the highest single block since the last resetPeak().
+    - overBudgetBlocks counts blocks that took longer than their deadline. Each
+      of those is an xrun if the plugin is the only thing the host runs.
+
+    Only the audio thread writes the statistics. Measuring costs two reads of
+    the high resolution clock per block; with WAYLOCHORUS_LOAD_METER=0 it costs
+    nothing and the statistics stay at zero.
+*/
+class DspLoadMeter
+{
+public:
+    //==============================================================================
+    static constexpr bool isEnabled = WAYLOCHORUS_LOAD_METER != 0;
+    static constexpr double averagingTimeSeconds = 0.3;
+
+    struct Stats
+    {
+        float load = 0.0f;
+        float peakLoad = 0.0f;
+        juce::uint32 overBudgetBlocks = 0;
+        juce::uint64 blocks = 0;
+    };
+
+    //==============================================================================
+    /** Call before processing starts, from the same place as prepareToPlay. Clears the statistics. */
+    void prepare (double sampleRate) noexcept
+    {
+        mSampleRate = sampleRate;
+        mTicksToSeconds = 1.0 / (double) juce::Time::getHighResolutionTicksPerSecond();
+
+        mLoad.store (0.0f, std::memory_order_relaxed);
+        mPeakLoad.store (0.0f, std::memory_order_relaxed);
+        mOverBudgetBlocks.store (0, std::memory_order_relaxed);
+        mBlocks.store (0, std::memory_order_relaxed);
+        mPeakResetRequested.store (false, std::memory_order_relaxed);
+    }
+
+    /** Starts the peak over. Safe from any thread, it takes effect on the next block. */
+    void resetPeak() noexcept { mPeakResetRequested.store (true, std::memory_order_relaxed); }
+
+    Stats getStats() const noexcept
+    {
+        Stats stats;
+        stats.load = mLoad.load (std::memory_order_relaxed);
+        stats.peakLoad = mPeakLoad.load (std::memory_order_relaxed);
+        stats.overBudgetBlocks = mOverBudgetBlocks.load (std::memory_order_relaxed);
+        stats.blocks = mBlocks.load (std::memory_order_relaxed);
+        return stats;
+    }
+
+    //==============================================================================
+    /** Adds one block to the statistics. ScopedTimer does this for you. Audio thread only. */
+    void addBlock (double elapsedSeconds, int numSamples) noexcept
+    {
+        if constexpr (isEnabled)
+        {
+            if (numSamples <= 0 || mSampleRate <= 0.0)
+                return;
+
+            const auto deadlineSeconds = numSamples / mSampleRate;
+            const auto load = (float) (elapsedSeconds / deadlineSeconds);
+
+            // a one-pole average, weighted by how much audio the block covers
+            const auto weight = (float) juce::jmin (1.0, deadlineSeconds / averagingTimeSeconds);
+            const auto previous = mLoad.load (std::memory_order_relaxed);
+            mLoad.store (mBlocks.load (std::memory_order_relaxed) == 0 ? load : previous + weight * (load - previous), std::memory_order_relaxed);
+
+            auto peak = mPeakLoad.load (std::memory_order_relaxed);
+
+            if (mPeakResetRequested.load (std::memory_order_relaxed))
+            {
+                mPeakResetRequested.store (false, std::memory_order_relaxed);
+                peak = 0.0f;
+            }
+
+            mPeakLoad.store (juce::jmax (peak, load), std::memory_order_relaxed);
+
+            if (load > 1.0f)
+                mOverBudgetBlocks.store (mOverBudgetBlocks.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+            mBlocks.store (mBlocks.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+        else
+        {
+            juce::ignoreUnused (elapsedSeconds, numSamples);
+        }
+    }
+
+    //==============================================================================
+    /** Times its own lifetime and adds it to the meter as one block of numSamples. */
+    class ScopedTimer
+    {
+    public:
+        ScopedTimer (DspLoadMeter& meter, int numSamples) noexcept
+            : mMeter (meter), mNumSamples (numSamples)
+        {
+            if constexpr (isEnabled)
+                mStart = juce::Time::getHighResolutionTicks();
+        }
+
+        ~ScopedTimer() noexcept
+        {
+            if constexpr (isEnabled)
+                mMeter.addBlock ((double) (juce::Time::getHighResolutionTicks() - mStart) * mMeter.mTicksToSeconds, mNumSamples);
+        }
+
+    private:
+        DspLoadMeter& mMeter;
+        int mNumSamples;
+        juce::int64 mStart = 0;
+
+        JUCE_DECLARE_NON_COPYABLE (ScopedTimer)
+    };
+
+private:
+    //==============================================================================
+    double mSampleRate = 0.0;
+    double mTicksToSeconds = 0.0;
+
+    std::atomic<float> mLoad { 0.0f };
+    std::atomic<float> mPeakLoad { 0.0f };
+    std::atomic<juce::uint32> mOverBudgetBlocks { 0 };
+    std::atomic<juce::uint64> mBlocks { 0 };
+    std::atomic<bool> mPeakResetRequested { false };
+};
@@ -0,0 +1,134 @@
+/*
+  ==============================================================================
+
+    EcoMode.h
+
+    Trading a little chorus quality for headroom when the CPU is busy.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    Picks a quality tier for each block, either the one the user chose or,
+    in auto mode, one that follows the DSP load.
+
+    Tier 0 is full quality. Each tier above gives up a bit more:
+    - 1: the LFOs are worked out every 8 samples, with straight lines between
+    - 2: every 16 samples, and the Hermite and Lagrange interpolators drop to
+      linear. The allpass keeps going, since restarting its recursive state
+      would click.
+    - 3: every 32 samples, and only half the voices run
+
+    None of these click. The LFOs stay where they were, and the interpolators
+    only differ in the top end. Voices that stop or start fade out or in
+    through ChorusControlPlane like any other change in the voice count.
+
+    In auto mode update() is given the load meter's average load. Above
+    raiseLoad it goes up a tier, then gives the average settleSeconds to
+    catch up before it would go up another. It only comes back down a tier
+    once the load has stayed below lowerLoad for holdSeconds. The gap between
+    the two thresholds, and the hold, stop it bouncing between tiers.
+
+    The load only counts the time processBlock takes, so the thresholds leave
+    most of each deadline to the rest of the chain. With WAYLOCHORUS_LOAD_METER=0
+    the load is always zero and auto mode stays at full quality.
+*/
+class EcoMode
+{
+public:
+    //==============================================================================
+    /** In the same order as the eco parameter's choices. */
+    enum class Setting
+    {
+        off,
+        automatic,
+        tier1,
+        tier2,
+        tier3
+    };
+
+    static constexpr int maxTier = 3;
+
+    static constexpr float raiseLoad = 0.5f;
+    static constexpr float lowerLoad = 0.25f;
+    static constexpr double settleSeconds = 0.5;
+    static constexpr double holdSeconds = 3.0;
+
+    /** Call from prepareToPlay. Starts again at full quality. */
+    void prepare (double sampleRate) noexcept
+    {
+        mSettleLength = (int) (settleSeconds * sampleRate);
+        mHoldLength = (int) (holdSeconds * sampleRate);
+        mTier = 0;
+        mSettleRemaining = 0;
+        mQuietSamples = 0;
+    }
+
+    /** Audio thread, once per block: the tier for a block of numSamples, given
+        the setting and the average load up to now.
+    */
+    int update (Setting setting, float load, int numSamples) noexcept
+    {
+        if (setting != Setting::automatic)
+        {
+            // auto mode starts from here if it's turned on
+            mTier = setting == Setting::off ? 0 : (int) setting - (int) Setting::automatic;
+            mSettleRemaining = 0;
+            mQuietSamples = 0;
+            return mTier;
+        }
+
+        mSettleRemaining = juce::jmax (0, mSettleRemaining - numSamples);
+
+        if (load > raiseLoad)
+        {
+            mQuietSamples = 0;
+
+            if (mTier < maxTier && mSettleRemaining == 0)
+            {
+                ++mTier;
+                mSettleRemaining = mSettleLength;
+            }
+        }
+        else if (load < lowerLoad && mTier > 0)
+        {
+            mQuietSamples += numSamples;
+
+            if (mQuietSamples >= mHoldLength)
+            {
+                --mTier;
+                mQuietSamples = 0;
+                mSettleRemaining = mSettleLength;
+            }
+        }
+        else
+        {
+            mQuietSamples = 0;
+        }
+
+        return mTier;
+    }
+
+    //==============================================================================
+    /** How many samples apart the LFOs are worked out at a tier. */
+    static constexpr int getControlInterval (int tier) noexcept { return tier == 0 ? 1 : 4 << tier; }
+
+    /** True if the cubic interpolators drop to linear at a tier. */
+    static constexpr bool usesLinearInterpolation (int tier) noexcept { return tier >= 2; }
+
+    /** True if only half the voices run at a tier. */
+    static constexpr bool halvesVoices (int tier) noexcept { return tier >= 3; }
+
+private:
+    //==============================================================================
+    int mTier = 0;
+    int mSettleLength = 0;
+    int mSettleRemaining = 0;
+    int mHoldLength = 0;
+    int mQuietSamples = 0;
+};
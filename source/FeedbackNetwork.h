@@ -0,0 +1,270 @@
+/*
+  ==============================================================================
+
+    FeedbackNetwork.h
+
+    Delay lines that feed the chorus voices back into each other.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "ChorusControl.h"
+#include "DelayLine.h"
+
+//==============================================================================
+/**
+    A small feedback delay network for the dense ensemble and dimension sounds.
+
+    Without feedback every voice can share one delay line. Here each voice
+    belongs to one of numLines lines, picked by getLineForVoice(), so voices
+    made from the same source voice share a line. Each line is written with
+    the input plus the feedback. The voices of a line are summed into its
+    send, and the sends go through a Hadamard matrix, so every line hears
+    every other. The result is scaled by the feedback amount, damped by a
+    one-pole lowpass, and added to what the lines store.
+
+    The matrix is orthogonal. Each line's send is also scaled so that its
+    voices can't add up to more than unity gain. So with feedback below one,
+    the loop loses level on every trip round and can't run away, however many
+    voices there are. The damping state is flushed to zero once it gets tiny,
+    so a dying tail doesn't fall into denormals on cores that don't flush them.
+
+    A voice count only changes how many taps feed the sends. The lines, the
+    matrix and the damping cost the same for 2 voices as for 32.
+
+    Voices have to read at least getMinDelay() behind the write head. Then a
+    block's taps never reach the samples that block is writing, so the block
+    path can store the input, read every voice, and add the feedback
+    afterwards. That gives the same result as doing it a sample at a time.
+*/
+template <typename SampleType, typename Stored = SampleType>
+class FeedbackNetwork
+{
+public:
+    //==============================================================================
+    static constexpr int numLines = 4;
+
+    using Line = DelayLine<SampleType, Stored>;
+
+    /** The line a voice reads from and sends to. */
+    static constexpr int getLineForVoice (int voice) noexcept { return voice % numLines; }
+
+    /** The shortest delay, in samples, a voice may read at with blocks of up to maxBlockSize. */
+    static constexpr float getMinDelay (int maxBlockSize) noexcept { return (float) (maxBlockSize + Interpolation::maxExtraSamples + 1); }
+
+    /** The unnormalised numLines by numLines Hadamard transform of x, in place.
+        Written once for plain samples and juce::dsp::SIMDRegister, so the block
+        path mixes a register's worth of samples at a time.
+    */
+    template <typename Value>
+    static void hadamard (Value* x) noexcept
+    {
+        static_assert (juce::isPowerOfTwo (numLines));
+
+        // butterflies, numLines log2 (numLines) adds rather than numLines squared multiply-adds
+        for (int half = 1; half < numLines; half *= 2)
+        {
+            for (int i = 0; i < numLines; i += 2 * half)
+            {
+                for (int j = i; j < i + half; ++j)
+                {
+                    const auto a = x[j];
+                    const auto b = x[j + half];
+                    x[j] = a + b;
+                    x[j + half] = a - b;
+                }
+            }
+        }
+    }
+
+    //==============================================================================
+    FeedbackNetwork() = default;
+
+    /** Prepares the lines for delays of up to maxDelayInSamples and blocks of up
+        to maxBlockSize, and clears them. Allocates, so it isn't realtime safe.
+    */
+    void prepare (int maxDelayInSamples, int maxBlockSize)
+    {
+        for (auto& line : mLines)
+            line.prepare (maxDelayInSamples, maxBlockSize);
+
+        // one cache aligned send row per line
+        constexpr int cacheLineSize = 64;
+        constexpr int samplesPerCacheLine = cacheLineSize / (int) sizeof (SampleType);
+        mRowStride = (maxBlockSize + samplesPerCacheLine - 1) & ~(samplesPerCacheLine - 1);
+
+        mRowStorage.allocate ((size_t) (numLines * mRowStride) * sizeof (SampleType) + cacheLineSize, true);
+
+        const auto address = reinterpret_cast<std::uintptr_t> (mRowStorage.get());
+        mRows = reinterpret_cast<SampleType*> ((address + cacheLineSize - 1) & ~(std::uintptr_t) (cacheLineSize - 1));
+
+        clear();
+    }
+
+    /** Silences the lines and the damping, leaving the write heads where they are. */
+    void clear() noexcept
+    {
+        for (auto& line : mLines)
+            line.clear();
+
+        std::fill (std::begin (mDampingState), std::end (mDampingState), SampleType());
+    }
+
+    /** Moves the write heads on without writing, see DelayLine::skip(). */
+    void skip (int numSamples) noexcept
+    {
+        for (auto& line : mLines)
+            line.skip (numSamples);
+    }
+
+    Line& getLine (int line) noexcept { return mLines[line]; }
+    int getSize() const noexcept { return mLines[0].getSize(); }
+
+    /** The row the block path adds each line's voices into, SIMD aligned. */
+    SampleType* getSendRow (int line) const noexcept { return mRows + line * mRowStride; }
+
+    //==============================================================================
+    /** Takes this block's feedback settings from the snapshot. Call it before
+        the first sample or block of each chunk.
+    */
+    void beginBlock (const ChorusControlSnapshot& control, int numSamples) noexcept
+    {
+        // the most each line's voices can add up to anywhere in the block, gains glide in straight lines
+        float sums[numLines] = {};
+
+        for (int v = 0; v < control.numVoices; ++v)
+            sums[getLineForVoice (v)] += juce::jmax (std::abs (control.gain[v]), std::abs (control.gain[v] + control.gainStep[v] * (float) numSamples));
+
+        // the 1 / sqrt (numLines) makes the Hadamard transform orthonormal
+        for (int line = 0; line < numLines; ++line)
+            mSendScale[line] = (SampleType) (1.0 / std::sqrt ((double) numLines) / juce::jmax (1.0f, sums[line]));
+
+        mFeedback = control.feedback;
+        mFeedbackStep = control.feedbackStep;
+        mDamping = (SampleType) control.dampingCoefficient;
+    }
+
+    /** Flushes the damping state once it has died away. Call it after each chunk. */
+    void endBlock() noexcept
+    {
+        for (auto& state : mDampingState)
+            juce::dsp::util::snapToZero (state);
+    }
+
+    //==============================================================================
+    /** Sample at a time: sends[line] holds the sum of that line's voices at
+        sample n of the block. Works out the feedback from it, writes it into
+        the lines with the input, and moves the write heads on.
+    */
+    void writeSample (SampleType input, const SampleType* sends, int n) noexcept
+    {
+        SampleType x[numLines];
+
+        for (int line = 0; line < numLines; ++line)
+            x[line] = sends[line] * mSendScale[line];
+
+        hadamard (x);
+
+        const auto amount = (SampleType) (mFeedback + mFeedbackStep * (float) n);
+
+        for (int line = 0; line < numLines; ++line)
+        {
+            mDampingState[line] += mDamping * (x[line] * amount - mDampingState[line]);
+
+            mLines[line].write (input + mDampingState[line]);
+            mLines[line].advance();
+        }
+    }
+
+    /** Block at a time: stores the input in every line and clears the send
+        rows. Read the voices into the rows next, then call feedBack().
+    */
+    void writeBlock (const SampleType* input, int numSamples) noexcept
+    {
+        jassert (numSamples <= mRowStride);
+
+        for (int line = 0; line < numLines; ++line)
+        {
+            mLines[line].writeBlock (input, numSamples);
+            juce::FloatVectorOperations::clear (getSendRow (line), numSamples);
+        }
+    }
+
+    /** Mixes the send rows through the matrix and the damping, and adds the
+        result to the block writeBlock() stored.
+    */
+    void feedBack (int numSamples) noexcept
+    {
+        using Vector = juce::dsp::SIMDRegister<SampleType>;
+        constexpr auto numLanes = (int) Vector::size();
+
+        SampleType* rows[numLines];
+
+        for (int line = 0; line < numLines; ++line)
+            rows[line] = getSendRow (line);
+
+        int n = 0;
+
+        // the matrix mixes across lines, so a register holds numLanes samples of one line
+        for (; n + numLanes <= numSamples; n += numLanes)
+        {
+            Vector x[numLines];
+
+            for (int line = 0; line < numLines; ++line)
+                x[line] = Vector::fromRawArray (rows[line] + n) * mSendScale[line];
+
+            hadamard (x);
+
+            for (int line = 0; line < numLines; ++line)
+                x[line].copyToRawArray (rows[line] + n);
+        }
+
+        for (; n < numSamples; ++n)
+        {
+            SampleType x[numLines];
+
+            for (int line = 0; line < numLines; ++line)
+                x[line] = rows[line][n] * mSendScale[line];
+
+            hadamard (x);
+
+            for (int line = 0; line < numLines; ++line)
+                rows[line][n] = x[line];
+        }
+
+        // the damping feeds each sample into the next, so it runs along each row on its own
+        for (int line = 0; line < numLines; ++line)
+        {
+            auto* row = rows[line];
+            auto state = mDampingState[line];
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                state += mDamping * (row[i] * (SampleType) (mFeedback + mFeedbackStep * (float) i) - state);
+                row[i] = state;
+            }
+
+            mDampingState[line] = state;
+            mLines[line].addToBlock (row, numSamples);
+        }
+    }
+
+private:
+    //==============================================================================
+    Line mLines[numLines];
+
+    juce::HeapBlock<char> mRowStorage;
+    SampleType* mRows = nullptr;
+    int mRowStride = 0;
+
+    SampleType mSendScale[numLines] {};
+    SampleType mDampingState[numLines] {};
+    SampleType mDamping = 1;
+    float mFeedback = 0.0f;
+    float mFeedbackStep = 0.0f;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FeedbackNetwork)
+};
@@ -0,0 +1,198 @@
+/*
+  ==============================================================================
+
+    Interpolation.h
+
+    Fractional delay read methods, one policy struct per quality mode.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "DelayStorage.h"
+
+//==============================================================================
+/**
+    The ways a delay tap can be read between two samples.
+
+    Each mode is a struct with a static read() that DelayLine and the processor
+    take as a template argument. The mode is chosen once per block, and each
+    one compiles into its own inner loop with no per-sample branch on the mode.
+
+    read() gets the whole circular buffer, its wrap mask, the index of the
+    sample at or before the read position, and the fraction of the way to the
+    next one. It works on float or double samples, stored in any of the
+    DelayStorage formats. The state is per tap and only used by the allpass,
+    which needs its previous output. Modes with isRecursive set can't compute
+    several outputs of a tap at once.
+
+    readStereo() does the same for a buffer of interleaved left/right frames,
+    reading both channels at one position, with a state for each.
+*/
+namespace Interpolation
+{
+    enum class Mode
+    {
+        linear,
+        hermite,
+        lagrange,
+        allpass
+    };
+
+    /** How many samples past the longest delay any mode reads, so the delay lines leave room for them. */
+    static constexpr int maxExtraSamples = 3;
+
+    /** The most stored samples any mode looks at for one output. */
+    static constexpr int maxPoints = 4;
+
+    //==============================================================================
+    /** Shared read() for the modes that only look at the stored samples.
+
+        Policy::interpolate() takes the numPoints samples from index + firstPoint
+        onwards and the fraction, and is written once for plain samples and
+        juce::dsp::SIMDRegister. So the vectorised kernel can run it on a
+        register's worth of samples at a time, and gives the same results as the
+        scalar read.
+    */
+    template <typename Policy>
+    struct Stateless
+    {
+        static constexpr bool isRecursive = false;
+
+        template <typename SampleType, typename Stored>
+        static SampleType read (const Stored* buffer, int mask, int index, SampleType frac, SampleType& /*state*/) noexcept
+        {
+            SampleType points[Policy::numPoints];
+
+            for (int p = 0; p < Policy::numPoints; ++p)
+                points[p] = (SampleType) DelayStorage::Format<Stored>::load (buffer[(index + Policy::firstPoint + p) & mask]);
+
+            return Policy::interpolate (points, frac);
+        }
+
+        template <typename SampleType, typename Stored>
+        static void readStereo (const Stored* frames, int mask, int index, SampleType frac, SampleType& /*stateLeft*/, SampleType& /*stateRight*/,
+                                SampleType& left, SampleType& right) noexcept
+        {
+            SampleType pointsLeft[Policy::numPoints], pointsRight[Policy::numPoints];
+
+            for (int p = 0; p < Policy::numPoints; ++p)
+            {
+                // both channels of a frame sit side by side, one fetch brings in the pair
+                const auto* frame = frames + 2 * ((index + Policy::firstPoint + p) & mask);
+                pointsLeft[p] = (SampleType) DelayStorage::Format<Stored>::load (frame[0]);
+                pointsRight[p] = (SampleType) DelayStorage::Format<Stored>::load (frame[1]);
+            }
+
+            left = Policy::interpolate (pointsLeft, frac);
+            right = Policy::interpolate (pointsRight, frac);
+        }
+    };
+
+    //==============================================================================
+    /** Two-point linear interpolation, the original read method. Cheap, but it dulls the highs as the delay moves. */
+    struct Linear : Stateless<Linear>
+    {
+        static constexpr int firstPoint = 0;
+        static constexpr int numPoints = 2;
+
+        template <typename Value>
+        static Value interpolate (const Value* x, Value frac) noexcept
+        {
+            return (Value (1.0f) - frac) * x[0] + frac * x[1];
+        }
+    };
+
+    /** Four-point, third-order Hermite spline. Flat passband with little ringing, good for wide, slow sweeps. */
+    struct Hermite : Stateless<Hermite>
+    {
+        static constexpr int firstPoint = -1;
+        static constexpr int numPoints = 4;
+
+        template <typename Value>
+        static Value interpolate (const Value* x, Value frac) noexcept
+        {
+            const auto c1 = (x[2] - x[0]) * 0.5f;
+            const auto c2 = x[0] - x[1] * 2.5f + x[2] * 2.0f - x[3] * 0.5f;
+            const auto c3 = (x[3] - x[0]) * 0.5f + (x[1] - x[2]) * 1.5f;
+
+            return ((c3 * frac + c2) * frac + c1) * frac + x[1];
+        }
+    };
+
+    /** Four-point, third-order Lagrange. Slightly brighter than Hermite, at about the same cost. */
+    struct Lagrange : Stateless<Lagrange>
+    {
+        static constexpr int firstPoint = -1;
+        static constexpr int numPoints = 4;
+
+        template <typename Value>
+        static Value interpolate (const Value* x, Value frac) noexcept
+        {
+            const auto dm1 = frac + 1.0f;
+            const auto d1 = frac - 1.0f;
+            const auto d2 = frac - 2.0f;
+
+            return x[1] * dm1 * d1 * d2 * 0.5f
+                 + x[3] * dm1 * frac * d1 * (1.0f / 6.0f)
+                 - x[0] * frac * d1 * d2 * (1.0f / 6.0f)
+                 - x[2] * dm1 * frac * d2 * 0.5f;
+        }
+    };
+
+    /** First-order allpass. Flat magnitude response at any delay, so the highs
+        stay intact, at the cost of a little phase smearing. It keeps its
+        previous output in the tap state, so taps must be read once per sample
+        in order.
+    */
+    struct Allpass
+    {
+        static constexpr bool isRecursive = true;
+
+        template <typename SampleType, typename Stored>
+        static SampleType read (const Stored* buffer, int mask, int index, SampleType frac, SampleType& state) noexcept
+        {
+            using Format = DelayStorage::Format<Stored>;
+
+            // keep the allpass delay between 0.5 and 1.5 samples, where its coefficient stays well away from -1
+            if (frac > SampleType (0.5))
+            {
+                ++index;
+                frac -= SampleType (1);
+            }
+
+            // fractional delay from the newer sample, and the matching allpass coefficient
+            const auto delta = SampleType (1) - frac;
+            const auto eta = (SampleType (1) - delta) / (SampleType (1) + delta);
+
+            state = eta * ((SampleType) Format::load (buffer[(index + 1) & mask]) - state) + (SampleType) Format::load (buffer[index & mask]);
+            return state;
+        }
+
+        template <typename SampleType, typename Stored>
+        static void readStereo (const Stored* frames, int mask, int index, SampleType frac, SampleType& stateLeft, SampleType& stateRight,
+                                SampleType& left, SampleType& right) noexcept
+        {
+            using Format = DelayStorage::Format<Stored>;
+
+            if (frac > SampleType (0.5))
+            {
+                ++index;
+                frac -= SampleType (1);
+            }
+
+            const auto delta = SampleType (1) - frac;
+            const auto eta = (SampleType (1) - delta) / (SampleType (1) + delta);
+
+            const auto* older = frames + 2 * (index & mask);
+            const auto* newer = frames + 2 * ((index + 1) & mask);
+
+            stateLeft = eta * ((SampleType) Format::load (newer[0]) - stateLeft) + (SampleType) Format::load (older[0]);
+            stateRight = eta * ((SampleType) Format::load (newer[1]) - stateRight) + (SampleType) Format::load (older[1]);
+            left = stateLeft;
+            right = stateRight;
+        }
+    };
+}
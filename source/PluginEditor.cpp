@@ -16,6 +16,13 @@ Waylochorus2AudioProcessorEditor::Waylochorus2AudioProcessorEditor (Waylochorus2
     // Make sure that before the constructor has finished, you've set the
     // editor's size to whatever you need it to be.
     setSize (400, 300);
+
+    if (DspLoadMeter::isEnabled)
+    {
+        mLoadLabel.setJustificationType (juce::Justification::centred);
+        addAndMakeVisible (mLoadLabel);
+        startTimerHz (4);
+    }
 }
 
 Waylochorus2AudioProcessorEditor::~Waylochorus2AudioProcessorEditor()
@@ -37,4 +44,16 @@ void Waylochorus2AudioProcessorEditor::resized()
 {
     // This is generally where you'll want to lay out the positions of any
     // subcomponents in your editor..
+    mLoadLabel.setBounds (getLocalBounds().removeFromBottom (30));
+}
+
+void Waylochorus2AudioProcessorEditor::timerCallback()
+{
+    const auto stats = audioProcessor.getLoadMeter().getStats();
+
+    mLoadLabel.setText ("DSP load " + juce::String (stats.load * 100.0f, 1) + " %, peak "
+                            + juce::String (stats.peakLoad * 100.0f, 1) + " %, "
+                            + juce::String ((int) stats.overBudgetBlocks) + " blocks over budget"
+                            + (audioProcessor.getEcoTier() > 0 ? ", eco " + juce::String (audioProcessor.getEcoTier()) : juce::String()),
+                        juce::dontSendNotification);
 }
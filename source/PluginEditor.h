@@ -14,7 +14,8 @@
 //==============================================================================
 /**
 */
-class Waylochorus2AudioProcessorEditor  : public juce::AudioProcessorEditor
+class Waylochorus2AudioProcessorEditor  : public juce::AudioProcessorEditor,
+                                          private juce::Timer
 {
 public:
     Waylochorus2AudioProcessorEditor (Waylochorus2AudioProcessor&);
@@ -29,5 +30,10 @@ private:
     // access the processor object that created it.
     Waylochorus2AudioProcessor& audioProcessor;
 
+    // DSP load readout, refreshed from the processor's load meter a few times a second
+    juce::Label mLoadLabel;
+
+    void timerCallback() override;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Waylochorus2AudioProcessorEditor)
 };
@@ -21,22 +21,21 @@ Waylochorus2AudioProcessor::Waylochorus2AudioProcessor()
                      #endif
                        )
 #endif
+    , mState (*this, nullptr, "PARAMETERS", ChorusParameters::createParameterLayout()),
+      mParameters (mState)
 {
-    
-    // initialize buffer values
-    mCircularBufferWriteHead = mCircularBufferWriteHeadTwo =  mCircularBufferWriteHeadThree = mCircularBufferWriteHeadFour = 0;
-    
-    mDelayTimeInSamples = mDelayTwoTimeInSamples = mDelayThreeTimeInSamples = mDelayFourTimeInSamples = 0.0;
-    
-    mDelayReadHead = mDelayTwoReadHead = mDelayThreeReadHead = mDelayFourReadHead =  0.0;
-    
-    mLFOphase = mLFOphaseTwo = mLFOphaseThree = mLFOphaseFour = 0;
-    
-    mLFOrate = mLFOrateTwo= mLFOrateThree = mLFOrateFour  = 0.3f;
+   #if WAYLOCHORUS_TRACE
+    const auto traceFile = juce::SystemStats::getEnvironmentVariable ("WAYLOCHORUS_TRACE_FILE", {});
+    mTraceWriter = std::make_unique<TraceFileWriter> (mTrace, traceFile.isNotEmpty() ? juce::File (traceFile)
+                                                                                    : juce::File::getSpecialLocation (juce::File::tempDirectory)
+                                                                                          .getNonexistentChildFile ("waylochorus-trace", ".json"));
+   #endif
 }
 
 Waylochorus2AudioProcessor::~Waylochorus2AudioProcessor()
 {
+    // a worker still on a late task uses the signal paths and the trace, which go before the pool does
+    mWorkerPool.setNumWorkers (0);
 }
 
 //==============================================================================
@@ -45,10 +44,15 @@ const juce::String Waylochorus2AudioProcessor::getName() const
     return JucePlugin_Name;
 }
 
-float Waylochorus2AudioProcessor::linInterp(float sample_x, float sample_x1, float inPhase)
+void Waylochorus2AudioProcessor::setNumVoices (int newNumVoices)
 {
-    return (1 - inPhase) * sample_x + inPhase * sample_x1;
-    
+    auto* parameter = mState.getParameter (ChorusParameters::numVoicesId);
+    parameter->setValueNotifyingHost (parameter->convertTo0to1 ((float) newNumVoices));
+}
+
+int Waylochorus2AudioProcessor::getNumVoices() const
+{
+    return juce::roundToInt (mState.getRawParameterValue (ChorusParameters::numVoicesId)->load());
 }
 
 bool Waylochorus2AudioProcessor::acceptsMidi() const
@@ -80,31 +84,62 @@ bool Waylochorus2AudioProcessor::isMidiEffect() const
 
 double Waylochorus2AudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    // without feedback, the last thing to come out is the input delayed by the longest voice
+    const auto longestDelay = ChorusVoiceTable::maxDelayMs / 1000.0;
+
+    if (! mParameters.isFeedbackNetworkEnabled())
+        return longestDelay;
+
+    // each trip round the network, at most the longest delay, loses at least 1 - feedback of the
+    // level; count the trips it takes to fall 120 dB
+    const auto feedback = juce::jlimit (0.01, (double) ChorusParameters::maxFeedback, (double) mParameters.getFeedback());
+    return longestDelay * (1.0 + std::ceil (-6.0 / std::log10 (feedback)));
 }
 
 int Waylochorus2AudioProcessor::getNumPrograms()
 {
-    return 1;   // NB: some hosts don't cope very well if you tell them there are 0 programs,
-                // so this should be at least 1, even if you're not really implementing programs.
+    return ChorusPresets::numPresets;
 }
 
 int Waylochorus2AudioProcessor::getCurrentProgram()
 {
-    return 0;
+    return mCurrentProgram.load();
 }
 
 void Waylochorus2AudioProcessor::setCurrentProgram (int index)
 {
+    if (! juce::isPositiveAndBelow (index, ChorusPresets::numPresets))
+        return;
+
+    mCurrentProgram = index;
+
+    ChorusParameters::HashedValue values[ChorusPresets::maxValues];
+    int numValues = 0;
+
+    for (const auto& value : ChorusPresets::presets[index].values)
+    {
+        if (value.id == nullptr)
+            break;
+
+        values[numValues++] = { ChorusParameters::hashId (value.id), value.value };
+    }
+
+    // the processor fades across the switch, see updateSettings()
+    mParameters.setAll (values, numValues);
 }
 
 const juce::String Waylochorus2AudioProcessor::getProgramName (int index)
 {
-    return {};
+    if (! juce::isPositiveAndBelow (index, ChorusPresets::numPresets))
+        return {};
+
+    return ChorusPresets::presets[index].name;
 }
 
 void Waylochorus2AudioProcessor::changeProgramName (int index, const juce::String& newName)
 {
+    // the bank is built in, so its names stay as they are
+    juce::ignoreUnused (index, newName);
 }
 
 //==============================================================================
@@ -113,42 +148,75 @@ void Waylochorus2AudioProcessor::prepareToPlay (double sampleRate, int samplesPe
 {
     // Use this method as the place to do any pre-playback
     // initialisation that you need..
-    
-    
-    
-    mLFOphase = mLFOphaseTwo = mLFOphaseThree = mLFOphaseFour  = 0;
-    
-    mLFOrateTwo = mLFOrateTwo = mLFOrateThree = mLFOrateFour =  0.3f  ;
-    
-    
-    
-    
-    // Use this method as the place to do any pre-playback
-    // initialisation that you need..
-    // mCircularBufferLength = sampleRate*MAX_DELAY_TIME;
-    mCircularBufferLength = 96000;
-    mCircularBufferWriteHead = 0;
-    mCircularBufferWriteHeadTwo = 0;
-    mCircularBufferWriteHeadThree = 0;
-    mCircularBufferWriteHeadFour = 0;
+    WAYLOCHORUS_TRACE_SCOPE (mTrace, "prepareToPlay", samplesPerBlock);
+    mLoadMeter.prepare (sampleRate);
 
-    
-    
-    mDelayReadHead = 0.0;
-    mDelayTwoReadHead = 0.0;
-    mDelayThreeReadHead = 0.0;
-    mDelayFourReadHead =0.0;
+    // the voice table below is built at full quality
+    mEco.prepare (sampleRate);
+    mEcoTier = 0;
+    mReportedEcoTier = 0;
 
-    
-    
-    
-    
+    mParameters.invalidate();
+    mParameters.updateVoiceTable (mVoices);
+    mVoices.resetPhases();
+
+    mControl.prepare (sampleRate);
+    mControl.reset (mVoices);
+
+    // everything runs a sub-block at a time, however big the host's blocks are
+    mLfo.prepare (sampleRate);
+
+    // round each row up to whole cache lines, so every voice's row is aligned for the vectorised kernel
+    constexpr int cacheLineSize = 64;
+    constexpr int floatsPerCacheLine = cacheLineSize / (int) sizeof (float);
+    mLfoStride = (subBlockSize + floatsPerCacheLine - 1) & ~(floatsPerCacheLine - 1);
+
+    const auto numScratchFloats = (size_t) (ChorusVoiceTable::maxVoices * mLfoStride);
+    mScratch.allocate (numScratchFloats * sizeof (float) + cacheLineSize, true);
+
+    const auto address = reinterpret_cast<std::uintptr_t> (mScratch.get());
+    mLfoBuffer = reinterpret_cast<float*> ((address + cacheLineSize - 1) & ~(std::uintptr_t) (cacheLineSize - 1));
+
+    // size the delay lines for the longest modulated delay at this sample rate, this also clears them;
+    // the host picks the precision before preparing, so only that path needs the memory
+    const auto maxDelayInSamples = (int) std::ceil (ChorusVoiceTable::maxDelayMs / 1000.0 * sampleRate);
+
+    // the host isn't processing, so the threads can be swapped out; a worker that fell behind
+    // may still be reading the lines, so let it finish before they're reallocated
+    if (mWorkerPool.getNumWorkers() != mNumWorkerThreads)
+        mWorkerPool.setNumWorkers (mNumWorkerThreads);
+
+    mWorkerPool.waitUntilIdle();
+
+    // and only the lines this bus layout and delay line layout read are allocated
+    const auto isStereo = getTotalNumInputChannels() > 1 && getTotalNumOutputChannels() > 1;
+
+    if (isUsingDoublePrecision())
+        mDoublePath.prepare (sampleRate, maxDelayInSamples, subBlockSize, mWorkerPool.getNumThreads(), isStereo, mDelayLineLayout);
+    else
+        mFloatPath.prepare (sampleRate, maxDelayInSamples, subBlockSize, mWorkerPool.getNumThreads(), isStereo, mDelayLineLayout);
+
+    mSubBlockSeconds = subBlockSize / sampleRate;
+    mWorkerBackoffLength = (int) (workerBackoffSeconds * sampleRate);
+    mWorkerBackoffSamples = 0;
+
+    // the interpolators reach a few samples past the delay time
+    mTailSamples = maxDelayInSamples + Interpolation::maxExtraSamples + 1;
+    mSilentSamples = 0;
+    mIsIdle = false;
+
+    // the parameters were just read, so there's nothing to switch to
+    mAppliedPresetSequence = mParameters.getPresetSequence();
+    mSwitchingPreset = false;
+    mPresetGain = 1.0f;
+    mPresetGainStep = (float) (1.0 / (presetFadeSeconds * sampleRate));
 }
 
 void Waylochorus2AudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
+    mWorkerPool.setNumWorkers (0);
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -166,9 +234,10 @@ bool Waylochorus2AudioProcessor::isBusesLayoutSupported (const BusesLayout& layo
      && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
         return false;
 
-    // This checks if the input layout matches the output layout
+    // The input has to match the output, except that a mono input can be spread across stereo
    #if ! JucePlugin_IsSynth
-    if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
+    if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet()
+     && layouts.getMainInputChannelSet() != juce::AudioChannelSet::mono())
         return false;
    #endif
 
@@ -179,6 +248,21 @@ bool Waylochorus2AudioProcessor::isBusesLayoutSupported (const BusesLayout& layo
 
 void Waylochorus2AudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
+    juce::ignoreUnused (midiMessages);
+    processSamples (buffer);
+}
+
+void Waylochorus2AudioProcessor::processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+    juce::ignoreUnused (midiMessages);
+    processSamples (buffer);
+}
+
+template <typename SampleType>
+void Waylochorus2AudioProcessor::processSamples (juce::AudioBuffer<SampleType>& buffer) noexcept
+{
+    const DspLoadMeter::ScopedTimer loadTimer (mLoadMeter, buffer.getNumSamples());
+    WAYLOCHORUS_TRACE_SCOPE (mTrace, "processBlock", buffer.getNumSamples());
     juce::ScopedNoDenormals noDenormals;
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
@@ -191,229 +275,851 @@ void Waylochorus2AudioProcessor::processBlock (juce::AudioBuffer<float>& buffer,
     // this code if your algorithm always overwrites all the output channels.
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
-    
-    float* LeftChannel;
-    float* RightChannel;
-    
-    if (totalNumInputChannels >1){
-        LeftChannel = buffer.getWritePointer(0);
-        RightChannel = buffer.getWritePointer(0);
-    }
-    else
+
+    auto& path = getSignalPath<SampleType>();
+
+    // nothing to read from until prepareToPlay has allocated the delay lines, for a stereo layout too
+    if (path.delayLineLeft.getSize() == 0 || (totalNumInputChannels > 1 && totalNumOutputChannels > 1 && ! path.isStereo))
     {
-        LeftChannel = buffer.getWritePointer(0);
-        RightChannel = buffer.getWritePointer(1);
-        
+        buffer.clear();
+        return;
     }
-
+    
     // This is the place where you'd normally do the guts of your plugin's
     // audio processing...
     // Make sure to reset the state if your inner loop is processing
     // the samples and the outer loop is handling the channels.
     // Alternatively, you can process the samples with the channels
     // interleaved by keeping the same state.
-    for (int i = 0; i < buffer.getNumSamples(); ++i)
-       {
-
-           float lfoOut = sin(2*M_PI * mLFOphase);
-           float lfoOutTwo = sin(2*M_PI * mLFOphaseTwo);
-           float lfoOutThree = sin(2*M_PI * mLFOphaseThree);
-           float lfoOutFour = sin(2*M_PI * mLFOphaseFour);
-
-        // ### NUMBERS HERE
-           mLFOphase += 0.65/getSampleRate();
-           mLFOphaseTwo += 0.57/getSampleRate();
-           mLFOphaseThree += 0.48/getSampleRate();
-           mLFOphaseFour += 0.44/getSampleRate();
-           
-           // LFO phase is moving between zero and one
-            if ( mLFOphase > 1){
-                mLFOphase -= 1;
+
+    const auto numSamples = buffer.getNumSamples();
+
+    // silent input only has to be processed until the delay lines have played out what came before it
+    const auto inputIsSilent = isSilent (buffer, totalNumInputChannels);
+    const auto tailHasDecayed = mSilentSamples >= mTailSamples;
+    mSilentSamples = inputIsSilent ? juce::jmin (mSilentSamples + numSamples, mTailSamples) : 0;
+
+    if (mSilenceBypassEnabled && inputIsSilent && tailHasDecayed)
+    {
+        skipIdleBlock<SampleType> (numSamples);
+        buffer.clear();
+        return;
+    }
+
+    mIsIdle = false;
+
+    // the load is the average up to the last block, so a tier is never picked from the block it slows down
+    if (const auto tier = mEco.update (mParameters.getEcoSetting(), mLoadMeter.getStats().load, numSamples); tier != mEcoTier)
+    {
+        // the voice table is rebuilt with the new tier's voice count by the next parameter update
+        mEcoTier = tier;
+        mReportedEcoTier.store (tier, std::memory_order_relaxed);
+        mParameters.invalidate();
+    }
+
+    // the workers go to sleep when there's nothing to do for a while, have them spinning again
+    // by the time the first sub-block's voices are handed out
+    mWorkerBackoffSamples = juce::jmax (0, mWorkerBackoffSamples - numSamples);
+
+    if (mWorkerPool.getNumWorkers() > 0 && mWorkerBackoffSamples == 0)
+        mWorkerPool.wake();
+
+    const auto layout = totalNumOutputChannels < 2 ? ChannelLayout::mono
+                      : totalNumInputChannels < 2  ? ChannelLayout::monoToStereo
+                                                   : ChannelLayout::stereo;
+
+    const auto* leftIn = buffer.getReadPointer (0);
+    const auto* rightIn = layout == ChannelLayout::stereo ? buffer.getReadPointer (1) : nullptr;
+    auto* leftOut = buffer.getWritePointer (0);
+    auto* rightOut = layout != ChannelLayout::mono ? buffer.getWritePointer (1) : nullptr;
+
+    // the channels a layout doesn't use stay null, the kernels never touch them
+    const auto channelAt = [] (auto* channel, int chunkStart) { return channel != nullptr ? channel + chunkStart : nullptr; };
+
+    for (int chunkStart = 0; chunkStart < numSamples; chunkStart += subBlockSize)
+    {
+        const auto chunkLength = juce::jmin ((int) subBlockSize, numSamples - chunkStart);
+
+        // a parameter change lands within a sub-block of where the host's block catches it, not a whole block later
+        const auto presetGainAtStart = mPresetGain;
+        updateSettings<SampleType> (chunkLength);
+
+        // in the mono sum mode both input channels go into one delay line, and the voices are panned back out;
+        // the feedback network and the BBD emulation always work that way
+        const auto sumToMono = layout == ChannelLayout::stereo && (mStereoMode == ChorusParameters::StereoMode::monoSum || mFeedbackNetworkEnabled || mBbdEnabled);
+        const auto kernelLayout = sumToMono ? ChannelLayout::monoToStereo
+                                : layout == ChannelLayout::stereo && path.delayLineLayout == DelayLineLayout::interleaved ? ChannelLayout::stereoInterleaved
+                                                                                                                        : layout;
+
+        // everything derived from the sample rate and voice settings is worked out once per sub-block
+        {
+            WAYLOCHORUS_TRACE_SCOPE (mTrace, "control", chunkLength);
+            mControl.update (mVoices, chunkLength);
+        }
+
+        const auto& control = mControl.getSnapshot();
+
+        {
+            WAYLOCHORUS_TRACE_SCOPE (mTrace, "lfo", chunkLength);
+            mLfo.process (control, mVoices.phase, mLfoBuffer, mLfoStride, chunkLength, EcoMode::getControlInterval (mEcoTier));
+
+            // the network adds each block's feedback after its taps are read, so they mustn't reach into the block
+            const auto minDelay = mFeedbackNetworkEnabled ? FeedbackNetwork<SampleType>::getMinDelay (subBlockSize) : 0.0f;
+
+            // add the modulated delay time to the base delay time of each voice, both glide to new settings
+            for (int v = 0; v < control.numVoices; ++v)
+            {
+                auto* delayTimes = mLfoBuffer + v * mLfoStride;
+                const auto offset = control.delayOffset[v];
+                const auto offsetStep = control.delayOffsetStep[v];
+                const auto scale = control.delayScale[v];
+                const auto scaleStep = control.delayScaleStep[v];
+
+                for (int n = 0; n < chunkLength; ++n)
+                    delayTimes[n] = juce::jmax (minDelay, (offset + offsetStep * (float) n) + (scale + scaleStep * (float) n) * delayTimes[n]);
+            }
+        }
+
+        if (sumToMono)
+        {
+            // halved, so a centred source comes out at the level it went in
+            WAYLOCHORUS_TRACE_SCOPE (mTrace, "mono sum", chunkLength);
+            juce::FloatVectorOperations::copyWithMultiply (path.monoSum, leftIn + chunkStart, (SampleType) 0.5, chunkLength);
+            juce::FloatVectorOperations::addWithMultiply (path.monoSum, rightIn + chunkStart, (SampleType) 0.5, chunkLength);
+        }
+
+        // one specialised loop per interpolation mode, channel layout and kernel, the switches happen once per chunk
+        const auto renderLayout = [&] (auto interpolator, auto channelLayout)
+        {
+            using Interpolator = decltype (interpolator);
+            constexpr auto chunkLayout = decltype (channelLayout)::value;
+
+            const auto* chunkLeftIn = sumToMono ? path.monoSum : leftIn + chunkStart;
+            const auto* chunkRightIn = sumToMono ? nullptr : channelAt (rightIn, chunkStart);
+            auto* chunkLeftOut = leftOut + chunkStart;
+            auto* chunkRightOut = channelAt (rightOut, chunkStart);
+
+            if constexpr (chunkLayout == ChannelLayout::mono || chunkLayout == ChannelLayout::monoToStereo)
+            {
+                if (mFeedbackNetworkEnabled)
+                {
+                    if (mKernel == Kernel::scalar)
+                        processFeedbackChunkScalar<SampleType, Interpolator, chunkLayout> (chunkLeftIn, chunkLeftOut, chunkRightOut, chunkLength, control);
+                    else if (chunkLength == subBlockSize)
+                        processFeedbackChunkVectorised<SampleType, Interpolator, chunkLayout> (chunkLeftIn, chunkLeftOut, chunkRightOut, std::integral_constant<int, subBlockSize>(), control);
+                    else
+                        processFeedbackChunkVectorised<SampleType, Interpolator, chunkLayout> (chunkLeftIn, chunkLeftOut, chunkRightOut, chunkLength, control);
+
+                    return;
+                }
+
+                if (mBbdEnabled)
+                {
+                    if (mKernel == Kernel::scalar)
+                        processBbdChunkScalar<SampleType, chunkLayout> (chunkLeftIn, chunkLeftOut, chunkRightOut, chunkLength, control);
+                    else if (chunkLength == subBlockSize)
+                        processBbdChunkVectorised<SampleType, chunkLayout> (chunkLeftIn, chunkLeftOut, chunkRightOut, std::integral_constant<int, subBlockSize>(), control);
+                    else
+                        processBbdChunkVectorised<SampleType, chunkLayout> (chunkLeftIn, chunkLeftOut, chunkRightOut, chunkLength, control);
+
+                    return;
+                }
+            }
+
+            if (mKernel == Kernel::scalar)
+                processChunkScalar<SampleType, Interpolator, chunkLayout> (chunkLeftIn, chunkRightIn, chunkLeftOut, chunkRightOut, chunkLength, control);
+            else if (chunkLength == subBlockSize)
+                processChunkVectorised<SampleType, Interpolator, chunkLayout> (chunkLeftIn, chunkRightIn, chunkLeftOut, chunkRightOut, std::integral_constant<int, subBlockSize>(), control);
+            else
+                processChunkVectorised<SampleType, Interpolator, chunkLayout> (chunkLeftIn, chunkRightIn, chunkLeftOut, chunkRightOut, chunkLength, control);
+        };
+
+        const auto renderChunk = [&] (auto interpolator)
+        {
+            switch (kernelLayout)
+            {
+                case ChannelLayout::mono:         renderLayout (interpolator, std::integral_constant<ChannelLayout, ChannelLayout::mono>()); break;
+                case ChannelLayout::monoToStereo: renderLayout (interpolator, std::integral_constant<ChannelLayout, ChannelLayout::monoToStereo>()); break;
+                case ChannelLayout::stereo:       renderLayout (interpolator, std::integral_constant<ChannelLayout, ChannelLayout::stereo>()); break;
+                case ChannelLayout::stereoInterleaved: renderLayout (interpolator, std::integral_constant<ChannelLayout, ChannelLayout::stereoInterleaved>()); break;
+            }
+        };
+
+        switch (mInterpolationMode)
+        {
+            case Interpolation::Mode::linear:   renderChunk (Interpolation::Linear()); break;
+            case Interpolation::Mode::hermite:  renderChunk (Interpolation::Hermite()); break;
+            case Interpolation::Mode::lagrange: renderChunk (Interpolation::Lagrange()); break;
+            case Interpolation::Mode::allpass:  renderChunk (Interpolation::Allpass()); break;
+        }
+
+        if (presetGainAtStart != 1.0f || mPresetGain != 1.0f)
+        {
+            WAYLOCHORUS_TRACE_SCOPE (mTrace, "preset fade", chunkLength);
+
+            for (int channel = 0; channel < totalNumOutputChannels; ++channel)
+                buffer.applyGainRamp (channel, chunkStart, chunkLength, (SampleType) presetGainAtStart, (SampleType) mPresetGain);
+        }
+    }
+
+    // feedback keeps the sound going after the input stops, so the tail only counts down once the output is quiet too
+    if (mFeedbackNetworkEnabled && ! isSilent (buffer, totalNumOutputChannels))
+        mSilentSamples = 0;
+}
+
+template <typename SampleType, typename Interpolator, Waylochorus2AudioProcessor::ChannelLayout layout>
+void Waylochorus2AudioProcessor::processChunkScalar (const SampleType* leftIn, const SampleType* rightIn, SampleType* leftOut, SampleType* rightOut, int chunkLength, const ChorusControlSnapshot& control) noexcept
+{
+    WAYLOCHORUS_TRACE_SCOPE (mTrace, "scalar kernel", chunkLength);
+    auto& path = getSignalPath<SampleType>();
+
+    if constexpr (layout == ChannelLayout::monoToStereo)
+    {
+        std::copy (control.gainLeft, control.gainLeft + control.numVoices, mTapGainsLeft);
+        std::copy (control.gainRight, control.gainRight + control.numVoices, mTapGainsRight);
+    }
+    else
+    {
+        std::copy (control.gain, control.gain + control.numVoices, mTapGains);
+    }
+
+    for (int n = 0; n < chunkLength; ++n)
+    {
+        if constexpr (layout == ChannelLayout::stereoInterleaved)
+        {
+            // one write and one read per voice covers both channels
+            path.delayLineStereo.write (leftIn[n], rightIn[n]);
+            path.delayLineStereo.template readTaps<Interpolator> (mLfoBuffer + n, mLfoStride, mTapGains, path.interpolatorStateLeft, path.interpolatorStateRight,
+                                                                  control.numVoices, leftOut[n], rightOut[n]);
+            path.delayLineStereo.advance();
+
+            juce::FloatVectorOperations::add (mTapGains, control.gainStep, control.numVoices);
+        }
+        else
+        {
+            // shove the input into the circular buffers, every voice reads from these
+            path.delayLineLeft.write (leftIn[n]);
+
+            if constexpr (layout == ChannelLayout::stereo)
+                path.delayLineRight.write (rightIn[n]);
+
+            if constexpr (layout == ChannelLayout::monoToStereo)
+            {
+                path.delayLineLeft.template readTapsPanned<Interpolator> (mLfoBuffer + n, mLfoStride, mTapGainsLeft, mTapGainsRight, path.interpolatorStateLeft, control.numVoices, leftOut[n], rightOut[n]);
+
+                juce::FloatVectorOperations::add (mTapGainsLeft, control.gainLeftStep, control.numVoices);
+                juce::FloatVectorOperations::add (mTapGainsRight, control.gainRightStep, control.numVoices);
+            }
+            else
+            {
+                leftOut[n] = path.delayLineLeft.template readTaps<Interpolator> (mLfoBuffer + n, mLfoStride, mTapGains, path.interpolatorStateLeft, control.numVoices);
+
+                if constexpr (layout == ChannelLayout::stereo)
+                    rightOut[n] = path.delayLineRight.template readTaps<Interpolator> (mLfoBuffer + n, mLfoStride, mTapGains, path.interpolatorStateRight, control.numVoices);
+
+                juce::FloatVectorOperations::add (mTapGains, control.gainStep, control.numVoices);
             }
-            if ( mLFOphaseTwo > 1){
-                mLFOphaseTwo -= 1;
+
+            path.delayLineLeft.advance();
+
+            if constexpr (layout == ChannelLayout::stereo)
+                path.delayLineRight.advance();
+        }
+    }
+}
+
+template <typename SampleType, typename Interpolator, Waylochorus2AudioProcessor::ChannelLayout layout, typename Length>
+void Waylochorus2AudioProcessor::processChunkVectorised (const SampleType* leftIn, const SampleType* rightIn, SampleType* leftOut, SampleType* rightOut, Length length, const ChorusControlSnapshot& control) noexcept
+{
+    // a constant for a full sub-block, which the inlined loops below are unrolled and vectorised around
+    const int chunkLength = length;
+
+    if constexpr (Interpolator::isRecursive)
+    {
+        // each allpass output needs the one before, so there's nothing to vectorise across samples;
+        // the sample by sample loop at least runs the voices' filters side by side
+        processChunkScalar<SampleType, Interpolator, layout> (leftIn, rightIn, leftOut, rightOut, chunkLength, control);
+    }
+    else
+    {
+        auto& path = getSignalPath<SampleType>();
+
+        // the interleaved layout mixes frames into mixLeft and mixRight as one buffer, and splits them at the end
+        constexpr auto isInterleaved = layout == ChannelLayout::stereoInterleaved;
+        constexpr auto hasRightMix = layout == ChannelLayout::monoToStereo || layout == ChannelLayout::stereo;
+        const auto mixLength = isInterleaved ? 2 * chunkLength : chunkLength;
+
+        // the whole chunk goes in first, the output may be the same memory as the input
+        {
+            WAYLOCHORUS_TRACE_SCOPE (mTrace, "write", chunkLength);
+            if constexpr (layout == ChannelLayout::stereoInterleaved)
+            {
+                path.delayLineStereo.writeBlock (leftIn, rightIn, chunkLength);
+            }
+            else
+            {
+                path.delayLineLeft.writeBlock (leftIn, chunkLength);
+
+                if constexpr (layout == ChannelLayout::stereo)
+                    path.delayLineRight.writeBlock (rightIn, chunkLength);
+            }
+        }
+
+        juce::FloatVectorOperations::clear (path.mixLeft, mixLength);
+
+        if constexpr (hasRightMix)
+            juce::FloatVectorOperations::clear (path.mixRight, chunkLength);
+
+        {
+            WAYLOCHORUS_TRACE_SCOPE (mTrace, "read/interpolate", chunkLength);
+            const auto numGroups = getNumVoiceGroups<SampleType> (control.numVoices);
+
+            if (numGroups > 1)
+            {
+                // the threads only share what they read, each group mixes into buffers of its own. The pool
+                // keeps a copy of this to call, so it only holds on to members and values, not to this frame
+                const auto renderGroup = [this, &path, &control, chunkLength, mixLength, numGroups, length] (int group, int thread)
+                {
+                    WAYLOCHORUS_TRACE_SCOPE (mTrace, "voice group", chunkLength);
+                    auto* groupLeft = path.groupMixLeft[group];
+                    auto* groupRight = path.groupMixRight[group];
+
+                    juce::FloatVectorOperations::clear (groupLeft, mixLength);
+
+                    if constexpr (hasRightMix)
+                        juce::FloatVectorOperations::clear (groupRight, chunkLength);
+
+                    addVoices<SampleType, Interpolator, layout> (group * control.numVoices / numGroups, (group + 1) * control.numVoices / numGroups,
+                                                                 groupLeft, groupRight, length, control, thread);
+                };
+
+                // a group whose worker fell behind is rendered again here, straight into the mix, while
+                // that worker goes on writing its group's buffers, which are then left out
+                bool takenOver[VoiceWorkerPool::maxThreads] {};
+
+                const auto takeOverGroup = [&] (int group)
+                {
+                    WAYLOCHORUS_TRACE_SCOPE (mTrace, "voice group taken over", chunkLength);
+                    takenOver[group] = true;
+                    addVoices<SampleType, Interpolator, layout> (group * control.numVoices / numGroups, (group + 1) * control.numVoices / numGroups,
+                                                                 path.mixLeft, path.mixRight, length, control, 0);
+                };
+
+                if (! mWorkerPool.run (numGroups, renderGroup, takeOverGroup, workerWaitBudget * mSubBlockSeconds))
+                    mWorkerBackoffSamples = mWorkerBackoffLength;
+
+                for (int group = 0; group < numGroups; ++group)
+                {
+                    if (takenOver[group])
+                        continue;
+
+                    juce::FloatVectorOperations::add (path.mixLeft, path.groupMixLeft[group], mixLength);
+
+                    if constexpr (hasRightMix)
+                        juce::FloatVectorOperations::add (path.mixRight, path.groupMixRight[group], chunkLength);
+                }
+            }
+            else
+            {
+                addVoices<SampleType, Interpolator, layout> (0, control.numVoices, path.mixLeft, path.mixRight, length, control, 0);
+            }
+        }
+
+        WAYLOCHORUS_TRACE_SCOPE (mTrace, "mix", chunkLength);
+
+        if constexpr (isInterleaved)
+        {
+            for (int n = 0; n < chunkLength; ++n)
+            {
+                leftOut[n] = path.mixLeft[2 * n];
+                rightOut[n] = path.mixLeft[2 * n + 1];
+            }
+        }
+        else
+        {
+            juce::FloatVectorOperations::copy (leftOut, path.mixLeft, chunkLength);
+
+            if constexpr (hasRightMix)
+                juce::FloatVectorOperations::copy (rightOut, path.mixRight, chunkLength);
+        }
+    }
+}
+
+template <typename SampleType, typename Interpolator, Waylochorus2AudioProcessor::ChannelLayout layout, typename Length>
+void Waylochorus2AudioProcessor::addVoices (int firstVoice, int endVoice, SampleType* mixLeft, SampleType* mixRight, Length length, const ChorusControlSnapshot& control, int workspace) noexcept
+{
+    const int chunkLength = length;
+    auto& path = getSignalPath<SampleType>();
+
+    // voice by voice rather than sample by sample, so each pass is a straight run over contiguous memory
+    for (int v = firstVoice; v < endVoice; ++v)
+    {
+        const auto* delayTimes = mLfoBuffer + v * mLfoStride;
+
+        if constexpr (layout == ChannelLayout::monoToStereo)
+        {
+            // one read per voice, shared between the outputs
+            path.delayLineLeft.template addTapPanned<Interpolator> (delayTimes, control.gainLeft[v], control.gainLeftStep[v], control.gainRight[v], control.gainRightStep[v],
+                                                                    mixLeft, mixRight, chunkLength, workspace);
+        }
+        else if constexpr (layout == ChannelLayout::stereoInterleaved)
+        {
+            // one set of read positions, each frame gathered once for both channels and mixed as frames into mixLeft
+            path.delayLineStereo.template addTap<Interpolator> (delayTimes, control.gain[v], control.gainStep[v], mixLeft, chunkLength, workspace);
+        }
+        else
+        {
+            path.delayLineLeft.template addTap<Interpolator> (delayTimes, control.gain[v], control.gainStep[v], mixLeft, chunkLength, workspace);
+
+            if constexpr (layout == ChannelLayout::stereo)
+                path.delayLineRight.template addTap<Interpolator> (delayTimes, control.gain[v], control.gainStep[v], mixRight, chunkLength, workspace);
+        }
+    }
+}
+
+template <typename SampleType, typename Interpolator, Waylochorus2AudioProcessor::ChannelLayout layout>
+void Waylochorus2AudioProcessor::processFeedbackChunkScalar (const SampleType* input, SampleType* leftOut, SampleType* rightOut, int chunkLength, const ChorusControlSnapshot& control) noexcept
+{
+    static_assert (layout == ChannelLayout::mono || layout == ChannelLayout::monoToStereo);
+
+    WAYLOCHORUS_TRACE_SCOPE (mTrace, "scalar feedback kernel", chunkLength);
+    auto& path = getSignalPath<SampleType>();
+    auto& network = path.feedbackNetwork;
+    using Network = std::remove_reference_t<decltype (network)>;
+
+    network.beginBlock (control, chunkLength);
+
+    // the sends use the unpanned gains in either layout
+    std::copy (control.gain, control.gain + control.numVoices, mTapGains);
+
+    if constexpr (layout == ChannelLayout::monoToStereo)
+    {
+        std::copy (control.gainLeft, control.gainLeft + control.numVoices, mTapGainsLeft);
+        std::copy (control.gainRight, control.gainRight + control.numVoices, mTapGainsRight);
+    }
+
+    for (int n = 0; n < chunkLength; ++n)
+    {
+        SampleType sends[Network::numLines] = {};
+        SampleType left = 0, right = 0;
+
+        // the taps read at least a block behind the write heads, so reading before writing hears the same as after
+        for (int v = 0; v < control.numVoices; ++v)
+        {
+            const auto line = Network::getLineForVoice (v);
+            const auto tap = network.getLine (line).template read<Interpolator> (mLfoBuffer[v * mLfoStride + n], path.interpolatorStateLeft[v]);
+
+            sends[line] += mTapGains[v] * tap;
+
+            if constexpr (layout == ChannelLayout::monoToStereo)
+            {
+                left += mTapGainsLeft[v] * tap;
+                right += mTapGainsRight[v] * tap;
             }
-            
-            if ( mLFOphaseThree > 1){
-                mLFOphaseThree -= 1;
+            else
+            {
+                left += mTapGains[v] * tap;
             }
-            
-            if ( mLFOphaseFour > 1){
-                mLFOphaseFour -= 1;
+        }
+
+        network.writeSample (input[n], sends, n);
+
+        leftOut[n] = left;
+
+        if constexpr (layout == ChannelLayout::monoToStereo)
+        {
+            rightOut[n] = right;
+
+            juce::FloatVectorOperations::add (mTapGainsLeft, control.gainLeftStep, control.numVoices);
+            juce::FloatVectorOperations::add (mTapGainsRight, control.gainRightStep, control.numVoices);
+        }
+
+        juce::FloatVectorOperations::add (mTapGains, control.gainStep, control.numVoices);
+    }
+
+    network.endBlock();
+}
+
+template <typename SampleType, typename Interpolator, Waylochorus2AudioProcessor::ChannelLayout layout, typename Length>
+void Waylochorus2AudioProcessor::processFeedbackChunkVectorised (const SampleType* input, SampleType* leftOut, SampleType* rightOut, Length length, const ChorusControlSnapshot& control) noexcept
+{
+    const int chunkLength = length;
+
+    if constexpr (Interpolator::isRecursive)
+    {
+        processFeedbackChunkScalar<SampleType, Interpolator, layout> (input, leftOut, rightOut, chunkLength, control);
+    }
+    else
+    {
+        auto& path = getSignalPath<SampleType>();
+        auto& network = path.feedbackNetwork;
+        using Network = std::remove_reference_t<decltype (network)>;
+
+        network.beginBlock (control, chunkLength);
+
+        {
+            // the input goes in on its own first, the feedback is added once the voices have been read
+            WAYLOCHORUS_TRACE_SCOPE (mTrace, "write", chunkLength);
+            network.writeBlock (input, chunkLength);
+        }
+
+        juce::FloatVectorOperations::clear (path.mixLeft, chunkLength);
+
+        if constexpr (layout == ChannelLayout::monoToStereo)
+            juce::FloatVectorOperations::clear (path.mixRight, chunkLength);
+
+        {
+            WAYLOCHORUS_TRACE_SCOPE (mTrace, "read/interpolate", chunkLength);
+
+            // each voice is read once, and mixed into the outputs and its line's send together
+            for (int v = 0; v < control.numVoices; ++v)
+            {
+                const auto line = Network::getLineForVoice (v);
+                const auto* delayTimes = mLfoBuffer + v * mLfoStride;
+                auto* send = network.getSendRow (line);
+
+                if constexpr (layout == ChannelLayout::monoToStereo)
+                {
+                    network.getLine (line).template addTapToEach<Interpolator, 3> (delayTimes,
+                                                                                   { control.gainLeft[v], control.gainRight[v], control.gain[v] },
+                                                                                   { control.gainLeftStep[v], control.gainRightStep[v], control.gainStep[v] },
+                                                                                   { path.mixLeft, path.mixRight, send }, chunkLength);
+                }
+                else
+                {
+                    network.getLine (line).template addTapToEach<Interpolator, 2> (delayTimes,
+                                                                                   { control.gain[v], control.gain[v] },
+                                                                                   { control.gainStep[v], control.gainStep[v] },
+                                                                                   { path.mixLeft, send }, chunkLength);
+                }
             }
-           
-           float lfoOutMapped = juce::jmap(lfoOut,-1.f,1.f,0.001f, 0.1f);
-           float lfoOutMappedTwo = juce::jmap(lfoOutTwo,-1.f,1.f,0.001f, 0.1f);
-           float lfoOutMappedThree = juce::jmap(lfoOutThree,-1.f,1.f,0.001f, 0.1f);
-           float lfoOutMappedFour = juce::jmap(lfoOutFour,-1.f,1.f,0.001f,0.1f);
-           
-           int dtime = static_cast<int>(0.0236*getSampleRate());
-           int dtimeTwo = static_cast<int>(0.03*getSampleRate());
-           int dtimeThree = static_cast<int>(0.036*getSampleRate());
-           int dtimeFour = static_cast<int>(0.028*getSampleRate());
-           
-           /// add the modulated delay time to the value the delay time is set to with the slider
-           
-           mDelayTimeInSamples = dtime*(1+ lfoOutMapped) ;
-           mDelayTwoTimeInSamples = dtimeTwo*(1+ lfoOutMappedTwo);
-           mDelayThreeTimeInSamples = dtimeThree*(1+ lfoOutMappedThree);
-           mDelayFourTimeInSamples = dtimeFour*(1+ lfoOutMappedFour) ;
-           
-           // shove some of the input into the circular buffer also add some of the feedback
-           mCircularBufferLeft[mCircularBufferWriteHead] = LeftChannel[i] ;
-           mCircularBufferRight[mCircularBufferWriteHead] = RightChannel[i] ;
-           mCircularBufferLeftTwo[mCircularBufferWriteHeadTwo] = LeftChannel[i] ;
-           mCircularBufferRightTwo[mCircularBufferWriteHeadTwo] = RightChannel[i] ;
-           mCircularBufferLeftThree[mCircularBufferWriteHeadThree] = LeftChannel[i] ;
-           mCircularBufferRightThree[mCircularBufferWriteHeadThree] = RightChannel[i] ;
-           mCircularBufferLeftFour[mCircularBufferWriteHeadFour] = LeftChannel[i] ;
-           mCircularBufferRightFour[mCircularBufferWriteHeadFour] = RightChannel[i] ;
-           
-           // move the read head on the circular to the new delay position
-           mDelayReadHead = mCircularBufferWriteHead - mDelayTimeInSamples;
-           mDelayTwoReadHead = mCircularBufferWriteHeadTwo - mDelayTwoTimeInSamples;
-           mDelayThreeReadHead = mCircularBufferWriteHeadThree - mDelayThreeTimeInSamples;
-           mDelayFourReadHead = mCircularBufferWriteHeadFour - mDelayFourTimeInSamples;
-           
-           // if read head is below zero wrap around
-           if (mDelayReadHead < 0){
-               mDelayReadHead += mCircularBufferLength;
-           }
-           
-           if (mDelayTwoReadHead < 0){
-               mDelayTwoReadHead += mCircularBufferLength;
-           }
-           if (mDelayThreeReadHead < 0){
-               mDelayThreeReadHead += mCircularBufferLength;
-           }
-           if (mDelayFourReadHead < 0){
-               mDelayFourReadHead += mCircularBufferLength;
-           }
-           
-           // get the integer part of the read head
-            int readHeadX = (int)mDelayReadHead;
-            // get the part of the readHead after the decimal point
-            float readHeadFloat = mDelayReadHead - readHeadX;
-            // next integer sample position
-            int readHeadX1 = readHeadX + 1;
-            
-            // get the integer part of the read head
-            int readHeadXTwo = (int)mDelayTwoReadHead;
-            // get the part of the readHead after the decimal point
-            float readHeadFloatTwo = mDelayTwoReadHead - readHeadXTwo;
-            // next integer sample position
-            int readHeadX1Two = readHeadXTwo + 1;
-            
-            // get the integer part of the read head
-            int readHeadXThree = (int)mDelayThreeReadHead;
-            // get the part of the readHead after the decimal point
-            float readHeadFloatThree = mDelayThreeReadHead - readHeadXThree;
-            // next integer sample position
-            int readHeadX1Three = readHeadXThree + 1;
-            
-            // get the integer part of the read head
-            int readHeadXFour = (int)mDelayFourReadHead;
-            // get the part of the readHead after the decimal point
-            float readHeadFloatFour = mDelayFourReadHead - readHeadXFour;
-            // next integer sample position
-            int readHeadX1Four = readHeadXFour + 1;
-           
-           
-           
-           // if next sample position is outside the buffer
-           if ( readHeadX1 >= mCircularBufferLength){
-               readHeadX1 -= mCircularBufferLength;
-           }
-           
-           if ( readHeadX1Two >= mCircularBufferLength){
-               readHeadX1Two -= mCircularBufferLength;
-           }
-           
-           if ( readHeadX1Three >= mCircularBufferLength){
-               readHeadX1Three -= mCircularBufferLength;
-           }
-           
-           if ( readHeadX1Four >= mCircularBufferLength){
-               readHeadX1Four -= mCircularBufferLength;
-           }
-           
-           // get the interpolated value of the delayed sample from the circular buffer
-           float delay_sample_Left = Waylochorus2AudioProcessor::linInterp(mCircularBufferLeft[readHeadX], mCircularBufferLeft[readHeadX1], readHeadFloat);
-           float delay_sample_Right = Waylochorus2AudioProcessor::linInterp(mCircularBufferRight[readHeadX], mCircularBufferRight[readHeadX1], readHeadFloat);
-           float delay_sample_LeftTwo = Waylochorus2AudioProcessor::linInterp(mCircularBufferLeftTwo[readHeadXTwo], mCircularBufferLeftTwo[readHeadX1Two], readHeadFloatTwo);
-           float delay_sample_RightTwo = Waylochorus2AudioProcessor::linInterp(mCircularBufferRightTwo[readHeadXTwo], mCircularBufferRightTwo[readHeadX1Two], readHeadFloatTwo);
-           float delay_sample_LeftThree = Waylochorus2AudioProcessor::linInterp(mCircularBufferLeftThree[readHeadXThree], mCircularBufferLeftThree[readHeadX1Three], readHeadFloatThree);
-           float delay_sample_RightThree = Waylochorus2AudioProcessor::linInterp(mCircularBufferRightThree[readHeadXThree], mCircularBufferRightThree[readHeadX1Three], readHeadFloatThree);
-           float delay_sample_LeftFour = Waylochorus2AudioProcessor::linInterp(mCircularBufferLeftFour[readHeadXFour], mCircularBufferLeftFour[readHeadX1Four], readHeadFloatFour);
-           float delay_sample_RightFour = Waylochorus2AudioProcessor::linInterp(mCircularBufferRightFour[readHeadXFour], mCircularBufferRightFour[readHeadX1Four], readHeadFloatFour);
-           
-           
-           panLevelOne = 0.0f;
-           panOneL = 1 - panLevelOne;
-           panOneR = panLevelOne;
-           panLevelTwo = 1.0f;
-           panTwoL = 1 - panLevelTwo;
-           panTwoR = panLevelTwo;
-           panLevelThree = 0.0f;
-           panThreeL = 1 - panLevelThree;
-           panThreeR = panLevelThree;
-           panLevelFour = 1.0f;
-           panFourL = 1 - panLevelFour;
-           panFourR = panLevelFour;
-           
-           
-           buffer.setSample(0, i,
-                            
-                            
-                            //1.0, 1.0,0.7,0.57
-                            
-                            delay_sample_Left
-                            +delay_sample_LeftTwo
-                            +delay_sample_LeftThree*0.7
-                            +delay_sample_LeftFour*0.57
-
-                            
-                            );
-           
-           buffer.setSample(1, i,
-                            
-                            
-
-                            + delay_sample_Right
-                            + delay_sample_RightThree*0.7
-                            + delay_sample_RightTwo
-                            + delay_sample_RightFour*0.57
-                         
-                        
-            
-                            );
-        
-           
-           // increment the buffer write head
-           mCircularBufferWriteHead ++;
-           mCircularBufferWriteHeadTwo ++;
-           mCircularBufferWriteHeadThree ++;
-           mCircularBufferWriteHeadFour ++;
-
-           
-           
-           // wrap around if needed
-           if (mCircularBufferWriteHead == mCircularBufferLength){
-               mCircularBufferWriteHead = 0;
-           }
-           if (mCircularBufferWriteHeadTwo == mCircularBufferLength){
-               mCircularBufferWriteHeadTwo = 0;
-           }
-           if (mCircularBufferWriteHeadThree == mCircularBufferLength){
-               mCircularBufferWriteHeadThree = 0;
-           }
-           if (mCircularBufferWriteHeadFour == mCircularBufferLength){
-               mCircularBufferWriteHeadFour = 0;
-           }
-
-           
+        }
+
+        {
+            WAYLOCHORUS_TRACE_SCOPE (mTrace, "feedback", chunkLength);
+            network.feedBack (chunkLength);
+            network.endBlock();
+        }
+
+        WAYLOCHORUS_TRACE_SCOPE (mTrace, "mix", chunkLength);
+        juce::FloatVectorOperations::copy (leftOut, path.mixLeft, chunkLength);
+
+        if constexpr (layout == ChannelLayout::monoToStereo)
+            juce::FloatVectorOperations::copy (rightOut, path.mixRight, chunkLength);
+    }
+}
+
+template <typename SampleType, Waylochorus2AudioProcessor::ChannelLayout layout>
+void Waylochorus2AudioProcessor::processBbdChunkScalar (const SampleType* input, SampleType* leftOut, SampleType* rightOut, int chunkLength, const ChorusControlSnapshot& control) noexcept
+{
+    static_assert (layout == ChannelLayout::mono || layout == ChannelLayout::monoToStereo);
+
+    WAYLOCHORUS_TRACE_SCOPE (mTrace, "scalar BBD kernel", chunkLength);
+    auto& path = getSignalPath<SampleType>();
+    auto& bbd = path.bucketBrigade;
+
+    bbd.beginBlock (mLfoBuffer, mLfoStride, control.numVoices, chunkLength);
+
+    // the input side doesn't depend on the voices, so it runs ahead over the whole chunk
+    auto* processed = bbd.getInputRow();
+    bbd.processInput (input, processed, chunkLength);
+
+    for (int n = 0; n < chunkLength; ++n)
+    {
+        path.delayLineLeft.write (processed[n]);
+
+        auto* frame = bbd.getFrame (n);
+
+        for (int v = 0; v < control.numVoices; ++v)
+            frame[v] = path.delayLineLeft.template read<Interpolation::Linear> (mLfoBuffer[v * mLfoStride + n], path.interpolatorStateLeft[v]);
+
+        path.delayLineLeft.advance();
+    }
+
+    bbd.template processVoices<SampleType> (control.numVoices, chunkLength);
+
+    if constexpr (layout == ChannelLayout::monoToStereo)
+    {
+        bbd.template mix<SampleType> (control.gainLeft, control.gainLeftStep, control.numVoices, leftOut, chunkLength);
+        bbd.template mix<SampleType> (control.gainRight, control.gainRightStep, control.numVoices, rightOut, chunkLength);
+    }
+    else
+    {
+        bbd.template mix<SampleType> (control.gain, control.gainStep, control.numVoices, leftOut, chunkLength);
+    }
+}
+
+template <typename SampleType, Waylochorus2AudioProcessor::ChannelLayout layout, typename Length>
+void Waylochorus2AudioProcessor::processBbdChunkVectorised (const SampleType* input, SampleType* leftOut, SampleType* rightOut, Length length, const ChorusControlSnapshot& control) noexcept
+{
+    const int chunkLength = length;
+
+    using Vector = juce::dsp::SIMDRegister<SampleType>;
+    auto& path = getSignalPath<SampleType>();
+    auto& bbd = path.bucketBrigade;
+
+    bbd.beginBlock (mLfoBuffer, mLfoStride, control.numVoices, chunkLength);
+
+    {
+        WAYLOCHORUS_TRACE_SCOPE (mTrace, "write", chunkLength);
+        auto* processed = bbd.getInputRow();
+        bbd.processInput (input, processed, chunkLength);
+        path.delayLineLeft.writeBlock (processed, chunkLength);
+    }
+
+    {
+        // each voice is read on its own, its filters need it before it is mixed
+        WAYLOCHORUS_TRACE_SCOPE (mTrace, "read/interpolate", chunkLength);
+
+        for (int v = 0; v < control.numVoices; ++v)
+        {
+            auto* row = bbd.getVoiceRow (v);
+            juce::FloatVectorOperations::clear (row, chunkLength);
+            path.delayLineLeft.template addTap<Interpolation::Linear> (mLfoBuffer + v * mLfoStride, 1.0f, 0.0f, row, chunkLength);
+        }
+    }
+
+    {
+        // turned round so that each sample of a register's worth of voices is one load
+        WAYLOCHORUS_TRACE_SCOPE (mTrace, "BBD voices", chunkLength);
+        bbd.gatherFrames (control.numVoices, chunkLength);
+        bbd.template processVoices<Vector> (control.numVoices, chunkLength);
+    }
+
+    WAYLOCHORUS_TRACE_SCOPE (mTrace, "mix", chunkLength);
+
+    if constexpr (layout == ChannelLayout::monoToStereo)
+    {
+        bbd.template mix<Vector> (control.gainLeft, control.gainLeftStep, control.numVoices, leftOut, chunkLength);
+        bbd.template mix<Vector> (control.gainRight, control.gainRightStep, control.numVoices, rightOut, chunkLength);
+    }
+    else
+    {
+        bbd.template mix<Vector> (control.gain, control.gainStep, control.numVoices, leftOut, chunkLength);
+    }
+}
+
+template <typename SampleType>
+bool Waylochorus2AudioProcessor::isSilent (const juce::AudioBuffer<SampleType>& buffer, int numChannels) const noexcept
+{
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        const auto range = juce::FloatVectorOperations::findMinAndMax (buffer.getReadPointer (channel), buffer.getNumSamples());
+
+        if (range.getStart() < -silenceThreshold || range.getEnd() > silenceThreshold)
+            return false;
+    }
+
+    return true;
+}
+
+template <typename SampleType>
+void Waylochorus2AudioProcessor::skipIdleBlock (int numSamples) noexcept
+{
+    auto& path = getSignalPath<SampleType>();
+
+    WAYLOCHORUS_TRACE_SCOPE (mTrace, "idle", numSamples);
+
+    // everything the voices can reach is silent already. Clearing the rest once means the
+    // write heads can move on without writing, and the allpass state has decayed to nothing
+    if (! mIsIdle)
+    {
+        mIsIdle = true;
+        path.delayLineLeft.clear();
+        path.delayLineRight.clear();
+        path.delayLineStereo.clear();
+        path.feedbackNetwork.clear();
+        path.bucketBrigade.clear();
+        path.resetInterpolatorState();
+    }
+
+    // keep the write heads, the glides and the LFOs moving, so it all carries on in time when sound comes back
+    path.delayLineLeft.skip (numSamples);
+    path.delayLineRight.skip (numSamples);
+    path.delayLineStereo.skip (numSamples);
+    path.feedbackNetwork.skip (numSamples);
+
+    for (int chunkStart = 0; chunkStart < numSamples; chunkStart += subBlockSize)
+    {
+        const auto chunkLength = juce::jmin ((int) subBlockSize, numSamples - chunkStart);
+
+        updateSettings<SampleType> (chunkLength);
+        mControl.update (mVoices, chunkLength);
+        mLfo.skip (mControl.getSnapshot(), mVoices.phase, chunkLength);
+    }
+}
+
+template <typename SampleType>
+int Waylochorus2AudioProcessor::getNumVoiceGroups (int numVoices) noexcept
+{
+    // the lines only have a workspace for each of the threads there were when they were prepared
+    const auto numThreads = mWorkerPool.getNumThreads();
+
+    // nothing is handed out while a worker is still on a task from a sub-block that went on without it
+    if (numThreads == 1 || mWorkerBackoffSamples > 0 || numThreads > getSignalPath<SampleType>().numThreads || mWorkerPool.isBusy())
+        return 1;
+
+    return juce::jlimit (1, numThreads, numVoices / minVoicesPerThread);
+}
+
+template <typename SampleType>
+void Waylochorus2AudioProcessor::updateParameters() noexcept
+{
+    auto& path = getSignalPath<SampleType>();
+
+    // pick up any parameter changes, this only touches the parameter atomics when something moved
+    WAYLOCHORUS_TRACE_SCOPE (mTrace, "parameters", 0);
+    // the dropped voices fade out through the control plane, like any other change in the voice count
+    if (mParameters.updateVoiceTable (mVoices) && EcoMode::halvesVoices (mEcoTier))
+        mVoices.setNumVoices (juce::jmax (ChorusVoiceTable::minVoices, mVoices.numVoices / 2));
+
+    mLfo.setShape (mParameters.getLfoShape());
+
+    // an eco tier can take the cubic interpolators down to linear, but not the allpass, whose state
+    // would have to start over
+    auto interpolationMode = mParameters.getInterpolationMode();
+
+    if (EcoMode::usesLinearInterpolation (mEcoTier) && interpolationMode != Interpolation::Mode::allpass)
+        interpolationMode = Interpolation::Mode::linear;
+
+    // the allpass state means nothing to another interpolator, so start it afresh
+    if (interpolationMode != mInterpolationMode)
+    {
+        mInterpolationMode = interpolationMode;
+        path.resetInterpolatorState();
+    }
+
+    // the right line wasn't written while the channels were summed, so don't let it play what it still holds
+    if (const auto stereoMode = mParameters.getStereoMode(); stereoMode != mStereoMode)
+    {
+        mStereoMode = stereoMode;
+
+        if (stereoMode == ChorusParameters::StereoMode::dual)
+        {
+            path.delayLineRight.clear();
+
+            // the interleaved line wasn't written either, so it starts over on both sides
+            path.delayLineStereo.clear();
+        }
+    }
+
+    // neither the network nor the plain lines were written while the other was in use, so whichever
+    // takes over starts from silence rather than play what it still holds
+    if (const auto enabled = mParameters.isFeedbackNetworkEnabled(); enabled != mFeedbackNetworkEnabled)
+    {
+        mFeedbackNetworkEnabled = enabled;
 
+        path.delayLineLeft.clear();
+        path.delayLineRight.clear();
+        path.delayLineStereo.clear();
+        path.feedbackNetwork.clear();
+        path.resetInterpolatorState();
     }
+
+    // the BBD mode writes its processed input to the lines, the plain chorus the input as it is, so
+    // a switch either way starts from silence too
+    if (const auto enabled = mParameters.isBbdEnabled(); enabled != mBbdEnabled)
+    {
+        mBbdEnabled = enabled;
+
+        path.delayLineLeft.clear();
+        path.delayLineRight.clear();
+        path.delayLineStereo.clear();
+        path.bucketBrigade.clear();
+        path.resetInterpolatorState();
+    }
+
+    path.bucketBrigade.setNumStages (mParameters.getBbdStages());
+}
+
+template <typename SampleType>
+void Waylochorus2AudioProcessor::updateSettings (int numSamples) noexcept
+{
+    const auto sequence = mParameters.getPresetSequence();
+
+    // a preset or a restored state, even one still being written, fades out what's playing before any of it is heard
+    if (sequence != mAppliedPresetSequence)
+        mSwitchingPreset = true;
+
+    // while idle there's nothing to fade out
+    if (mSwitchingPreset && mIsIdle)
+        mPresetGain = 0.0f;
+
+    if (! mSwitchingPreset)
+    {
+        updateParameters<SampleType>();
+    }
+    else if (mPresetGain == 0.0f && (sequence & 1) == 0)
+    {
+        // silent, and every new value is in place: take them all at once
+        mAppliedPresetSequence = sequence;
+        updateParameters<SampleType>();
+
+        // if another switch started while they were being read, stay silent and take that one too;
+        // the fence keeps the relaxed parameter loads above from moving past the sequence check
+        std::atomic_thread_fence (std::memory_order_acquire);
+        mSwitchingPreset = mParameters.getPresetSequence() != sequence;
+    }
+
+    const auto step = mPresetGainStep * (float) numSamples;
+    mPresetGain = mSwitchingPreset ? juce::jmax (0.0f, mPresetGain - step) : juce::jmin (1.0f, mPresetGain + step);
+}
+
+//==============================================================================
+template <typename SampleType>
+void Waylochorus2AudioProcessor::SignalPath<SampleType>::prepare (double sampleRate, int maxDelayInSamples, int maxBlockSize, int maxThreads,
+                                                                  bool stereo, DelayLineLayout layout)
+{
+    // the lines the voices can be split between threads on get a workspace per thread
+    numThreads = maxThreads;
+    isStereo = stereo;
+    delayLineLayout = layout;
+
+    // the left line takes a mono input, and a stereo one summed. Dual stereo adds either the right line or
+    // the interleaved one, never both; the other is freed in case an earlier layout used it. The stereo
+    // mode, the feedback network and the BBD switch while processing, so whatever they might need is ready
+    delayLineLeft.prepare (maxDelayInSamples, maxBlockSize, numThreads);
+
+    if (stereo && layout == DelayLineLayout::planar)
+        delayLineRight.prepare (maxDelayInSamples, maxBlockSize, numThreads);
+    else
+        delayLineRight.release();
+
+    if (stereo && layout == DelayLineLayout::interleaved)
+        delayLineStereo.prepare (maxDelayInSamples, maxBlockSize, numThreads);
+    else
+        delayLineStereo.release();
+
+    feedbackNetwork.prepare (maxDelayInSamples, maxBlockSize);
+    bucketBrigade.prepare (sampleRate, maxBlockSize);
+
+    // whole cache lines per buffer, so each one is aligned for the vectorised kernel
+    constexpr int cacheLineSize = 64;
+    constexpr int samplesPerCacheLine = cacheLineSize / (int) sizeof (SampleType);
+    const auto stride = (maxBlockSize + samplesPerCacheLine - 1) & ~(samplesPerCacheLine - 1);
+
+    scratch.allocate ((size_t) ((3 + 2 * numThreads) * stride) * sizeof (SampleType) + cacheLineSize, true);
+
+    const auto address = reinterpret_cast<std::uintptr_t> (scratch.get());
+    mixLeft = reinterpret_cast<SampleType*> ((address + cacheLineSize - 1) & ~(std::uintptr_t) (cacheLineSize - 1));
+    mixRight = mixLeft + stride;
+    monoSum = mixRight + stride;
+
+    // a late worker can still be writing its group's pair after the mix has moved on, so no group shares the mix
+    for (int group = 0; group < numThreads; ++group)
+    {
+        groupMixLeft[group] = monoSum + (2 * group + 1) * stride;
+        groupMixRight[group] = monoSum + (2 * group + 2) * stride;
+    }
+
+    resetInterpolatorState();
+}
+
+template <typename SampleType>
+void Waylochorus2AudioProcessor::SignalPath<SampleType>::resetInterpolatorState() noexcept
+{
+    std::fill (std::begin (interpolatorStateLeft), std::end (interpolatorStateLeft), SampleType());
+    std::fill (std::begin (interpolatorStateRight), std::end (interpolatorStateRight), SampleType());
 }
 
 //==============================================================================
@@ -430,15 +1136,17 @@ juce::AudioProcessorEditor* Waylochorus2AudioProcessor::createEditor()
 //==============================================================================
 void Waylochorus2AudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
-    // You should use this method to store your parameters in the memory block.
-    // You could do that either as raw data, or use the XML or ValueTree classes
-    // as intermediaries to make it easy to save and load complex data.
+    WAYLOCHORUS_TRACE_SCOPE (mTrace, "getStateInformation", 0);
+    mParameters.writeState (destData, mCurrentProgram.load());
 }
 
 void Waylochorus2AudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
-    // You should use this method to restore your parameters from this memory block,
-    // whose contents will have been created by the getStateInformation() call.
+    WAYLOCHORUS_TRACE_SCOPE (mTrace, "setStateInformation", 0);
+
+    // the processor fades across the change, the same as for a program change
+    if (int program = 0; mParameters.readState (data, sizeInBytes, program))
+        mCurrentProgram = juce::isPositiveAndBelow (program, ChorusPresets::numPresets) ? program : 0;
 }
 
 //==============================================================================
@@ -9,6 +9,18 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "BucketBrigade.h"
+#include "ChorusControl.h"
+#include "ChorusLfo.h"
+#include "ChorusParameters.h"
+#include "ChorusPresets.h"
+#include "ChorusVoiceTable.h"
+#include "DelayLine.h"
+#include "DspLoadMeter.h"
+#include "EcoMode.h"
+#include "FeedbackNetwork.h"
+#include "TraceRecorder.h"
+#include "VoiceWorkerPool.h"
 
 //==============================================================================
 /**
@@ -29,6 +41,10 @@ public:
    #endif
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+
+    /** Both precisions run the same kernels, so a 64-bit host doesn't need to convert. */
+    bool supportsDoublePrecisionProcessing() const override { return true; }
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -36,8 +52,100 @@ public:
 
     //==============================================================================
     const juce::String getName() const override;
-    
-    float linInterp(float sample_x, float sample_x1, float inPhase);
+
+    /** Sets how many chorus voices run (2..32), through the host-visible parameter. */
+    void setNumVoices (int newNumVoices);
+    int getNumVoices() const;
+
+    juce::AudioProcessorValueTreeState& getValueTreeState() noexcept { return mState; }
+
+    /** The vectorised kernel is the one to use. The scalar one is the simple
+        reference it is tested and benchmarked against. Only switch while not processing.
+    */
+    enum class Kernel
+    {
+        scalar,
+        vectorised
+    };
+
+    void setKernel (Kernel newKernel) noexcept { mKernel = newKernel; }
+    Kernel getKernel() const noexcept { return mKernel; }
+
+    /** How the dual stereo mode stores its two channels: a DelayLine each, or
+        both in one stereo DelayLine so a voice reads the pair together.
+        Interleaved is the default, planar is kept to compare against. Set it
+        before prepareToPlay, which only allocates the lines it reads.
+    */
+    enum class DelayLineLayout
+    {
+        planar,
+        interleaved
+    };
+
+    void setDelayLineLayout (DelayLineLayout newLayout) noexcept { mDelayLineLayout = newLayout; }
+    DelayLineLayout getDelayLineLayout() const noexcept { return mDelayLineLayout; }
+
+    /** Once the input has been silent for longer than the longest delay there's nothing
+        left to hear, so processBlock just clears the output until sound comes back.
+        On by default; turning it off is for comparing against. Only switch while not processing.
+    */
+    void setSilenceBypassEnabled (bool shouldBypass) noexcept { mSilenceBypassEnabled = shouldBypass; }
+
+    /** True while the silence bypass is skipping the processing. */
+    bool isIdle() const noexcept { return mIsIdle; }
+
+    /** Spreads the voices across this many worker threads (0 to VoiceWorkerPool::maxWorkers)
+        as well as the audio thread, once there are enough of them to be worth it. Off by
+        default. Only the plain chorus on the vectorised kernel is split up; the allpass
+        mode, the feedback network and the BBD emulation stay on one thread. Set it
+        before prepareToPlay, which starts the threads and gives each its own scratch
+        space; releaseResources stops them again.
+    */
+    void setNumWorkerThreads (int numWorkers) noexcept { mNumWorkerThreads = juce::jlimit (0, VoiceWorkerPool::maxWorkers, numWorkers); }
+    int getNumWorkerThreads() const noexcept { return mNumWorkerThreads; }
+
+    /** Every thread gets at least this many voices, with fewer the hand-off costs more than it saves. */
+    static constexpr int minVoicesPerThread = 8;
+
+    /** If the workers take longer than this share of a sub-block's duration to finish their
+        voices, something is holding them up. The audio thread stops waiting and renders
+        the unfinished voices itself, then stays on one thread for workerBackoffSeconds
+        before trying the workers again.
+    */
+    static constexpr double workerWaitBudget = 0.25;
+    static constexpr double workerBackoffSeconds = 1.0;
+
+    /** How many times the workers fell behind and processing went back to one thread. Any thread. */
+    juce::uint32 getNumWorkerFallbacks() const noexcept { return mWorkerPool.getNumLateJobs(); }
+
+    /** Host blocks are processed in sub-blocks of at most this many samples,
+        whatever size the host sends. Parameters, smoothing and the LFOs move
+        on once per sub-block, and the working set of a sub-block stays in L1.
+    */
+    static constexpr int subBlockSize = 64;
+
+    /** A program change or a restored state fades the output out over this long,
+        swaps to the new settings at silence, and fades back in over the same time.
+    */
+    static constexpr double presetFadeSeconds = 0.005;
+
+    /** Input below this level (about -120 dBFS) counts as silence. */
+    static constexpr float silenceThreshold = 1.0e-6f;
+
+    /** How much of each block's deadline processBlock is using. Safe to query from any thread. */
+    DspLoadMeter& getLoadMeter() noexcept { return mLoadMeter; }
+
+    /** The eco tier the last block was processed at, 0 for full quality. Set by the eco
+        parameter, or in auto mode by the load, see EcoMode. Safe to query from any thread.
+    */
+    int getEcoTier() const noexcept { return mReportedEcoTier.load (std::memory_order_relaxed); }
+
+   #if WAYLOCHORUS_TRACE
+    /** Where the stage markers go. A background writer drains them to the file named by the
+        WAYLOCHORUS_TRACE_FILE environment variable, or to a new file in the temp directory.
+    */
+    TraceRecorder& getTraceRecorder() noexcept { return mTrace; }
+   #endif
 
     bool acceptsMidi() const override;
     bool producesMidi() const override;
@@ -58,81 +166,178 @@ public:
 private:
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Waylochorus2AudioProcessor)
-    float mDelayTimeInSamples;
-        float mDelayReadHead;
-        float feedback;
-        float mLFOphase;
-        float mLFOrate;
-        float mPanOne;
-        
-        float mDelayTwoTimeInSamples;
-        float mDelayTwoReadHead;
-        float feedbackTwo;
-        float mLFOphaseTwo;
-        float mLFOrateTwo;
-        float mPanTwo;
-        
-        float mDelayThreeTimeInSamples;
-        float mDelayThreeReadHead;
-        float feedbackThree;
-        float mLFOphaseThree;
-        float mLFOrateThree;
-        float mPanThree;
-        
-        float mDelayFourTimeInSamples;
-        float mDelayFourReadHead;
-        float feedbackFour;
-        float mLFOphaseFour;
-        float mLFOrateFour;
-        float mPanFour;
-        
-        
-        float mCircularBufferLeft[96000] = {  };
-        float mCircularBufferRight[96000] = {  };
-        float mCircularBufferLeftTwo[96000] = {  };
-        float mCircularBufferRightTwo[96000] = {  };
-        float mCircularBufferLeftThree[96000] = {  };
-        float mCircularBufferRightThree[96000] = {  };
-        float mCircularBufferLeftFour[96000] = {  };
-        float mCircularBufferRightFour[96000] = {  };
-
-        float mLastInputGain  = 0.0f;
-        float mDelayTimeSmoothed;
-        
-        float arr2[10] = { 0 };
-        
-        int mCircularBufferWriteHead;
-        int mCircularBufferLength;
-        
-        float mLastInputGainTwo  = 0.0f;
-        float mDelayTimeSmoothedTwo;
-        
-        int mCircularBufferWriteHeadTwo;
-        
-        float mLastInputGainThree  = 0.0f;
-        float mDelayTimeSmoothedThree;
-        
-        int mCircularBufferWriteHeadThree;
-        
-        
-        float mLastInputGainFour  = 0.0f;
-        float mDelayTimeSmoothedFour;
-
-        int mCircularBufferWriteHeadFour;
-        
-        float panLevelOne;
-        float panLevelTwo;
-        float panLevelThree;
-        float panLevelFour;
-        float panOneL;
-        float panOneR;
-        float panTwoL;
-        float panTwoR;
-        float panThreeL;
-        float panThreeR;
-        float panFourL;
-        float panFourR;
-    
 
+    juce::AudioProcessorValueTreeState mState;
+    ChorusParameters mParameters;
+
+    ChorusVoiceTable mVoices;
+    ChorusControlPlane mControl;
+    ChorusLfo mLfo;
+
+    // LFO output for one sub-block, turned into delay times in place; voice v starts at v * mLfoStride,
+    // each row on a cache line
+    juce::HeapBlock<char> mScratch;
+    float* mLfoBuffer = nullptr;
+    int mLfoStride = 0;
+
+    // per-voice gains for the current sample, ramped along by ChorusControlSnapshot::gainStep,
+    // and the panned pair for one delay line feeding both outputs
+    float mTapGains[ChorusVoiceTable::maxVoices] = {};
+    float mTapGainsLeft[ChorusVoiceTable::maxVoices] = {};
+    float mTapGainsRight[ChorusVoiceTable::maxVoices] = {};
+
+    Interpolation::Mode mInterpolationMode = Interpolation::Mode::linear;
+    ChorusParameters::StereoMode mStereoMode = ChorusParameters::StereoMode::monoSum;
+    bool mFeedbackNetworkEnabled = false;
+    bool mBbdEnabled = false;
+
+    /** Everything the audio itself passes through, at the precision the host processes in.
+        The control plane and the LFOs are shared; only the path for the current precision
+        is prepared.
+    */
+    template <typename SampleType>
+    struct SignalPath
+    {
+        void prepare (double sampleRate, int maxDelayInSamples, int maxBlockSize, int maxThreads, bool stereo, DelayLineLayout layout);
+        void resetInterpolatorState() noexcept;
+
+        // one delay line per input channel, every voice is a tap on it; only dual stereo uses the right one.
+        // WAYLOCHORUS_COMPACT_DELAY_LINES stores them as 16-bit samples
+        DelayLine<SampleType, DelayStorage::Default<SampleType>> delayLineLeft;
+        DelayLine<SampleType, DelayStorage::Default<SampleType>> delayLineRight;
+
+        // both channels of dual stereo as frames in one buffer, used instead of the right line when the layout is interleaved
+        InterleavedDelayLine<SampleType, DelayStorage::Default<SampleType>> delayLineStereo;
+
+        // what the lines were prepared for: a stereo bus layout, and which of the right or the interleaved line
+        // dual stereo reads. The other one, and both of them for a mono input, have no storage
+        bool isStereo = false;
+        DelayLineLayout delayLineLayout = DelayLineLayout::interleaved;
+
+        // a line per group of voices, used instead of all of the above while the feedback network is on
+        FeedbackNetwork<SampleType, DelayStorage::Default<SampleType>> feedbackNetwork;
+
+        // the filters and compander around the left line, while the BBD emulation is on
+        BucketBrigade<SampleType> bucketBrigade;
+
+        // the two mix buffers and the mono sum of a stereo input, each starting on a cache line.
+        // The interleaved layout mixes frames into the pair as one buffer twice as long
+        juce::HeapBlock<char> scratch;
+        SampleType* mixLeft = nullptr;
+        SampleType* mixRight = nullptr;
+        SampleType* monoSum = nullptr;
+
+        // how many threads can render voices at once, and a pair of mix buffers for each group
+        // of voices they render, summed into the pair above, and just as contiguous
+        int numThreads = 1;
+        SampleType* groupMixLeft[VoiceWorkerPool::maxThreads] = {};
+        SampleType* groupMixRight[VoiceWorkerPool::maxThreads] = {};
+
+        // per-voice interpolator state, only the allpass mode uses it
+        SampleType interpolatorStateLeft[ChorusVoiceTable::maxVoices] = {};
+        SampleType interpolatorStateRight[ChorusVoiceTable::maxVoices] = {};
+    };
+
+    SignalPath<float> mFloatPath;
+    SignalPath<double> mDoublePath;
+
+    template <typename SampleType>
+    SignalPath<SampleType>& getSignalPath() noexcept
+    {
+        if constexpr (std::is_same_v<SampleType, float>)
+            return mFloatPath;
+        else
+            return mDoublePath;
+    }
+
+    Kernel mKernel = Kernel::vectorised;
+    DelayLineLayout mDelayLineLayout = DelayLineLayout::interleaved;
+
+    // how long the input has been silent, counted up to the point where the delay lines hold nothing audible
+    bool mSilenceBypassEnabled = true;
+    bool mIsIdle = false;
+    int mSilentSamples = 0;
+    int mTailSamples = 0;
+
+    template <typename SampleType>
+    bool isSilent (const juce::AudioBuffer<SampleType>& buffer, int numChannels) const noexcept;
+
+    template <typename SampleType>
+    void skipIdleBlock (int numSamples) noexcept;
+
+    template <typename SampleType>
+    void updateParameters() noexcept;
+
+    // the worker threads, and how long to keep off them after they fell behind
+    VoiceWorkerPool mWorkerPool;
+    int mNumWorkerThreads = 0;
+    int mWorkerBackoffSamples = 0;
+    int mWorkerBackoffLength = 0;
+    double mSubBlockSeconds = 0.0;
+
+    // how many groups to split numVoices voices into, one if they're all rendered on the audio thread
+    template <typename SampleType>
+    int getNumVoiceGroups (int numVoices) noexcept;
+
+    // picks up the parameters for the next sub-block, unless a preset switch is fading out the old ones
+    template <typename SampleType>
+    void updateSettings (int numSamples) noexcept;
+
+    // the host's program, and the fade round a switch to it or to a restored state
+    std::atomic<int> mCurrentProgram { 0 };
+    std::uint32_t mAppliedPresetSequence = 0;
+    bool mSwitchingPreset = false;
+    float mPresetGain = 1.0f;
+    float mPresetGainStep = 0.0f;
+
+    DspLoadMeter mLoadMeter;
+
+    // the quality tier, picked at the start of each host block
+    EcoMode mEco;
+    int mEcoTier = 0;
+    std::atomic<int> mReportedEcoTier { 0 };
+
+   #if WAYLOCHORUS_TRACE
+    TraceRecorder mTrace;
+    std::unique_ptr<TraceFileWriter> mTraceWriter;
+   #endif
+
+    // the channel layouts isBusesLayoutSupported allows, each gets its own kernels;
+    // a stereo input summed to mono goes through the mono to stereo ones, and
+    // dual stereo on an interleaved line through stereoInterleaved
+    enum class ChannelLayout
+    {
+        mono,               // one delay line, one output
+        monoToStereo,       // one delay line, each voice panned across both outputs
+        stereo,             // a delay line per channel
+        stereoInterleaved   // a delay line per channel, stored as frames in one buffer
+    };
+
+    template <typename SampleType>
+    void processSamples (juce::AudioBuffer<SampleType>& buffer) noexcept;
+
+    template <typename SampleType, typename Interpolator, ChannelLayout layout>
+    void processChunkScalar (const SampleType* leftIn, const SampleType* rightIn, SampleType* leftOut, SampleType* rightOut, int chunkLength, const ChorusControlSnapshot& control) noexcept;
+
+    // Length is an int, or a std::integral_constant for a full sub-block so the loops know their length
+    template <typename SampleType, typename Interpolator, ChannelLayout layout, typename Length>
+    void processChunkVectorised (const SampleType* leftIn, const SampleType* rightIn, SampleType* leftOut, SampleType* rightOut, Length chunkLength, const ChorusControlSnapshot& control) noexcept;
+
+    // the voices from firstVoice up to endVoice, added to a pair of mix buffers; any thread, each with its own workspace
+    template <typename SampleType, typename Interpolator, ChannelLayout layout, typename Length>
+    void addVoices (int firstVoice, int endVoice, SampleType* mixLeft, SampleType* mixRight, Length chunkLength, const ChorusControlSnapshot& control, int workspace) noexcept;
+
+    // the feedback network's kernels, for the mono and mono to stereo layouts; a stereo input is summed
+    template <typename SampleType, typename Interpolator, ChannelLayout layout>
+    void processFeedbackChunkScalar (const SampleType* input, SampleType* leftOut, SampleType* rightOut, int chunkLength, const ChorusControlSnapshot& control) noexcept;
+
+    template <typename SampleType, typename Interpolator, ChannelLayout layout, typename Length>
+    void processFeedbackChunkVectorised (const SampleType* input, SampleType* leftOut, SampleType* rightOut, Length chunkLength, const ChorusControlSnapshot& control) noexcept;
+
+    // the BBD emulation's kernels, for the same layouts; they always read with linear interpolation
+    template <typename SampleType, ChannelLayout layout>
+    void processBbdChunkScalar (const SampleType* input, SampleType* leftOut, SampleType* rightOut, int chunkLength, const ChorusControlSnapshot& control) noexcept;
 
+    template <typename SampleType, ChannelLayout layout, typename Length>
+    void processBbdChunkVectorised (const SampleType* input, SampleType* leftOut, SampleType* rightOut, Length chunkLength, const ChorusControlSnapshot& control) noexcept;
 };
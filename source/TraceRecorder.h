@@ -0,0 +1,272 @@
+/*
+  ==============================================================================
+
+    TraceRecorder.h
+
+    Timestamped markers around the stages of the processor, written out in the
+    Chrome trace event format (chrome://tracing, ui.perfetto.dev).
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <memory>
+#include <vector>
+
+// set WAYLOCHORUS_TRACE=1 to put the markers into the processor; with 0 they compile to nothing
+#ifndef WAYLOCHORUS_TRACE
+    #define WAYLOCHORUS_TRACE 0
+#endif
+
+//==============================================================================
+/**
+    A fixed-size, lock-free ring of trace events.
+
+    Any thread can record (the audio thread from processBlock, the message
+    thread from prepareToPlay and the state calls), one other thread drains.
+    Recording is a few atomic operations and a copy of a small struct; it never
+    allocates, locks or blocks. When the ring is full the event is dropped and
+    counted instead.
+
+    Event names aren't copied, they must be string literals or otherwise live
+    as long as the recorder.
+*/
+class TraceRecorder
+{
+public:
+    //==============================================================================
+    struct Event
+    {
+        const char* name = nullptr;
+        juce::int64 startTicks = 0;
+        juce::int64 endTicks = 0;
+        juce::uint64 threadId = 0;
+        int numSamples = 0;
+    };
+
+    static constexpr size_t capacity = 1 << 14;
+
+    TraceRecorder()
+        : mSlots (std::make_unique<Slot[]> (capacity))
+    {
+        for (size_t i = 0; i < capacity; ++i)
+            mSlots[i].sequence.store (i, std::memory_order_relaxed);
+    }
+
+    //==============================================================================
+    /** Adds an event, from any thread. Returns false if the ring was full and it was dropped. */
+    bool record (const Event& event) noexcept
+    {
+        auto position = mWritePosition.load (std::memory_order_relaxed);
+
+        for (;;)
+        {
+            auto& slot = mSlots[position & (capacity - 1)];
+            const auto sequence = slot.sequence.load (std::memory_order_acquire);
+            const auto difference = (std::ptrdiff_t) sequence - (std::ptrdiff_t) position;
+
+            if (difference == 0)
+            {
+                // the slot is free, claim it unless another thread got there first
+                if (mWritePosition.compare_exchange_weak (position, position + 1, std::memory_order_relaxed))
+                {
+                    slot.event = event;
+                    slot.sequence.store (position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (difference < 0)
+            {
+                mNumDropped.fetch_add (1, std::memory_order_relaxed);
+                return false;
+            }
+            else
+            {
+                position = mWritePosition.load (std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /** Moves everything recorded so far onto the end of events. One draining thread at a time. */
+    void drain (std::vector<Event>& events)
+    {
+        for (;;)
+        {
+            auto& slot = mSlots[mReadPosition & (capacity - 1)];
+
+            if (slot.sequence.load (std::memory_order_acquire) != mReadPosition + 1)
+                return;
+
+            events.push_back (slot.event);
+            slot.sequence.store (mReadPosition + capacity, std::memory_order_release);
+            ++mReadPosition;
+        }
+    }
+
+    /** Events lost because the ring was full. */
+    juce::uint64 getNumDropped() const noexcept { return mNumDropped.load (std::memory_order_relaxed); }
+
+    static juce::uint64 getCurrentThreadId() noexcept
+    {
+        return (juce::uint64) reinterpret_cast<std::uintptr_t> (juce::Thread::getCurrentThreadId());
+    }
+
+    //==============================================================================
+    /** Records its own lifetime as one event. */
+    class Scope
+    {
+    public:
+        Scope (TraceRecorder& recorder, const char* name, int numSamples = 0) noexcept
+            : mRecorder (recorder)
+        {
+            mEvent.name = name;
+            mEvent.numSamples = numSamples;
+            mEvent.startTicks = juce::Time::getHighResolutionTicks();
+        }
+
+        ~Scope() noexcept
+        {
+            mEvent.endTicks = juce::Time::getHighResolutionTicks();
+            mEvent.threadId = getCurrentThreadId();
+            mRecorder.record (mEvent);
+        }
+
+    private:
+        TraceRecorder& mRecorder;
+        Event mEvent;
+
+        JUCE_DECLARE_NON_COPYABLE (Scope)
+    };
+
+private:
+    //==============================================================================
+    struct Slot
+    {
+        std::atomic<size_t> sequence { 0 };
+        Event event;
+    };
+
+    std::unique_ptr<Slot[]> mSlots;
+    alignas (64) std::atomic<size_t> mWritePosition { 0 };
+    alignas (64) size_t mReadPosition = 0;
+    std::atomic<juce::uint64> mNumDropped { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE (TraceRecorder)
+};
+
+//==============================================================================
+/**
+    Formats trace events as Chrome trace "complete" events, one JSON object per
+    event. Timestamps are microseconds from the first event the formatter sees,
+    threads are numbered in the order they show up.
+*/
+class ChromeTraceFormatter
+{
+public:
+    static constexpr const char* header = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    static constexpr const char* footer = "\n]}\n";
+
+    void append (juce::String& json, const TraceRecorder::Event& event)
+    {
+        if (mNumWritten == 0)
+            mOrigin = event.startTicks;
+
+        mThreads.addIfNotAlreadyThere (event.threadId);
+
+        json << (mNumWritten == 0 ? "" : ",\n")
+             << "{\"name\":\"" << (event.name != nullptr ? event.name : "?")
+             << "\",\"cat\":\"waylochorus\",\"ph\":\"X\",\"ts\":" << juce::String ((double) (event.startTicks - mOrigin) * mTicksToMicroseconds, 3)
+             << ",\"dur\":" << juce::String ((double) (event.endTicks - event.startTicks) * mTicksToMicroseconds, 3)
+             << ",\"pid\":1,\"tid\":" << mThreads.indexOf (event.threadId) + 1
+             << ",\"args\":{\"samples\":" << event.numSamples << "}}";
+
+        ++mNumWritten;
+    }
+
+    juce::uint64 getNumWritten() const noexcept { return mNumWritten; }
+
+private:
+    const double mTicksToMicroseconds = 1.0e6 / (double) juce::Time::getHighResolutionTicksPerSecond();
+    juce::int64 mOrigin = 0;
+    juce::uint64 mNumWritten = 0;
+    juce::Array<juce::uint64> mThreads; // a tid is the index here plus one
+};
+
+//==============================================================================
+/**
+    Drains a TraceRecorder into a JSON file from a background thread, every
+    drainIntervalMs, so the ring never has to hold more than that much. The
+    file is finished off when the writer is destroyed.
+*/
+class TraceFileWriter : private juce::Thread
+{
+public:
+    static constexpr int drainIntervalMs = 20;
+
+    TraceFileWriter (TraceRecorder& recorder, const juce::File& file)
+        : juce::Thread ("Trace writer"),
+          mRecorder (recorder),
+          mStream (file)
+    {
+        // start the file afresh rather than append to an old trace
+        if (mStream.openedOk())
+        {
+            mStream.setPosition (0);
+            mStream.truncate();
+        }
+
+        mStream << ChromeTraceFormatter::header;
+        startThread();
+    }
+
+    ~TraceFileWriter() override
+    {
+        stopThread (1000);
+
+        // whatever came in since the last pass
+        drainToFile();
+        mStream << ChromeTraceFormatter::footer;
+    }
+
+private:
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            drainToFile();
+            wait (drainIntervalMs);
+        }
+    }
+
+    void drainToFile()
+    {
+        mEvents.clear();
+        mRecorder.drain (mEvents);
+
+        mJson.clear();
+
+        for (const auto& event : mEvents)
+            mFormatter.append (mJson, event);
+
+        mStream << mJson;
+        mStream.flush();
+    }
+
+    TraceRecorder& mRecorder;
+    juce::FileOutputStream mStream;
+    ChromeTraceFormatter mFormatter;
+    std::vector<TraceRecorder::Event> mEvents;
+    juce::String mJson;
+
+    JUCE_DECLARE_NON_COPYABLE (TraceFileWriter)
+};
+
+//==============================================================================
+#if WAYLOCHORUS_TRACE
+    #define WAYLOCHORUS_TRACE_SCOPE(recorder, name, numSamples) \
+        const TraceRecorder::Scope JUCE_JOIN_MACRO (traceScope, __LINE__) (recorder, name, numSamples)
+#else
+    #define WAYLOCHORUS_TRACE_SCOPE(recorder, name, numSamples)
+#endif
@@ -0,0 +1,308 @@
+/*
+  ==============================================================================
+
+    VoiceWorkerPool.h
+
+    A few pre-spawned threads that help the audio thread render voices.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#if JUCE_INTEL
+    #include <immintrin.h>
+#endif
+
+//==============================================================================
+/**
+    Spreads independent tasks across the audio thread and a handful of worker
+    threads, without locking or allocating on the audio thread.
+
+    The threads are started by setNumWorkers() while nothing is processing.
+    After that, run() hands out a job's tasks through one atomic counter. Every
+    thread, the caller included, claims the next unclaimed task until there
+    are none left, so tasks no worker picks up in time are simply done by the
+    caller. run() then spins until the tasks other threads claimed are done,
+    but only for as long as the caller allows: a worker the scheduler has put
+    aside can't hold up the audio thread past that, the caller redoes its task.
+
+    A worker that has had nothing to do for spinSeconds goes to sleep on a
+    futex (std::atomic::wait), and wake() brings it back. Call wake() at the
+    start of each host block, so sleeping workers are spinning again by the
+    time the first job comes; it only makes a system call when one of them is
+    asleep.
+
+    Thread 0 is the caller and the workers are threads 1 and up, so a task can
+    use its thread index to pick per-thread scratch space.
+*/
+class VoiceWorkerPool
+{
+public:
+    //==============================================================================
+    /** The caller and up to three workers, one per core on a Raspberry Pi. */
+    static constexpr int maxThreads = 4;
+    static constexpr int maxWorkers = maxThreads - 1;
+
+    /** The most tasks one job can have. */
+    static constexpr int maxTasks = 64;
+
+    /** How long an idle worker keeps spinning before it goes to sleep. */
+    static constexpr double spinSeconds = 0.001;
+
+    VoiceWorkerPool() = default;
+    ~VoiceWorkerPool() { setNumWorkers (0); }
+
+    //==============================================================================
+    /** Stops the running workers and starts numWorkers (0..maxWorkers) new ones,
+        at real-time priority where the system allows it. Never while run() can be
+        called, so from prepareToPlay or releaseResources rather than the host's
+        message thread at any time.
+    */
+    void setNumWorkers (int numWorkers)
+    {
+        jassert (juce::isPositiveAndNotGreaterThan (numWorkers, maxWorkers));
+        jassert (! mIsRunning.load());
+
+        // the audio thread stops handing out work before the threads go away
+        mNumWorkers.store (0, std::memory_order_release);
+
+        for (auto& worker : mWorkers)
+            worker->signalThreadShouldExit();
+
+        mWakeCount.fetch_add (1, std::memory_order_release);
+        mWakeCount.notify_all();
+
+        // each worker is joined as it's destroyed
+        mWorkers.clear();
+        mTicksPerSecond = (double) juce::Time::getHighResolutionTicksPerSecond();
+
+        for (int i = 0; i < juce::jlimit (0, maxWorkers, numWorkers); ++i)
+        {
+            mWorkers.push_back (std::make_unique<Worker> (*this, i + 1));
+
+            if (! mWorkers.back()->startRealtimeThread (juce::Thread::RealtimeOptions().withPriority (8)))
+                mWorkers.back()->startThread (juce::Thread::Priority::highest);
+        }
+
+        mNumWorkers.store ((int) mWorkers.size(), std::memory_order_release);
+    }
+
+    /** Safe to call from any thread. */
+    int getNumWorkers() const noexcept { return mNumWorkers.load (std::memory_order_acquire); }
+    int getNumThreads() const noexcept { return getNumWorkers() + 1; }
+
+    //==============================================================================
+    /** Wakes any worker that has gone to sleep. From the audio thread, once per host block. */
+    void wake() noexcept
+    {
+        if (mNumSleeping.load (std::memory_order_acquire) > 0)
+        {
+            mWakeCount.fetch_add (1, std::memory_order_release);
+            mWakeCount.notify_all();
+        }
+    }
+
+    /** Calls function (task, thread) once for each task in 0..numTasks - 1, spread
+        across the caller and the workers.
+
+        The caller waits at most maxWaitSeconds for the tasks the workers have
+        claimed. A task that isn't finished by then is given up on: takeOver (task)
+        is called for it on the caller, and has to redo it into memory of its own,
+        since the worker carries on writing wherever the task writes. Until that
+        worker is done, every later job is taken over whole by the caller, so
+        nothing a late task still uses is handed out again. Returns false if any
+        task was taken over; the caller should stop handing out work for a while.
+
+        The function is copied into the pool, so a late worker never calls into
+        the caller's stack. It has to be trivially copyable, which a lambda that
+        captures references, pointers and plain values is.
+    */
+    template <typename Function, typename TakeOver>
+    bool run (int numTasks, const Function& function, const TakeOver& takeOver, double maxWaitSeconds) noexcept
+    {
+        static_assert (std::is_trivially_copyable_v<Function>, "a late worker can still be calling the copy after run() returns");
+        static_assert (sizeof (Function) <= sizeof (mJob) && alignof (Function) <= 64);
+        jassert (juce::isPositiveAndNotGreaterThan (numTasks, maxTasks));
+
+        if (isBusy())
+        {
+            for (int task = 0; task < numTasks; ++task)
+                takeOver (task);
+
+            return false;
+        }
+
+        mIsRunning.store (true, std::memory_order_relaxed);
+        new (mJob) Function (function);
+        mCall = [] (const void* f, int task, int thread) { (*std::launder (static_cast<const Function*> (f))) (task, thread); };
+        mNumDone.store (0, std::memory_order_relaxed);
+
+        for (int task = 0; task < numTasks; ++task)
+            mTaskDone[task].store (false, std::memory_order_relaxed);
+
+        // a new job number with none of its tasks claimed; the release publishes everything above
+        const auto job = (std::uint32_t) (mClaim.load (std::memory_order_relaxed) >> 32) + 1;
+        mClaim.store (((std::uint64_t) job << 32) | ((std::uint64_t) numTasks << 16), std::memory_order_release);
+
+        // every task is claimed by the time this returns, the rest by workers that are busy with them now
+        const auto numWorkerTasks = numTasks - runTasks (0);
+        mNumWorkerTasks.store (numWorkerTasks, std::memory_order_relaxed);
+
+        const auto start = juce::Time::getHighResolutionTicks();
+        const auto maxWaitTicks = (juce::int64) (maxWaitSeconds * mTicksPerSecond);
+        auto onTime = true;
+
+        while (mNumDone.load (std::memory_order_acquire) < numWorkerTasks)
+        {
+            if (juce::Time::getHighResolutionTicks() - start > maxWaitTicks)
+            {
+                onTime = false;
+                break;
+            }
+
+            pause();
+        }
+
+        if (! onTime)
+        {
+            mNumLateJobs.fetch_add (1, std::memory_order_relaxed);
+
+            // a task that finishes after this check is still redone, and what its worker wrote is ignored
+            for (int task = 0; task < numTasks; ++task)
+                if (! mTaskDone[task].load (std::memory_order_acquire))
+                    takeOver (task);
+        }
+
+        mIsRunning.store (false, std::memory_order_relaxed);
+        return onTime;
+    }
+
+    /** True while a worker is still on a task run() gave up waiting for. From the thread that calls run(). */
+    bool isBusy() const noexcept
+    {
+        return mNumDone.load (std::memory_order_acquire) < mNumWorkerTasks.load (std::memory_order_relaxed);
+    }
+
+    /** Blocks until no worker is still on a late task. Not from the audio thread: call it before
+        freeing or reallocating anything the tasks use.
+    */
+    void waitUntilIdle() const noexcept
+    {
+        while (isBusy())
+            std::this_thread::sleep_for (std::chrono::microseconds (100));
+    }
+
+    /** How many jobs have gone over their wait budget, since the pool was made. Any thread. */
+    juce::uint32 getNumLateJobs() const noexcept { return mNumLateJobs.load (std::memory_order_relaxed); }
+
+private:
+    //==============================================================================
+    class Worker : public juce::Thread
+    {
+    public:
+        Worker (VoiceWorkerPool& pool, int index)
+            : juce::Thread ("Voice worker " + juce::String (index)), mPool (pool), mIndex (index)
+        {
+        }
+
+        ~Worker() override { stopThread (-1); }
+
+        void run() override
+        {
+            // the voices are rendered with the same denormal handling as on the audio thread
+            juce::ScopedNoDenormals noDenormals;
+
+            while (! threadShouldExit())
+            {
+                const auto wakeCount = mPool.mWakeCount.load (std::memory_order_acquire);
+                const auto maxIdleTicks = (juce::int64) (spinSeconds * mPool.mTicksPerSecond);
+                auto lastTask = juce::Time::getHighResolutionTicks();
+
+                while (! threadShouldExit())
+                {
+                    if (mPool.runTasks (mIndex) > 0)
+                        lastTask = juce::Time::getHighResolutionTicks();
+                    else if (juce::Time::getHighResolutionTicks() - lastTask > maxIdleTicks)
+                        break;
+                    else
+                        pause();
+                }
+
+                if (threadShouldExit())
+                    break;
+
+                // a wake() between the load above and here isn't waited for
+                mPool.mNumSleeping.fetch_add (1, std::memory_order_acq_rel);
+                mPool.mWakeCount.wait (wakeCount, std::memory_order_acquire);
+                mPool.mNumSleeping.fetch_sub (1, std::memory_order_acq_rel);
+            }
+        }
+
+    private:
+        VoiceWorkerPool& mPool;
+        const int mIndex;
+    };
+
+    // claims and runs tasks of the current job until none are left, returns how many it ran
+    int runTasks (int thread) noexcept
+    {
+        auto claim = mClaim.load (std::memory_order_acquire);
+        int numRun = 0;
+
+        // the job number in the top half, then the number of tasks and the next one to claim;
+        // a claim only succeeds while the job is still the one it was loaded for
+        while ((int) (claim & 0xffff) < (int) ((claim >> 16) & 0xffff))
+        {
+            if (! mClaim.compare_exchange_weak (claim, claim + 1, std::memory_order_acquire, std::memory_order_acquire))
+                continue;
+
+            // nothing about the job changes until every claimed task is done, even one run() gave up on
+            const auto task = (int) (claim & 0xffff);
+            mCall (mJob, task, thread);
+            ++numRun;
+
+            mTaskDone[task].store (true, std::memory_order_release);
+
+            if (thread != 0)
+                mNumDone.fetch_add (1, std::memory_order_release);
+
+            claim = mClaim.load (std::memory_order_acquire);
+        }
+
+        return numRun;
+    }
+
+    static void pause() noexcept
+    {
+       #if JUCE_INTEL
+        _mm_pause();
+       #elif JUCE_ARM && (defined (__GNUC__) || defined (__clang__))
+        __asm__ __volatile__ ("yield");
+       #endif
+    }
+
+    // the claim counter is hammered by every thread, so it gets a cache line of its own
+    alignas (64) std::atomic<std::uint64_t> mClaim { 0 };
+    alignas (64) std::atomic<int> mNumDone { 0 };
+
+    // the current job, only written while no worker is on a task
+    alignas (64) std::byte mJob[128] {};
+    void (*mCall) (const void*, int, int) = nullptr;
+    std::atomic<bool> mTaskDone[maxTasks] {};
+    std::atomic<int> mNumWorkerTasks { 0 };
+
+    std::atomic<int> mWakeCount { 0 };
+    std::atomic<int> mNumSleeping { 0 };
+    std::atomic<juce::uint32> mNumLateJobs { 0 };
+    double mTicksPerSecond = 1.0;
+
+    // the worker count is what the audio thread reads, the threads themselves only change in setNumWorkers
+    std::vector<std::unique_ptr<Worker>> mWorkers;
+    std::atomic<int> mNumWorkers { 0 };
+    std::atomic<bool> mIsRunning { false };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (VoiceWorkerPool)
+};
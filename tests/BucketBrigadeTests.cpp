@@ -0,0 +1,177 @@
+#include "helpers/test_helpers.h"
+#include <PluginProcessor.h>
+#include <catch2/catch_approx.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    // not a multiple of the sub-block size, so the vectorised kernel sees a short chunk as well
+    constexpr int blockSize = 100;
+
+    // runs a sine through a mono in, mono out processor and returns the RMS of the second half of the output
+    float sineLevel (Waylochorus2AudioProcessor& plugin, float frequency, float amplitude)
+    {
+        juce::AudioBuffer<float> buffer (1, blockSize);
+        juce::MidiBuffer midi;
+        constexpr int numBlocks = 200;
+        double sumOfSquares = 0.0;
+        int numSummed = 0;
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            for (int i = 0; i < blockSize; ++i)
+                buffer.setSample (0, i, amplitude * (float) std::sin (juce::MathConstants<double>::twoPi * frequency * (block * blockSize + i) / sampleRate));
+
+            plugin.processBlock (buffer, midi);
+
+            if (block >= numBlocks / 2)
+            {
+                for (int i = 0; i < blockSize; ++i)
+                    sumOfSquares += buffer.getSample (0, i) * buffer.getSample (0, i);
+
+                numSummed += blockSize;
+            }
+        }
+
+        return (float) std::sqrt (sumOfSquares / numSummed);
+    }
+}
+
+TEST_CASE ("BBD clock sets the bandwidth", "[bbd]")
+{
+    BucketBrigade<float> bbd;
+    bbd.prepare (sampleRate, blockSize);
+
+    // 1024 stages at 20 ms clock at 25.6 kHz
+    const auto delay = (float) (0.02 * sampleRate);
+    CHECK (bbd.getCutoff (delay) == Catch::Approx (BucketBrigade<float>::clockBandwidth * 25600.0));
+
+    // a longer delay clocks slower, a longer chip faster
+    CHECK (bbd.getCutoff (2.0f * delay) == Catch::Approx (0.5 * bbd.getCutoff (delay)));
+
+    const auto shortChipCutoff = bbd.getCutoff (delay);
+    bbd.setNumStages (2048);
+    CHECK (bbd.getCutoff (2.0f * delay) == Catch::Approx (shortChipCutoff));
+
+    // however short the delay, it stays below the host's Nyquist frequency
+    CHECK (bbd.getCutoff (1.0f) < 0.5 * sampleRate);
+}
+
+TEST_CASE ("BBD kernels match", "[bbd]")
+{
+    const auto channelCounts = GENERATE (std::pair (1, 1), std::pair (1, 2), std::pair (2, 2));
+    CAPTURE (channelCounts.first, channelCounts.second);
+
+    Waylochorus2AudioProcessor scalar, vectorised;
+    scalar.setKernel (Waylochorus2AudioProcessor::Kernel::scalar);
+
+    for (auto* plugin : { &scalar, &vectorised })
+    {
+        setParameter (*plugin, ChorusParameters::bbdId, 1.0f);
+        setParameter (*plugin, ChorusParameters::numVoicesId, 13.0f);
+        REQUIRE (prepareWithChannels (*plugin, channelCounts.first, channelCounts.second, sampleRate, blockSize));
+    }
+
+    juce::AudioBuffer<float> scalarBuffer (channelCounts.second, blockSize), vectorisedBuffer (channelCounts.second, blockSize);
+    juce::MidiBuffer midi;
+    juce::Random random (29);
+    float maxDifference = 0.0f;
+
+    for (int block = 0; block < 100; ++block)
+    {
+        // a change of chip part way, so the filters move
+        if (block == 50)
+            for (auto* plugin : { &scalar, &vectorised })
+                setParameter (*plugin, ChorusParameters::bbdStagesId, 3.0f);
+
+        for (int channel = 0; channel < channelCounts.first; ++channel)
+        {
+            for (int i = 0; i < blockSize; ++i)
+            {
+                const auto sample = random.nextFloat() - 0.5f;
+                scalarBuffer.setSample (channel, i, sample);
+                vectorisedBuffer.setSample (channel, i, sample);
+            }
+        }
+
+        scalar.processBlock (scalarBuffer, midi);
+        vectorised.processBlock (vectorisedBuffer, midi);
+
+        for (int channel = 0; channel < channelCounts.second; ++channel)
+            for (int i = 0; i < blockSize; ++i)
+                maxDifference = std::max (maxDifference, std::abs (scalarBuffer.getSample (channel, i) - vectorisedBuffer.getSample (channel, i)));
+    }
+
+    CHECK (vectorisedBuffer.getMagnitude (0, 0, blockSize) > 1.0e-3f);
+
+    // the same filters, only with the voices summed in another order
+    CHECK (maxDifference < 1.0e-4f);
+}
+
+TEST_CASE ("BBD emulation sounds like a BBD", "[bbd]")
+{
+    const auto makePlugin = [] (bool bbd, int stagesIndex)
+    {
+        auto plugin = std::make_unique<Waylochorus2AudioProcessor>();
+        setParameter (*plugin, ChorusParameters::bbdId, bbd ? 1.0f : 0.0f);
+        setParameter (*plugin, ChorusParameters::bbdStagesId, (float) stagesIndex);
+
+        for (int i = 0; i < ChorusVoiceTable::numSourceVoices; ++i)
+            setParameter (*plugin, ChorusParameters::delayId + juce::String (i + 1), 40.0f);
+
+        REQUIRE (prepareWithChannels (*plugin, 1, 1, sampleRate, blockSize));
+        return plugin;
+    };
+
+    SECTION ("low frequencies come through the compander at about the level they went in")
+    {
+        const auto plain = sineLevel (*makePlugin (false, 1), 200.0f, 0.25f);
+        const auto bbd = sineLevel (*makePlugin (true, 1), 200.0f, 0.25f);
+
+        CHECK (plain > 0.01f);
+        CHECK (bbd > 0.5f * plain);
+        CHECK (bbd < 2.0f * plain);
+    }
+
+    SECTION ("a short chip at a long delay loses the top end")
+    {
+        // 512 stages at 40 ms clock at 6.4 kHz, 4096 stages at 51.2 kHz
+        const auto shortChip = sineLevel (*makePlugin (true, 0), 8000.0f, 0.25f);
+        const auto longChip = sineLevel (*makePlugin (true, 3), 8000.0f, 0.25f);
+
+        CHECK (longChip > 0.01f);
+        CHECK (shortChip < 0.1f * longChip);
+    }
+}
+
+TEST_CASE ("Switching the BBD emulation doesn't replay old audio", "[bbd]")
+{
+    Waylochorus2AudioProcessor plugin;
+    REQUIRE (prepareWithChannels (plugin, 1, 2, sampleRate, blockSize));
+
+    juce::AudioBuffer<float> buffer (2, blockSize);
+    juce::MidiBuffer midi;
+    juce::Random random (31);
+
+    for (int block = 0; block < 20; ++block)
+    {
+        for (int i = 0; i < blockSize; ++i)
+            buffer.setSample (0, i, random.nextFloat() - 0.5f);
+
+        plugin.processBlock (buffer, midi);
+    }
+
+    // the line is full of unprocessed input, the BBD mode mustn't play it back
+    setParameter (plugin, ChorusParameters::bbdId, 1.0f);
+
+    for (int block = 0; block < 10; ++block)
+    {
+        buffer.clear();
+        plugin.processBlock (buffer, midi);
+
+        CHECK (buffer.getMagnitude (0, 0, blockSize) == 0.0f);
+        CHECK (buffer.getMagnitude (1, 0, blockSize) == 0.0f);
+    }
+}
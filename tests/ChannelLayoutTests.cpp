@@ -0,0 +1,195 @@
+#include "helpers/test_helpers.h"
+#include <PluginProcessor.h>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 128;
+
+    using BusesLayout = juce::AudioProcessor::BusesLayout;
+
+    BusesLayout makeLayout (juce::AudioChannelSet input, juce::AudioChannelSet output)
+    {
+        BusesLayout layout;
+        layout.inputBuses = { input };
+        layout.outputBuses = { output };
+        return layout;
+    }
+
+    void prepare (Waylochorus2AudioProcessor& plugin, juce::AudioChannelSet input, juce::AudioChannelSet output)
+    {
+        REQUIRE (plugin.setBusesLayout (makeLayout (input, output)));
+        plugin.setRateAndBufferSizeDetails (sampleRate, blockSize);
+        plugin.prepareToPlay (sampleRate, blockSize);
+    }
+
+    // runs numBlocks of noise through the input channels, and returns the peak difference between the two outputs
+    float processNoise (Waylochorus2AudioProcessor& plugin, juce::AudioBuffer<float>& buffer, int numInputs, int numBlocks)
+    {
+        juce::MidiBuffer midi;
+        juce::Random random (3);
+        float maxDifference = 0.0f;
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            buffer.clear();
+
+            for (int channel = 0; channel < numInputs; ++channel)
+                for (int i = 0; i < blockSize; ++i)
+                    buffer.setSample (channel, i, random.nextFloat() - 0.5f);
+
+            plugin.processBlock (buffer, midi);
+
+            if (buffer.getNumChannels() > 1)
+                for (int i = 0; i < blockSize; ++i)
+                    maxDifference = std::max (maxDifference, std::abs (buffer.getSample (0, i) - buffer.getSample (1, i)));
+        }
+
+        return maxDifference;
+    }
+}
+
+TEST_CASE ("Supported channel layouts", "[layout]")
+{
+    Waylochorus2AudioProcessor plugin;
+    const auto mono = juce::AudioChannelSet::mono();
+    const auto stereo = juce::AudioChannelSet::stereo();
+
+    CHECK (plugin.isBusesLayoutSupported (makeLayout (mono, mono)));
+    CHECK (plugin.isBusesLayoutSupported (makeLayout (mono, stereo)));
+    CHECK (plugin.isBusesLayoutSupported (makeLayout (stereo, stereo)));
+
+    // folding stereo down to mono would need a mix it doesn't have
+    CHECK_FALSE (plugin.isBusesLayoutSupported (makeLayout (stereo, mono)));
+}
+
+TEST_CASE ("Mono processes a one channel buffer", "[layout]")
+{
+    const auto kernel = GENERATE (Waylochorus2AudioProcessor::Kernel::scalar, Waylochorus2AudioProcessor::Kernel::vectorised);
+
+    Waylochorus2AudioProcessor plugin;
+    plugin.setKernel (kernel);
+    prepare (plugin, juce::AudioChannelSet::mono(), juce::AudioChannelSet::mono());
+
+    juce::AudioBuffer<float> buffer (1, blockSize);
+    processNoise (plugin, buffer, 1, 20);
+
+    CHECK (buffer.getMagnitude (0, 0, blockSize) > 0.0f);
+}
+
+TEST_CASE ("Dual stereo keeps the channels apart", "[layout]")
+{
+    const auto kernel = GENERATE (Waylochorus2AudioProcessor::Kernel::scalar, Waylochorus2AudioProcessor::Kernel::vectorised);
+
+    Waylochorus2AudioProcessor plugin;
+    plugin.setKernel (kernel);
+    setParameter (plugin, ChorusParameters::stereoModeId, (float) ChorusParameters::StereoMode::dual);
+    prepare (plugin, juce::AudioChannelSet::stereo(), juce::AudioChannelSet::stereo());
+
+    juce::AudioBuffer<float> buffer (2, blockSize);
+
+    SECTION ("noise on the left only, none of it may reach the right")
+    {
+        processNoise (plugin, buffer, 1, 20);
+
+        CHECK (buffer.getMagnitude (0, 0, blockSize) > 0.0f);
+        CHECK (buffer.getMagnitude (1, 0, blockSize) == 0.0f);
+    }
+
+    SECTION ("coming back from the mono sum doesn't replay what the right line held")
+    {
+        processNoise (plugin, buffer, 2, 20);
+
+        setParameter (plugin, ChorusParameters::stereoModeId, (float) ChorusParameters::StereoMode::monoSum);
+        processNoise (plugin, buffer, 2, 1);
+
+        setParameter (plugin, ChorusParameters::stereoModeId, (float) ChorusParameters::StereoMode::dual);
+
+        for (int block = 0; block < 20; ++block)
+        {
+            processNoise (plugin, buffer, 1, 1);
+            CHECK (buffer.getMagnitude (1, 0, blockSize) == 0.0f);
+        }
+    }
+}
+
+TEST_CASE ("Mono to stereo pans each voice", "[layout]")
+{
+    const auto kernel = GENERATE (Waylochorus2AudioProcessor::Kernel::scalar, Waylochorus2AudioProcessor::Kernel::vectorised);
+
+    Waylochorus2AudioProcessor plugin;
+    plugin.setKernel (kernel);
+    prepare (plugin, juce::AudioChannelSet::mono(), juce::AudioChannelSet::stereo());
+
+    juce::AudioBuffer<float> buffer (2, blockSize);
+
+    SECTION ("voices spread across the outputs")
+    {
+        CHECK (processNoise (plugin, buffer, 1, 20) > 0.01f);
+        CHECK (buffer.getMagnitude (0, 0, blockSize) > 0.0f);
+        CHECK (buffer.getMagnitude (1, 0, blockSize) > 0.0f);
+    }
+
+    SECTION ("centred voices sound the same on both sides")
+    {
+        for (int i = 0; i < ChorusVoiceTable::numSourceVoices; ++i)
+            setParameter (plugin, ChorusParameters::panId + juce::String (i + 1), 0.0f);
+
+        // let the pan glide settle before comparing
+        processNoise (plugin, buffer, 1, 20);
+        CHECK (processNoise (plugin, buffer, 1, 20) < 1.0e-6f);
+    }
+}
+
+TEST_CASE ("Mono sum mixes a stereo input down to one line", "[layout]")
+{
+    const auto kernel = GENERATE (Waylochorus2AudioProcessor::Kernel::scalar, Waylochorus2AudioProcessor::Kernel::vectorised);
+
+    Waylochorus2AudioProcessor summed, mono;
+
+    for (auto* plugin : { &summed, &mono })
+        plugin->setKernel (kernel);
+
+    // the default for a stereo input
+    prepare (summed, juce::AudioChannelSet::stereo(), juce::AudioChannelSet::stereo());
+    prepare (mono, juce::AudioChannelSet::mono(), juce::AudioChannelSet::stereo());
+
+    SECTION ("one channel reaches both sides")
+    {
+        juce::AudioBuffer<float> buffer (2, blockSize);
+        processNoise (summed, buffer, 1, 20);
+
+        CHECK (buffer.getMagnitude (0, 0, blockSize) > 0.0f);
+        CHECK (buffer.getMagnitude (1, 0, blockSize) > 0.0f);
+    }
+
+    SECTION ("the same signal on both channels sounds like it does through a mono input")
+    {
+        juce::AudioBuffer<float> summedBuffer (2, blockSize), monoBuffer (2, blockSize);
+        juce::MidiBuffer midi;
+        juce::Random random (7);
+        float maxDifference = 0.0f;
+
+        for (int block = 0; block < 20; ++block)
+        {
+            for (int i = 0; i < blockSize; ++i)
+            {
+                const auto sample = random.nextFloat() - 0.5f;
+                summedBuffer.setSample (0, i, sample);
+                summedBuffer.setSample (1, i, sample);
+                monoBuffer.setSample (0, i, sample);
+            }
+
+            summed.processBlock (summedBuffer, midi);
+            mono.processBlock (monoBuffer, midi);
+
+            for (int channel = 0; channel < 2; ++channel)
+                for (int i = 0; i < blockSize; ++i)
+                    maxDifference = std::max (maxDifference, std::abs (summedBuffer.getSample (channel, i) - monoBuffer.getSample (channel, i)));
+        }
+
+        CHECK (maxDifference == 0.0f);
+    }
+}
@@ -0,0 +1,150 @@
+#include <ChorusLfo.h>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+// the LFO writes whole SIMD registers, so like the processor, give every voice a cache aligned row
+struct LfoRows
+{
+    explicit LfoRows (int numSamples)
+        : stride ((numSamples + 15) & ~15),
+          storage ((size_t) (ChorusVoiceTable::maxVoices * stride + 16))
+    {
+        const auto address = reinterpret_cast<std::uintptr_t> (storage.data());
+        data = reinterpret_cast<float*> ((address + 63) & ~(std::uintptr_t) 63);
+    }
+
+    float get (int voice, int sample) const { return data[voice * stride + sample]; }
+
+    int stride;
+    std::vector<float> storage;
+    float* data = nullptr;
+};
+
+TEST_CASE ("Sine LFO matches std::sin", "[lfo]")
+{
+    // the per-sample std::sin it replaced, in double precision
+    constexpr double sampleRate = 48000.0;
+
+    // the rounding builds up over a block, so the processor's sub-blocks get the tighter bound
+    const auto blockSize = GENERATE (16, 64, 512, 4096);
+    const auto tolerance = blockSize <= 64 ? 1.0e-6 : 1.0e-5;
+
+    ChorusVoiceTable voices;
+    ChorusControlPlane control;
+    control.prepare (sampleRate);
+    control.reset (voices);
+
+    ChorusLfo lfo;
+
+    LfoRows out (blockSize);
+    double maxError = 0.0;
+    long long sample = 0;
+
+    // ten seconds, long enough for the phase to wrap a few times
+    for (int block = 0; block < (int) (10 * sampleRate) / blockSize; ++block)
+    {
+        lfo.process (control.getSnapshot(), voices.phase, out.data, out.stride, blockSize);
+
+        for (int i = 0; i < blockSize; ++i, ++sample)
+        {
+            for (int v = 0; v < voices.numVoices; ++v)
+            {
+                const auto expected = std::sin (juce::MathConstants<double>::twoPi * voices.rate[v] * (double) sample / sampleRate);
+                maxError = std::max (maxError, std::abs (expected - out.get (v, i)));
+            }
+        }
+    }
+
+    CHECK (maxError < tolerance);
+}
+
+TEST_CASE ("LFO shapes stay in range and continuous", "[lfo]")
+{
+    constexpr double sampleRate = 44100.0;
+    constexpr int blockSize = 37;
+
+    const auto shape = GENERATE (ChorusLfo::Shape::sine, ChorusLfo::Shape::triangle, ChorusLfo::Shape::smoothRandom);
+
+    ChorusVoiceTable voices;
+    ChorusControlPlane control;
+    control.prepare (sampleRate);
+    control.reset (voices);
+
+    ChorusLfo lfo;
+    lfo.setShape (shape);
+
+    LfoRows out (blockSize);
+    float previous[ChorusVoiceTable::maxVoices] {};
+    float largestStep = 0.0f;
+
+    for (int block = 0; block < 5000; ++block)
+    {
+        lfo.process (control.getSnapshot(), voices.phase, out.data, out.stride, blockSize);
+
+        for (int v = 0; v < voices.numVoices; ++v)
+        {
+            for (int i = 0; i < blockSize; ++i)
+            {
+                const auto value = out.get (v, i);
+                // the recursive sine may overshoot by a rounding error
+                REQUIRE (std::abs (value) <= 1.0f + 1.0e-5f);
+
+                if (block > 0 || i > 0)
+                    largestStep = std::max (largestStep, std::abs (value - previous[v]));
+
+                previous[v] = value;
+            }
+        }
+    }
+
+    // the fastest voice moves well under 0.001 per sample, a jump at a block boundary would show up here
+    CHECK (largestStep < 0.001f);
+}
+
+TEST_CASE ("Control rate LFOs follow the full rate ones", "[lfo]")
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 64;
+
+    const auto shape = GENERATE (ChorusLfo::Shape::sine, ChorusLfo::Shape::triangle, ChorusLfo::Shape::smoothRandom);
+    const auto interval = GENERATE (8, 16, 32);
+    CAPTURE ((int) shape, interval);
+
+    // the ramps cut the triangle's corners, and the full rate random phase is stepped in floats a
+    // sample at a time, so it drifts a little from the control rate one; the sine only sags between points
+    const auto tolerance = shape == ChorusLfo::Shape::sine ? 1.0e-4f : 1.0e-2f;
+
+    ChorusVoiceTable fullVoices, controlVoices;
+    ChorusControlPlane control;
+
+    // the fastest rate there is on every voice, where the ramps are furthest off
+    for (auto* voices : { &fullVoices, &controlVoices })
+    {
+        for (auto& source : voices->sources)
+            source.rate = 5.0f;
+
+        voices->setNumVoices (ChorusVoiceTable::defaultVoices);
+    }
+
+    control.prepare (sampleRate);
+    control.reset (fullVoices);
+
+    ChorusLfo full, controlRate;
+    full.setShape (shape);
+    controlRate.setShape (shape);
+
+    LfoRows fullOut (blockSize), controlOut (blockSize);
+    float maxError = 0.0f;
+
+    for (int block = 0; block < (int) (5 * sampleRate) / blockSize; ++block)
+    {
+        full.process (control.getSnapshot(), fullVoices.phase, fullOut.data, fullOut.stride, blockSize);
+        controlRate.process (control.getSnapshot(), controlVoices.phase, controlOut.data, controlOut.stride, blockSize, interval);
+
+        for (int v = 0; v < fullVoices.numVoices; ++v)
+            for (int i = 0; i < blockSize; ++i)
+                maxError = std::max (maxError, std::abs (fullOut.get (v, i) - controlOut.get (v, i)));
+    }
+
+    CHECK (maxError < tolerance);
+}
@@ -0,0 +1,95 @@
+#include <DelayLine.h>
+#include <catch2/catch_approx.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+namespace
+{
+    // signal to noise ratio of a compact delay line against a float one, both fed the same sine
+    template <typename Interpolator>
+    double measureSnr (float amplitude)
+    {
+        constexpr int blockSize = 128;
+        constexpr int numBlocks = 400;
+        constexpr int numVoices = 4;
+
+        DelayLine<float> reference;
+        DelayLine<float, std::int16_t> compact;
+        reference.prepare (2400, blockSize);
+        compact.prepare (2400, blockSize);
+
+        alignas (64) float input[blockSize];
+        alignas (64) float delays[blockSize];
+        alignas (64) float referenceOut[blockSize];
+        alignas (64) float compactOut[blockSize];
+        double signal = 0.0, noise = 0.0;
+        int sample = 0;
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            for (int i = 0; i < blockSize; ++i, ++sample)
+                input[i] = amplitude * (float) std::sin (juce::MathConstants<double>::twoPi * 997.0 / 48000.0 * sample);
+
+            reference.writeBlock (input, blockSize);
+            compact.writeBlock (input, blockSize);
+
+            std::fill (std::begin (referenceOut), std::end (referenceOut), 0.0f);
+            std::fill (std::begin (compactOut), std::end (compactOut), 0.0f);
+
+            for (int v = 0; v < numVoices; ++v)
+            {
+                // swept delays, so the reads land between samples
+                for (int i = 0; i < blockSize; ++i)
+                    delays[i] = 600.0f + 400.0f * v + 300.0f * (float) std::sin (0.0003 * (block * blockSize + i) + v);
+
+                reference.addTap<Interpolator> (delays, 0.25f, 0.0f, referenceOut, blockSize);
+                compact.addTap<Interpolator> (delays, 0.25f, 0.0f, compactOut, blockSize);
+            }
+
+            // skip the start, while the delay lines still hold silence
+            if (block >= 40)
+            {
+                for (int i = 0; i < blockSize; ++i)
+                {
+                    signal += (double) referenceOut[i] * referenceOut[i];
+                    noise += std::pow ((double) compactOut[i] - referenceOut[i], 2.0);
+                }
+            }
+        }
+
+        return 10.0 * std::log10 (signal / noise);
+    }
+}
+
+TEST_CASE ("16-bit delay storage", "[storage]")
+{
+    using Format = DelayStorage::Format<std::int16_t>;
+
+    SECTION ("round trips within one step")
+    {
+        const auto step = Format::headroom / 32767.0f;
+
+        for (auto sample : { 0.0f, 0.001f, -0.25f, 0.5f, 1.0f, -1.0f, 3.99f })
+            CHECK (Format::load (Format::store (sample)) == Catch::Approx (sample).margin (0.5f * step));
+    }
+
+    SECTION ("saturates above the headroom instead of wrapping")
+    {
+        CHECK (Format::store (2.0f * Format::headroom) == 32767);
+        CHECK (Format::store (-2.0f * Format::headroom) == -32767);
+    }
+
+    SECTION ("keeps the signal well above the rounding noise")
+    {
+        // the sum of four voices, each a quarter of a full scale sine
+        const auto linear = measureSnr<Interpolation::Linear> (1.0f);
+        const auto hermite = measureSnr<Interpolation::Hermite> (1.0f);
+        const auto quiet = measureSnr<Interpolation::Hermite> (0.01f);
+
+        CHECK (linear > 80.0);
+        CHECK (hermite > 80.0);
+
+        // fixed point, so the noise stays put as the signal drops
+        CHECK (quiet > 40.0);
+    }
+}
@@ -0,0 +1,112 @@
+#include <PluginProcessor.h>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 128;
+
+    void prepare (Waylochorus2AudioProcessor& plugin, juce::AudioProcessor::ProcessingPrecision precision, int mode)
+    {
+        auto* interpolation = plugin.getValueTreeState().getParameter (ChorusParameters::interpolationId);
+        interpolation->setValueNotifyingHost (interpolation->convertTo0to1 ((float) mode));
+
+        plugin.setProcessingPrecision (precision);
+        plugin.setRateAndBufferSizeDetails (sampleRate, blockSize);
+        plugin.prepareToPlay (sampleRate, blockSize);
+    }
+}
+
+TEST_CASE ("Double precision processing", "[precision]")
+{
+    Waylochorus2AudioProcessor plugin;
+    CHECK (plugin.supportsDoublePrecisionProcessing());
+}
+
+TEST_CASE ("Double precision sounds like single precision", "[precision]")
+{
+    const auto mode = GENERATE (0, 1, 2, 3);
+    const auto kernel = GENERATE (Waylochorus2AudioProcessor::Kernel::scalar, Waylochorus2AudioProcessor::Kernel::vectorised);
+    CAPTURE (mode);
+
+    Waylochorus2AudioProcessor single, twice;
+    single.setKernel (kernel);
+    twice.setKernel (kernel);
+    prepare (single, juce::AudioProcessor::singlePrecision, mode);
+    prepare (twice, juce::AudioProcessor::doublePrecision, mode);
+
+    juce::AudioBuffer<float> singleBuffer (2, blockSize);
+    juce::AudioBuffer<double> doubleBuffer (2, blockSize);
+    juce::MidiBuffer midi;
+    juce::Random random (11);
+    double maxDifference = 0.0;
+    double peak = 0.0;
+    double sumSquares = 0.0;
+
+    for (int block = 0; block < 100; ++block)
+    {
+        for (int channel = 0; channel < 2; ++channel)
+        {
+            for (int i = 0; i < blockSize; ++i)
+            {
+                const auto sample = random.nextFloat() - 0.5f;
+                singleBuffer.setSample (channel, i, sample);
+                doubleBuffer.setSample (channel, i, (double) sample);
+            }
+        }
+
+        single.processBlock (singleBuffer, midi);
+        twice.processBlock (doubleBuffer, midi);
+
+        for (int channel = 0; channel < 2; ++channel)
+        {
+            for (int i = 0; i < blockSize; ++i)
+            {
+                maxDifference = std::max (maxDifference, std::abs ((double) singleBuffer.getSample (channel, i) - doubleBuffer.getSample (channel, i)));
+                peak = std::max (peak, std::abs (doubleBuffer.getSample (channel, i)));
+                sumSquares += std::pow ((double) singleBuffer.getSample (channel, i) - doubleBuffer.getSample (channel, i), 2.0);
+            }
+        }
+    }
+
+    // the single precision read positions are rounded to float, that's most of the difference
+    CHECK (peak > 0.1);
+
+    if (mode != (int) Interpolation::Mode::allpass)
+    {
+        CHECK (maxDifference < 1.0e-3);
+    }
+    else
+    {
+        // the allpass moves on a sample where its fraction passes one half, and the rounding can put
+        // that a sample earlier or later; the odd sample differs, the sound as a whole doesn't
+        CHECK (std::sqrt (sumSquares / (100.0 * 2 * blockSize)) < 1.0e-2);
+    }
+}
+
+TEST_CASE ("Double precision goes idle and comes back", "[precision]")
+{
+    Waylochorus2AudioProcessor plugin;
+    prepare (plugin, juce::AudioProcessor::doublePrecision, 0);
+
+    juce::AudioBuffer<double> buffer (2, blockSize);
+    juce::MidiBuffer midi;
+    buffer.clear();
+
+    const auto tailBlocks = (int) std::ceil (ChorusVoiceTable::maxDelayMs / 1000.0 * sampleRate / blockSize);
+
+    for (int block = 0; block < tailBlocks + 2; ++block)
+        plugin.processBlock (buffer, midi);
+
+    CHECK (plugin.isIdle());
+
+    for (int i = 0; i < blockSize; ++i)
+        buffer.setSample (0, i, i % 2 == 0 ? 0.5 : -0.5);
+
+    for (int block = 0; block < tailBlocks; ++block)
+        plugin.processBlock (buffer, midi);
+
+    CHECK_FALSE (plugin.isIdle());
+    CHECK (buffer.getMagnitude (0, 0, blockSize) > 0.0);
+}
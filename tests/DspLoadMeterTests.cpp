@@ -0,0 +1,101 @@
+#include <DspLoadMeter.h>
+#include <PluginProcessor.h>
+#include <catch2/catch_approx.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+TEST_CASE ("DSP load meter statistics", "[load]")
+{
+    if (! DspLoadMeter::isEnabled)
+        SKIP ("built with WAYLOCHORUS_LOAD_METER=0");
+
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 480; // 10 ms deadline
+
+    DspLoadMeter meter;
+    meter.prepare (sampleRate);
+
+    SECTION ("starts empty")
+    {
+        const auto stats = meter.getStats();
+        CHECK (stats.load == 0.0f);
+        CHECK (stats.peakLoad == 0.0f);
+        CHECK (stats.overBudgetBlocks == 0);
+        CHECK (stats.blocks == 0);
+    }
+
+    SECTION ("load is the fraction of the deadline, and settles on the average")
+    {
+        meter.addBlock (0.005, blockSize);
+        CHECK (meter.getStats().load == Catch::Approx (0.5f));
+
+        for (int i = 0; i < 1000; ++i)
+            meter.addBlock (0.002, blockSize);
+
+        CHECK (meter.getStats().load == Catch::Approx (0.2f).margin (1.0e-4));
+        CHECK (meter.getStats().blocks == 1001);
+    }
+
+    SECTION ("peak holds the worst block until it's reset")
+    {
+        meter.addBlock (0.002, blockSize);
+        meter.addBlock (0.009, blockSize);
+        meter.addBlock (0.001, blockSize);
+        CHECK (meter.getStats().peakLoad == Catch::Approx (0.9f));
+
+        meter.resetPeak();
+        CHECK (meter.getStats().peakLoad == Catch::Approx (0.9f));
+
+        meter.addBlock (0.003, blockSize);
+        CHECK (meter.getStats().peakLoad == Catch::Approx (0.3f));
+    }
+
+    SECTION ("blocks over their deadline are counted")
+    {
+        meter.addBlock (0.011, blockSize);
+        meter.addBlock (0.009, blockSize);
+        meter.addBlock (0.030, blockSize);
+
+        CHECK (meter.getStats().overBudgetBlocks == 2);
+        CHECK (meter.getStats().peakLoad == Catch::Approx (3.0f));
+    }
+
+    SECTION ("empty blocks are ignored")
+    {
+        meter.addBlock (0.001, 0);
+        CHECK (meter.getStats().blocks == 0);
+    }
+
+    SECTION ("prepare starts over")
+    {
+        meter.addBlock (0.020, blockSize);
+        meter.prepare (sampleRate);
+
+        CHECK (meter.getStats().overBudgetBlocks == 0);
+        CHECK (meter.getStats().blocks == 0);
+    }
+}
+
+TEST_CASE ("processBlock feeds the load meter", "[load]")
+{
+    if (! DspLoadMeter::isEnabled)
+        SKIP ("built with WAYLOCHORUS_LOAD_METER=0");
+
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 256;
+
+    Waylochorus2AudioProcessor plugin;
+    plugin.setRateAndBufferSizeDetails (sampleRate, blockSize);
+    plugin.prepareToPlay (sampleRate, blockSize);
+
+    juce::AudioBuffer<float> buffer (2, blockSize);
+    juce::MidiBuffer midi;
+    buffer.clear();
+
+    for (int block = 0; block < 20; ++block)
+        plugin.processBlock (buffer, midi);
+
+    const auto stats = plugin.getLoadMeter().getStats();
+    CHECK (stats.blocks == 20);
+    CHECK (stats.load > 0.0f);
+    CHECK (stats.peakLoad >= stats.load);
+}
@@ -0,0 +1,220 @@
+#include "helpers/test_helpers.h"
+#include <PluginProcessor.h>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 256;
+
+    /* feeds the same load for a number of seconds' worth of blocks, returns the tier after them */
+    int runFor (EcoMode& eco, float load, double seconds)
+    {
+        int tier = 0;
+
+        for (int i = 0; i < (int) (seconds * sampleRate) / blockSize; ++i)
+            tier = eco.update (EcoMode::Setting::automatic, load, blockSize);
+
+        return tier;
+    }
+}
+
+TEST_CASE ("Eco settings pick their tier", "[eco]")
+{
+    EcoMode eco;
+    eco.prepare (sampleRate);
+
+    CHECK (eco.update (EcoMode::Setting::off, 1.0f, blockSize) == 0);
+    CHECK (eco.update (EcoMode::Setting::tier1, 0.0f, blockSize) == 1);
+    CHECK (eco.update (EcoMode::Setting::tier2, 0.0f, blockSize) == 2);
+    CHECK (eco.update (EcoMode::Setting::tier3, 0.0f, blockSize) == 3);
+
+    CHECK (EcoMode::getControlInterval (0) == 1);
+    CHECK (EcoMode::getControlInterval (1) == 8);
+    CHECK (EcoMode::getControlInterval (3) == 32);
+    CHECK_FALSE (EcoMode::usesLinearInterpolation (1));
+    CHECK (EcoMode::halvesVoices (EcoMode::maxTier));
+}
+
+TEST_CASE ("Auto eco follows the load with hysteresis", "[eco]")
+{
+    EcoMode eco;
+    eco.prepare (sampleRate);
+
+    SECTION ("a light load stays at full quality")
+    {
+        CHECK (runFor (eco, 0.4f, 10.0) == 0);
+    }
+
+    SECTION ("a heavy load goes up a tier at a time")
+    {
+        CHECK (eco.update (EcoMode::Setting::automatic, 0.8f, blockSize) == 1);
+
+        // the average has to catch up with the first step before there's another
+        CHECK (runFor (eco, 0.8f, EcoMode::settleSeconds * 0.5) == 1);
+        CHECK (runFor (eco, 0.8f, EcoMode::settleSeconds) == 2);
+        CHECK (runFor (eco, 0.8f, 10.0) == EcoMode::maxTier);
+    }
+
+    SECTION ("it comes back down once the load has stayed low")
+    {
+        runFor (eco, 0.8f, 10.0);
+
+        // between the thresholds nothing moves
+        CHECK (runFor (eco, 0.4f, 10.0) == EcoMode::maxTier);
+
+        CHECK (runFor (eco, 0.1f, EcoMode::holdSeconds * 0.9) == EcoMode::maxTier);
+        CHECK (runFor (eco, 0.1f, EcoMode::holdSeconds * 0.2) == EcoMode::maxTier - 1);
+    }
+
+    SECTION ("a load that bounces doesn't bring it down")
+    {
+        runFor (eco, 0.8f, 10.0);
+
+        for (int i = 0; i < 20; ++i)
+        {
+            runFor (eco, 0.1f, EcoMode::holdSeconds * 0.5);
+            runFor (eco, 0.4f, 0.1);
+        }
+
+        CHECK (eco.update (EcoMode::Setting::automatic, 0.1f, blockSize) == EcoMode::maxTier);
+    }
+
+    SECTION ("a fixed setting is where auto picks up from")
+    {
+        eco.update (EcoMode::Setting::tier2, 0.0f, blockSize);
+        CHECK (eco.update (EcoMode::Setting::automatic, 0.4f, blockSize) == 2);
+    }
+}
+
+TEST_CASE ("Eco tiers switch without clicks", "[eco]")
+{
+    // a low sine through the chorus only has a small second difference, a click would stand out
+    const auto interpolation = GENERATE (1, 3);
+    CAPTURE (interpolation);
+
+    Waylochorus2AudioProcessor plugin;
+    plugin.setNumVoices (16);
+    setParameter (plugin, ChorusParameters::interpolationId, (float) interpolation);
+    plugin.setRateAndBufferSizeDetails (sampleRate, blockSize);
+    plugin.prepareToPlay (sampleRate, blockSize);
+
+    juce::AudioBuffer<float> buffer (2, blockSize);
+    juce::MidiBuffer midi;
+
+    float previous[2] {}, beforePrevious[2] {};
+    float largestSecondDifference = 0.0f;
+    float largestSecondDifferenceAtFullQuality = 0.0f;
+    long long sample = 0;
+
+    // full quality, then every tier up and back down
+    const float settings[] = { 0.0f, 2.0f, 3.0f, 4.0f, 3.0f, 2.0f, 0.0f };
+
+    for (int step = 0; step < (int) std::size (settings); ++step)
+    {
+        setParameter (plugin, ChorusParameters::ecoId, settings[step]);
+
+        for (int block = 0; block < 40; ++block)
+        {
+            for (int i = 0; i < blockSize; ++i)
+            {
+                const auto input = 0.5f * (float) std::sin (juce::MathConstants<double>::twoPi * 200.0 * (double) (sample + i) / sampleRate);
+                buffer.setSample (0, i, input);
+                buffer.setSample (1, i, input);
+            }
+
+            plugin.processBlock (buffer, midi);
+            sample += blockSize;
+
+            if (block == 0)
+                CHECK (plugin.getEcoTier() == juce::jmax (0, (int) settings[step] - 1));
+
+            for (int channel = 0; channel < 2; ++channel)
+            {
+                for (int i = 0; i < blockSize; ++i)
+                {
+                    const auto value = buffer.getSample (channel, i);
+                    const auto secondDifference = std::abs (value - 2.0f * previous[channel] + beforePrevious[channel]);
+
+                    // the chorus takes a moment to fill before the first setting counts
+                    if (step == 0 && block >= 20)
+                        largestSecondDifferenceAtFullQuality = std::max (largestSecondDifferenceAtFullQuality, secondDifference);
+                    else if (step > 0)
+                        largestSecondDifference = std::max (largestSecondDifference, secondDifference);
+
+                    beforePrevious[channel] = previous[channel];
+                    previous[channel] = value;
+                }
+            }
+        }
+    }
+
+    CHECK (largestSecondDifferenceAtFullQuality > 0.0f);
+    CHECK (largestSecondDifference < 2.0f * largestSecondDifferenceAtFullQuality);
+}
+
+TEST_CASE ("The top eco tier halves the voices", "[eco]")
+{
+    // 16 and 17 voices both come down to 8, so once the rest have faded out they sound the same
+    Waylochorus2AudioProcessor sixteen, seventeen;
+    sixteen.setNumVoices (16);
+    seventeen.setNumVoices (17);
+
+    for (auto* plugin : { &sixteen, &seventeen })
+    {
+        setParameter (*plugin, ChorusParameters::ecoId, 4.0f);
+        plugin->setRateAndBufferSizeDetails (sampleRate, blockSize);
+        plugin->prepareToPlay (sampleRate, blockSize);
+    }
+
+    juce::AudioBuffer<float> sixteenBuffer (2, blockSize), seventeenBuffer (2, blockSize);
+    juce::MidiBuffer midi;
+    juce::Random random (47);
+
+    for (int block = 0; block < 40; ++block)
+    {
+        for (int channel = 0; channel < 2; ++channel)
+        {
+            for (int i = 0; i < blockSize; ++i)
+            {
+                const auto value = random.nextFloat() - 0.5f;
+                sixteenBuffer.setSample (channel, i, value);
+                seventeenBuffer.setSample (channel, i, value);
+            }
+        }
+
+        sixteen.processBlock (sixteenBuffer, midi);
+        seventeen.processBlock (seventeenBuffer, midi);
+    }
+
+    // the parameter stays where it was, only what's rendered changes
+    CHECK (sixteen.getNumVoices() == 16);
+    CHECK (sixteen.getEcoTier() == EcoMode::maxTier);
+    CHECK (sixteenBuffer.getMagnitude (0, 0, blockSize) > 1.0e-3f);
+
+    float difference = 0.0f;
+
+    for (int channel = 0; channel < 2; ++channel)
+        for (int i = 0; i < blockSize; ++i)
+            difference = std::max (difference, std::abs (sixteenBuffer.getSample (channel, i) - seventeenBuffer.getSample (channel, i)));
+
+    CHECK (difference < 1.0e-5f);
+}
+
+TEST_CASE ("Presets leave the eco setting alone", "[eco][state]")
+{
+    Waylochorus2AudioProcessor plugin;
+    setParameter (plugin, ChorusParameters::ecoId, 1.0f);
+
+    plugin.setCurrentProgram (3);
+    CHECK (getParameter (plugin, ChorusParameters::ecoId) == 1.0f);
+
+    // but a saved state brings back the one it was saved with
+    juce::MemoryBlock state;
+    plugin.getStateInformation (state);
+
+    Waylochorus2AudioProcessor restored;
+    restored.setStateInformation (state.getData(), (int) state.getSize());
+    CHECK (getParameter (restored, ChorusParameters::ecoId) == 1.0f);
+}
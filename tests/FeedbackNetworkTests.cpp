@@ -0,0 +1,180 @@
+#include "helpers/test_helpers.h"
+#include <PluginProcessor.h>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    // not a multiple of the sub-block size, so the vectorised kernels see a short chunk as well
+    constexpr int blockSize = 100;
+
+    // fills the input channels with noise for the first numNoiseBlocks blocks and silence after,
+    // and returns the peak of the first output channel over the last block
+    float process (Waylochorus2AudioProcessor& plugin, juce::AudioBuffer<float>& buffer, int numInputs, int numBlocks, int numNoiseBlocks)
+    {
+        juce::MidiBuffer midi;
+        juce::Random random (23);
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            buffer.clear();
+
+            if (block < numNoiseBlocks)
+                for (int channel = 0; channel < numInputs; ++channel)
+                    for (int i = 0; i < blockSize; ++i)
+                        buffer.setSample (channel, i, random.nextFloat() - 0.5f);
+
+            plugin.processBlock (buffer, midi);
+        }
+
+        return buffer.getMagnitude (0, 0, blockSize);
+    }
+}
+
+TEST_CASE ("Feedback network matrix", "[feedback]")
+{
+    using Network = FeedbackNetwork<float>;
+
+    // the columns are orthogonal, each with a squared length of numLines
+    for (int i = 0; i < Network::numLines; ++i)
+    {
+        for (int j = 0; j < Network::numLines; ++j)
+        {
+            float a[Network::numLines] = {}, b[Network::numLines] = {};
+            a[i] = 1.0f;
+            b[j] = 1.0f;
+
+            Network::hadamard (a);
+            Network::hadamard (b);
+
+            float dot = 0.0f;
+
+            for (int k = 0; k < Network::numLines; ++k)
+                dot += a[k] * b[k];
+
+            CHECK (dot == (i == j ? (float) Network::numLines : 0.0f));
+        }
+    }
+}
+
+TEST_CASE ("Feedback network kernels match", "[feedback]")
+{
+    const auto mode = GENERATE (0, 1, 2, 3);
+    const auto channelCounts = GENERATE (std::pair (1, 1), std::pair (1, 2), std::pair (2, 2));
+    CAPTURE (mode, channelCounts.first, channelCounts.second);
+
+    Waylochorus2AudioProcessor scalar, vectorised;
+    scalar.setKernel (Waylochorus2AudioProcessor::Kernel::scalar);
+
+    for (auto* plugin : { &scalar, &vectorised })
+    {
+        setParameter (*plugin, ChorusParameters::interpolationId, (float) mode);
+        setParameter (*plugin, ChorusParameters::feedbackNetworkId, 1.0f);
+        setParameter (*plugin, ChorusParameters::feedbackId, 0.8f);
+        setParameter (*plugin, ChorusParameters::numVoicesId, 13.0f);
+        REQUIRE (prepareWithChannels (*plugin, channelCounts.first, channelCounts.second, sampleRate, blockSize));
+    }
+
+    juce::AudioBuffer<float> scalarBuffer (channelCounts.second, blockSize), vectorisedBuffer (channelCounts.second, blockSize);
+    process (scalar, scalarBuffer, channelCounts.first, 100, 50);
+    process (vectorised, vectorisedBuffer, channelCounts.first, 100, 50);
+
+    CHECK (vectorisedBuffer.getMagnitude (0, 0, blockSize) > 1.0e-3f);
+
+    // half of it is the feedback ringing on after the input stopped
+    for (int channel = 0; channel < channelCounts.second; ++channel)
+        for (int i = 0; i < blockSize; ++i)
+            CHECK (std::abs (scalarBuffer.getSample (channel, i) - vectorisedBuffer.getSample (channel, i)) < 1.0e-4f);
+}
+
+TEST_CASE ("Feedback network with no feedback sounds like the plain chorus", "[feedback]")
+{
+    const auto kernel = GENERATE (Waylochorus2AudioProcessor::Kernel::scalar, Waylochorus2AudioProcessor::Kernel::vectorised);
+    const auto mode = GENERATE (0, 1, 3);
+    CAPTURE ((int) kernel, mode);
+
+    Waylochorus2AudioProcessor plain, network;
+
+    // set before preparing, so the feedback starts at zero rather than gliding there
+    setParameter (network, ChorusParameters::feedbackNetworkId, 1.0f);
+    setParameter (network, ChorusParameters::feedbackId, 0.0f);
+
+    for (auto* plugin : { &plain, &network })
+    {
+        plugin->setKernel (kernel);
+        setParameter (*plugin, ChorusParameters::interpolationId, (float) mode);
+        REQUIRE (prepareWithChannels (*plugin, 1, 2, sampleRate, blockSize));
+    }
+
+    juce::AudioBuffer<float> plainBuffer (2, blockSize), networkBuffer (2, blockSize);
+    process (plain, plainBuffer, 1, 30, 30);
+    process (network, networkBuffer, 1, 30, 30);
+
+    // every line holds the same input, and each voice reads it at the same delay as before
+    for (int channel = 0; channel < 2; ++channel)
+        for (int i = 0; i < blockSize; ++i)
+            CHECK (plainBuffer.getSample (channel, i) == networkBuffer.getSample (channel, i));
+}
+
+TEST_CASE ("Feedback network rings on and then dies away", "[feedback]")
+{
+    const auto numVoices = GENERATE (2, 32);
+    CAPTURE (numVoices);
+
+    Waylochorus2AudioProcessor plugin;
+    setParameter (plugin, ChorusParameters::feedbackNetworkId, 1.0f);
+    setParameter (plugin, ChorusParameters::feedbackId, ChorusParameters::maxFeedback);
+    setParameter (plugin, ChorusParameters::feedbackToneId, 20000.0f);
+    setParameter (plugin, ChorusParameters::numVoicesId, (float) numVoices);
+
+    for (int i = 0; i < ChorusVoiceTable::numSourceVoices; ++i)
+        setParameter (plugin, ChorusParameters::gainId + juce::String (i + 1), 1.0f);
+
+    REQUIRE (prepareWithChannels (plugin, 1, 2, sampleRate, blockSize));
+
+    juce::AudioBuffer<float> buffer (2, blockSize);
+    const auto blocksPerSecond = (int) (sampleRate / blockSize);
+
+    SECTION ("the tail is reported")
+    {
+        CHECK (plugin.getTailLengthSeconds() > 10.0);
+
+        setParameter (plugin, ChorusParameters::feedbackId, 0.5f);
+        CHECK (plugin.getTailLengthSeconds() < 3.0);
+    }
+
+    SECTION ("a burst keeps sounding after the input stops, without growing")
+    {
+        const auto duringBurst = process (plugin, buffer, 1, blocksPerSecond / 2, blocksPerSecond / 2);
+        // with fewer voices than lines, what goes to the lines nobody reads is lost, so it dies away quicker
+        const auto afterBurst = process (plugin, buffer, 1, blocksPerSecond / 10, 0);
+
+        CHECK (afterBurst > 1.0e-3f);
+        CHECK (afterBurst < duringBurst);
+        CHECK_FALSE (plugin.isIdle());
+
+        // well inside the tail it reports, the output has gone and the processor has stopped working
+        process (plugin, buffer, 1, (int) (plugin.getTailLengthSeconds() * blocksPerSecond), 0);
+        CHECK (plugin.isIdle());
+    }
+}
+
+TEST_CASE ("Switching the feedback network doesn't replay old audio", "[feedback]")
+{
+    Waylochorus2AudioProcessor plugin;
+    REQUIRE (prepareWithChannels (plugin, 1, 2, sampleRate, blockSize));
+
+    juce::AudioBuffer<float> buffer (2, blockSize);
+
+    // the plain lines fill up, then sit unused while the network runs on silence
+    process (plugin, buffer, 1, 20, 20);
+    setParameter (plugin, ChorusParameters::feedbackNetworkId, 1.0f);
+    process (plugin, buffer, 1, 1, 0);
+
+    // back on the plain lines, with silence coming in there's nothing to hear
+    setParameter (plugin, ChorusParameters::feedbackNetworkId, 0.0f);
+
+    for (int block = 0; block < 10; ++block)
+        CHECK (process (plugin, buffer, 1, 1, 0) == 0.0f);
+}
@@ -0,0 +1,159 @@
+#include "helpers/test_helpers.h"
+#include <PluginProcessor.h>
+#include <catch2/catch_template_test_macros.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    // not a multiple of any SIMD width, so the vectorised kernel's scalar tail runs too
+    constexpr int blockSize = 100;
+}
+
+TEMPLATE_TEST_CASE ("Interleaved delay lines sound the same as planar ones", "[layout]", float, double)
+{
+    const auto mode = GENERATE (0, 1, 2, 3);
+    const auto kernel = GENERATE (Waylochorus2AudioProcessor::Kernel::scalar, Waylochorus2AudioProcessor::Kernel::vectorised);
+    CAPTURE (mode, (int) kernel);
+
+    Waylochorus2AudioProcessor planar, interleaved;
+    planar.setDelayLineLayout (Waylochorus2AudioProcessor::DelayLineLayout::planar);
+    interleaved.setDelayLineLayout (Waylochorus2AudioProcessor::DelayLineLayout::interleaved);
+
+    for (auto* plugin : { &planar, &interleaved })
+    {
+        REQUIRE (plugin->setBusesLayout ({ { juce::AudioChannelSet::stereo() }, { juce::AudioChannelSet::stereo() } }));
+        plugin->setKernel (kernel);
+        plugin->setProcessingPrecision (std::is_same_v<TestType, double> ? juce::AudioProcessor::doublePrecision
+                                                                          : juce::AudioProcessor::singlePrecision);
+        setParameter (*plugin, ChorusParameters::interpolationId, (float) mode);
+        setParameter (*plugin, ChorusParameters::stereoModeId, (float) ChorusParameters::StereoMode::dual);
+        plugin->setRateAndBufferSizeDetails (sampleRate, blockSize);
+        plugin->prepareToPlay (sampleRate, blockSize);
+    }
+
+    juce::AudioBuffer<TestType> planarBuffer (2, blockSize), interleavedBuffer (2, blockSize);
+    juce::MidiBuffer midi;
+    juce::Random random (5);
+    TestType maxDifference = 0;
+
+    for (int block = 0; block < 100; ++block)
+    {
+        // a voice count change part way, so the gains ramp
+        if (block == 50)
+            for (auto* plugin : { &planar, &interleaved })
+                plugin->setNumVoices (11);
+
+        // different noise on each side, so a mixed up channel would show
+        for (int channel = 0; channel < 2; ++channel)
+        {
+            for (int i = 0; i < blockSize; ++i)
+            {
+                const auto sample = (TestType) (random.nextFloat() - 0.5f) * (channel == 0 ? 1 : -3);
+                planarBuffer.setSample (channel, i, sample);
+                interleavedBuffer.setSample (channel, i, sample);
+            }
+        }
+
+        planar.processBlock (planarBuffer, midi);
+        interleaved.processBlock (interleavedBuffer, midi);
+
+        for (int channel = 0; channel < 2; ++channel)
+            for (int i = 0; i < blockSize; ++i)
+                maxDifference = std::max (maxDifference, std::abs (planarBuffer.getSample (channel, i) - interleavedBuffer.getSample (channel, i)));
+    }
+
+    CHECK (interleavedBuffer.getMagnitude (0, 0, blockSize) > 0);
+    CHECK (interleavedBuffer.getMagnitude (1, 0, blockSize) > 0);
+
+    // the same arithmetic on the same samples, only stored differently
+    CHECK (maxDifference == 0);
+}
+
+TEST_CASE ("Interleaved dual stereo keeps the channels apart", "[layout]")
+{
+    const auto kernel = GENERATE (Waylochorus2AudioProcessor::Kernel::scalar, Waylochorus2AudioProcessor::Kernel::vectorised);
+
+    Waylochorus2AudioProcessor plugin;
+    plugin.setKernel (kernel);
+    REQUIRE (plugin.getDelayLineLayout() == Waylochorus2AudioProcessor::DelayLineLayout::interleaved);
+    REQUIRE (plugin.setBusesLayout ({ { juce::AudioChannelSet::stereo() }, { juce::AudioChannelSet::stereo() } }));
+    setParameter (plugin, ChorusParameters::stereoModeId, (float) ChorusParameters::StereoMode::dual);
+    plugin.setRateAndBufferSizeDetails (sampleRate, blockSize);
+    plugin.prepareToPlay (sampleRate, blockSize);
+
+    juce::AudioBuffer<float> buffer (2, blockSize);
+    juce::MidiBuffer midi;
+    juce::Random random (9);
+
+    for (int block = 0; block < 20; ++block)
+    {
+        buffer.clear();
+
+        for (int i = 0; i < blockSize; ++i)
+            buffer.setSample (1, i, random.nextFloat() - 0.5f);
+
+        plugin.processBlock (buffer, midi);
+
+        CHECK (buffer.getMagnitude (0, 0, blockSize) == 0.0f);
+    }
+
+    CHECK (buffer.getMagnitude (1, 0, blockSize) > 0.0f);
+}
+
+TEST_CASE ("Changing the delay line layout takes effect on the next prepareToPlay", "[layout]")
+{
+    // one plugin goes from planar to interleaved, the other is interleaved from the start
+    Waylochorus2AudioProcessor switched, fresh;
+    switched.setDelayLineLayout (Waylochorus2AudioProcessor::DelayLineLayout::planar);
+
+    for (auto* plugin : { &switched, &fresh })
+    {
+        REQUIRE (plugin->setBusesLayout ({ { juce::AudioChannelSet::stereo() }, { juce::AudioChannelSet::stereo() } }));
+        setParameter (*plugin, ChorusParameters::stereoModeId, (float) ChorusParameters::StereoMode::dual);
+        plugin->setRateAndBufferSizeDetails (sampleRate, blockSize);
+        plugin->prepareToPlay (sampleRate, blockSize);
+    }
+
+    juce::AudioBuffer<float> switchedBuffer (2, blockSize), freshBuffer (2, blockSize);
+    juce::MidiBuffer midi;
+    juce::Random random (13);
+
+    for (int i = 0; i < 10; ++i)
+    {
+        for (int channel = 0; channel < 2; ++channel)
+            for (int n = 0; n < blockSize; ++n)
+                switchedBuffer.setSample (channel, n, random.nextFloat() - 0.5f);
+
+        switched.processBlock (switchedBuffer, midi);
+    }
+
+    switched.setDelayLineLayout (Waylochorus2AudioProcessor::DelayLineLayout::interleaved);
+    switched.prepareToPlay (sampleRate, blockSize);
+
+    float maxDifference = 0.0f;
+
+    for (int block = 0; block < 20; ++block)
+    {
+        for (int channel = 0; channel < 2; ++channel)
+        {
+            for (int n = 0; n < blockSize; ++n)
+            {
+                const auto sample = (random.nextFloat() - 0.5f) * (channel == 0 ? 1.0f : -3.0f);
+                switchedBuffer.setSample (channel, n, sample);
+                freshBuffer.setSample (channel, n, sample);
+            }
+        }
+
+        switched.processBlock (switchedBuffer, midi);
+        fresh.processBlock (freshBuffer, midi);
+
+        for (int channel = 0; channel < 2; ++channel)
+            for (int n = 0; n < blockSize; ++n)
+                maxDifference = std::max (maxDifference, std::abs (switchedBuffer.getSample (channel, n) - freshBuffer.getSample (channel, n)));
+    }
+
+    CHECK (freshBuffer.getMagnitude (1, 0, blockSize) > 0.0f);
+    CHECK (maxDifference == 0.0f);
+}
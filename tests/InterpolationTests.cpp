@@ -0,0 +1,41 @@
+#include <Interpolation.h>
+#include <catch2/catch_approx.hpp>
+#include <catch2/catch_template_test_macros.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+TEMPLATE_TEST_CASE ("Interpolators reproduce a ramp", "[interpolation]", Interpolation::Linear, Interpolation::Hermite, Interpolation::Lagrange)
+{
+    // a straight line is the one signal every polynomial interpolator must get exactly right
+    constexpr int size = 16;
+    float buffer[size];
+
+    for (int i = 0; i < size; ++i)
+        buffer[i] = (float) i;
+
+    for (float position = 2.0f; position < 12.0f; position += 0.125f)
+    {
+        const auto index = (int) position;
+        float state = 0.0f;
+
+        CHECK (TestType::read (buffer, size - 1, index, position - (float) index, state) == Catch::Approx (position).margin (1.0e-5));
+    }
+}
+
+TEST_CASE ("Allpass interpolator settles to the right value", "[interpolation]")
+{
+    // on a constant signal the allpass has unity gain at DC, whatever the fraction
+    constexpr int size = 8;
+    float buffer[size];
+    std::fill (std::begin (buffer), std::end (buffer), 0.5f);
+
+    for (auto frac : { 0.0f, 0.25f, 0.5f, 0.75f, 0.99f })
+    {
+        float state = 0.0f;
+        float out = 0.0f;
+
+        for (int i = 0; i < 200; ++i)
+            out = Interpolation::Allpass::read (buffer, size - 1, 3, frac, state);
+
+        CHECK (out == Catch::Approx (0.5f).margin (1.0e-4));
+    }
+}
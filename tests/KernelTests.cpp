@@ -0,0 +1,76 @@
+#include "helpers/test_helpers.h"
+#include <PluginProcessor.h>
+#include <catch2/catch_template_test_macros.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+TEMPLATE_TEST_CASE ("Vectorised kernel matches the scalar reference", "[kernel]", float, double)
+{
+    constexpr double sampleRate = 44100.0;
+    // not a multiple of any SIMD width, so the tail of each chunk takes the scalar path
+    constexpr int blockSize = 100;
+
+    const auto mode = GENERATE (0, 1, 2, 3);
+    CAPTURE (mode);
+
+    // mono, mono to stereo and stereo each have their own kernels
+    const auto channelCounts = GENERATE (std::pair (1, 1), std::pair (1, 2), std::pair (2, 2));
+    const auto numInputs = channelCounts.first;
+    const auto numOutputs = channelCounts.second;
+    CAPTURE (numInputs, numOutputs);
+
+    // a stereo input is either summed into the mono to stereo kernels or given a line per channel
+    const auto stereoMode = numInputs == 2 ? GENERATE (0, 1) : 0;
+    CAPTURE (stereoMode);
+
+    Waylochorus2AudioProcessor scalar, vectorised;
+    scalar.setKernel (Waylochorus2AudioProcessor::Kernel::scalar);
+    vectorised.setKernel (Waylochorus2AudioProcessor::Kernel::vectorised);
+
+    const auto channels = [] (int numChannels) { return numChannels == 1 ? juce::AudioChannelSet::mono() : juce::AudioChannelSet::stereo(); };
+
+    for (auto* plugin : { &scalar, &vectorised })
+    {
+        REQUIRE (plugin->setBusesLayout ({ { channels (numInputs) }, { channels (numOutputs) } }));
+        plugin->setProcessingPrecision (std::is_same_v<TestType, double> ? juce::AudioProcessor::doublePrecision
+                                                                          : juce::AudioProcessor::singlePrecision);
+        setParameter (*plugin, ChorusParameters::interpolationId, (float) mode);
+        setParameter (*plugin, ChorusParameters::stereoModeId, (float) stereoMode);
+        plugin->setRateAndBufferSizeDetails (sampleRate, blockSize);
+        plugin->prepareToPlay (sampleRate, blockSize);
+    }
+
+    juce::AudioBuffer<TestType> scalarBuffer (numOutputs, blockSize), vectorisedBuffer (numOutputs, blockSize);
+    juce::MidiBuffer midi;
+    juce::Random random (42);
+    float maxDifference = 0.0f;
+
+    for (int block = 0; block < 200; ++block)
+    {
+        // change the voice count now and then, so the gains and delays are ramping
+        if (block % 50 == 25)
+            for (auto* plugin : { &scalar, &vectorised })
+                plugin->setNumVoices (block < 100 ? 13 : 32);
+
+        for (int channel = 0; channel < numOutputs; ++channel)
+        {
+            for (int i = 0; i < blockSize; ++i)
+            {
+                const auto sample = (TestType) (random.nextFloat() * 2.0f - 1.0f);
+
+                scalarBuffer.setSample (channel, i, sample);
+                vectorisedBuffer.setSample (channel, i, sample);
+            }
+        }
+
+        scalar.processBlock (scalarBuffer, midi);
+        vectorised.processBlock (vectorisedBuffer, midi);
+
+        for (int channel = 0; channel < numOutputs; ++channel)
+            for (int i = 0; i < blockSize; ++i)
+                maxDifference = std::max (maxDifference, (float) std::abs (scalarBuffer.getSample (channel, i) - vectorisedBuffer.getSample (channel, i)));
+    }
+
+    // the scalar kernel builds its gain ramps by repeated addition, so allow for its rounding
+    CHECK (maxDifference < 1.0e-4f);
+}
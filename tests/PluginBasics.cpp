@@ -10,12 +10,23 @@ TEST_CASE ("one is equal to one", "[dummy]")
 
 TEST_CASE ("Plugin instance", "[instance]")
 {
-    PluginProcessor testPlugin;
+    Waylochorus2AudioProcessor testPlugin;
 
     SECTION ("name")
     {
         CHECK_THAT (testPlugin.getName().toStdString(),
-            Catch::Matchers::Equals ("Pamplejuce Demo"));
+            Catch::Matchers::Equals ("WayloChorus"));
+    }
+
+    SECTION ("voice count goes through the parameter")
+    {
+        CHECK (testPlugin.getNumVoices() == 4);
+
+        testPlugin.setNumVoices (12);
+        CHECK (testPlugin.getNumVoices() == 12);
+
+        testPlugin.setNumVoices (100);
+        CHECK (testPlugin.getNumVoices() == 32);
     }
 }
 
@@ -0,0 +1,321 @@
+#include "helpers/realtime_guard.h"
+#include "helpers/test_helpers.h"
+#include <PluginProcessor.h>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+#include <mutex>
+#include <thread>
+
+/* Everything here runs processBlock under RealtimeGuard, which fails on any
+ * allocation, lock or blocking call made on the audio thread. Parameter and
+ * state changes happen between blocks, outside the guard, the way a host
+ * makes them; what's being checked is that the processor picks them up
+ * without doing anything it shouldn't.
+ */
+namespace
+{
+    void fillWithNoise (juce::AudioBuffer<float>& buffer, juce::Random& random)
+    {
+        for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+            for (int i = 0; i < buffer.getNumSamples(); ++i)
+                buffer.setSample (channel, i, random.nextFloat() * 2.0f - 1.0f);
+    }
+
+    // calls beforeEachBlock (unguarded), then processBlock (guarded), and adds up what the guard saw
+    template <typename BeforeEachBlock>
+    RealtimeGuard::Violations processGuarded (Waylochorus2AudioProcessor& plugin, int numBlocks, int blockSize, BeforeEachBlock&& beforeEachBlock)
+    {
+        juce::AudioBuffer<float> buffer (2, blockSize);
+        juce::MidiBuffer midi;
+        juce::Random random (7);
+        RealtimeGuard::Violations total;
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            beforeEachBlock (block);
+            fillWithNoise (buffer, random);
+
+            total += RealtimeGuard::check ([&] { plugin.processBlock (buffer, midi); });
+        }
+
+        return total;
+    }
+
+    RealtimeGuard::Violations processGuarded (Waylochorus2AudioProcessor& plugin, int numBlocks, int blockSize)
+    {
+        return processGuarded (plugin, numBlocks, blockSize, [] (int) {});
+    }
+}
+
+TEST_CASE ("Real-time guard catches what it should", "[realtime]")
+{
+    SECTION ("nothing, when there's nothing to catch")
+    {
+        float sum = 0.0f;
+        const auto violations = RealtimeGuard::check ([&] {
+            for (int i = 0; i < 1000; ++i)
+                sum += (float) i;
+        });
+
+        INFO (violations.describe());
+        CHECK (violations.isClean());
+    }
+
+    SECTION ("new and delete")
+    {
+        const auto violations = RealtimeGuard::check ([] {
+            delete new volatile int (1);
+        });
+
+        CHECK (violations.allocations == 1);
+        CHECK (violations.deallocations == 1);
+    }
+
+    SECTION ("a container growing")
+    {
+        std::vector<float> values;
+        const auto violations = RealtimeGuard::check ([&] { values.resize (256); });
+
+        CHECK (violations.allocations > 0);
+    }
+
+   #if defined(__GLIBC__)
+    SECTION ("malloc and free")
+    {
+        const auto violations = RealtimeGuard::check ([] {
+            auto* volatile pointer = std::malloc (64);
+            std::free (pointer);
+        });
+
+        CHECK (violations.allocations == 1);
+        CHECK (violations.deallocations == 1);
+    }
+
+    SECTION ("locks")
+    {
+        std::mutex mutex;
+        juce::CriticalSection criticalSection;
+
+        const auto violations = RealtimeGuard::check ([&] {
+            { std::lock_guard<std::mutex> lock (mutex); }
+            { const juce::ScopedLock lock (criticalSection); }
+        });
+
+        CHECK (violations.locks == 2);
+        CHECK (violations.allocations == 0);
+    }
+   #endif
+
+   #if defined(__linux__)
+    SECTION ("sleeping")
+    {
+        const auto violations = RealtimeGuard::check ([] { std::this_thread::sleep_for (std::chrono::milliseconds (1)); });
+
+        CHECK (violations.contextSwitches > 0);
+
+        if (RealtimeGuard::canCountSyscalls())
+            CHECK (violations.syscalls > 0);
+    }
+   #endif
+}
+
+TEST_CASE ("processBlock is real-time safe", "[realtime]")
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 128;
+
+    const auto mode = GENERATE (0, 1, 2, 3);
+    const auto kernel = GENERATE (Waylochorus2AudioProcessor::Kernel::scalar, Waylochorus2AudioProcessor::Kernel::vectorised);
+    CAPTURE (mode, (int) kernel);
+
+    Waylochorus2AudioProcessor plugin;
+    plugin.setKernel (kernel);
+    setParameter (plugin, ChorusParameters::interpolationId, (float) mode);
+
+    SECTION ("before prepareToPlay")
+    {
+        const auto violations = processGuarded (plugin, 4, blockSize);
+
+        INFO (violations.describe());
+        CHECK (violations.isClean());
+    }
+
+    plugin.setRateAndBufferSizeDetails (sampleRate, blockSize);
+    plugin.prepareToPlay (sampleRate, blockSize);
+
+    SECTION ("from the very first block")
+    {
+        const auto violations = processGuarded (plugin, 200, blockSize);
+
+        INFO (violations.describe());
+        CHECK (violations.isClean());
+    }
+
+    SECTION ("with blocks bigger than promised")
+    {
+        // some hosts do this, the processor splits them up rather than reallocating
+        const auto violations = processGuarded (plugin, 20, blockSize * 5 + 3);
+
+        INFO (violations.describe());
+        CHECK (violations.isClean());
+    }
+
+    SECTION ("with odd and empty blocks")
+    {
+        for (auto size : { 0, 1, 17, blockSize - 1 })
+        {
+            CAPTURE (size);
+            const auto violations = processGuarded (plugin, 20, size);
+
+            INFO (violations.describe());
+            CHECK (violations.isClean());
+        }
+    }
+}
+
+TEST_CASE ("prepareToPlay then process is real-time safe", "[realtime]")
+{
+    Waylochorus2AudioProcessor plugin;
+
+    // growing, shrinking and coming back, the way a host reconfigures
+    const std::pair<double, int> configurations[] = { { 44100.0, 64 }, { 192000.0, 2048 }, { 48000.0, 32 }, { 96000.0, 512 }, { 44100.0, 64 } };
+
+    for (const auto& [sampleRate, blockSize] : configurations)
+    {
+        CAPTURE (sampleRate, blockSize);
+
+        plugin.releaseResources();
+        plugin.setRateAndBufferSizeDetails (sampleRate, blockSize);
+        plugin.prepareToPlay (sampleRate, blockSize);
+
+        const auto violations = processGuarded (plugin, 50, blockSize);
+
+        INFO (violations.describe());
+        CHECK (violations.isClean());
+    }
+}
+
+TEST_CASE ("Parameter changes are picked up in real time", "[realtime]")
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 64;
+
+    Waylochorus2AudioProcessor plugin;
+    plugin.setRateAndBufferSizeDetails (sampleRate, blockSize);
+    plugin.prepareToPlay (sampleRate, blockSize);
+
+    SECTION ("every parameter, every block")
+    {
+        const auto& parameters = plugin.getParameters();
+        juce::Random random (3);
+
+        const auto violations = processGuarded (plugin, 500, blockSize, [&] (int) {
+            for (auto* parameter : parameters)
+                parameter->setValueNotifyingHost (random.nextFloat());
+        });
+
+        INFO (violations.describe());
+        CHECK (violations.isClean());
+    }
+
+    SECTION ("voice count through its whole range")
+    {
+        const auto violations = processGuarded (plugin, 200, blockSize, [&] (int block) {
+            plugin.setNumVoices (2 + (block * 7) % 31);
+        });
+
+        INFO (violations.describe());
+        CHECK (violations.isClean());
+    }
+
+    SECTION ("interpolation and LFO shape switches")
+    {
+        const auto violations = processGuarded (plugin, 200, blockSize, [&] (int block) {
+            setParameter (plugin, ChorusParameters::interpolationId, (float) (block % 4));
+            setParameter (plugin, ChorusParameters::lfoShapeId, (float) (block / 4 % 3));
+        });
+
+        INFO (violations.describe());
+        CHECK (violations.isClean());
+    }
+
+    SECTION ("eco tiers, with the voice count moving under them")
+    {
+        const auto violations = processGuarded (plugin, 200, blockSize, [&] (int block) {
+            setParameter (plugin, ChorusParameters::ecoId, (float) (block / 3 % 5));
+            plugin.setNumVoices (2 + (block * 5) % 31);
+        });
+
+        INFO (violations.describe());
+        CHECK (violations.isClean());
+    }
+}
+
+TEST_CASE ("State changes are picked up in real time", "[realtime]")
+{
+    constexpr double sampleRate = 44100.0;
+    constexpr int blockSize = 256;
+
+    Waylochorus2AudioProcessor plugin, other;
+    other.setNumVoices (24);
+    setParameter (other, ChorusParameters::interpolationId, 3.0f);
+
+    juce::MemoryBlock pluginState, otherState;
+    plugin.getStateInformation (pluginState);
+    other.getStateInformation (otherState);
+
+    plugin.setRateAndBufferSizeDetails (sampleRate, blockSize);
+    plugin.prepareToPlay (sampleRate, blockSize);
+
+    // flip between two states, as a host does when recalling a session or a preset
+    const auto violations = processGuarded (plugin, 100, blockSize, [&] (int block) {
+        if (block % 10 == 0)
+        {
+            const auto& state = block % 20 == 0 ? otherState : pluginState;
+            plugin.setStateInformation (state.getData(), (int) state.getSize());
+        }
+    });
+
+    INFO (violations.describe());
+    CHECK (violations.isClean());
+}
+
+TEST_CASE ("Program changes are picked up in real time", "[realtime]")
+{
+    constexpr double sampleRate = 44100.0;
+    constexpr int blockSize = 256;
+
+    Waylochorus2AudioProcessor plugin;
+    plugin.setRateAndBufferSizeDetails (sampleRate, blockSize);
+    plugin.prepareToPlay (sampleRate, blockSize);
+
+    // every few blocks, and sometimes again before the last switch has faded back in
+    const auto violations = processGuarded (plugin, 200, blockSize, [&] (int block) {
+        if (block % 7 == 0 || block % 13 == 0)
+            plugin.setCurrentProgram (block % plugin.getNumPrograms());
+    });
+
+    INFO (violations.describe());
+    CHECK (violations.isClean());
+}
+
+TEST_CASE ("Rendering voices on worker threads is real-time safe", "[realtime]")
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 128;
+
+    Waylochorus2AudioProcessor plugin;
+    plugin.setNumWorkerThreads (VoiceWorkerPool::maxWorkers);
+    plugin.setNumVoices (32);
+    plugin.setRateAndBufferSizeDetails (sampleRate, blockSize);
+    plugin.prepareToPlay (sampleRate, blockSize);
+
+    const auto violations = processGuarded (plugin, 200, blockSize);
+
+    // waking a sleeping worker is a futex call, and a caller waiting on a held up worker
+    // yields its core, so system calls and context switches are part of the design here
+    INFO (violations.describe());
+    CHECK (violations.allocations == 0);
+    CHECK (violations.deallocations == 0);
+    CHECK (violations.locks == 0);
+}
@@ -0,0 +1,161 @@
+#include "helpers/realtime_guard.h"
+#include "helpers/test_helpers.h"
+#include <PluginProcessor.h>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+namespace
+{
+    void fill (juce::AudioBuffer<float>& buffer, juce::Random& random, bool silent)
+    {
+        for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+            for (int i = 0; i < buffer.getNumSamples(); ++i)
+                buffer.setSample (channel, i, silent ? 0.0f : random.nextFloat() - 0.5f);
+    }
+
+    float peak (const juce::AudioBuffer<float>& buffer)
+    {
+        float result = 0.0f;
+
+        for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+            for (int i = 0; i < buffer.getNumSamples(); ++i)
+                result = std::max (result, std::abs (buffer.getSample (channel, i)));
+
+        return result;
+    }
+}
+
+TEST_CASE ("Tail length is the longest delay", "[bypass]")
+{
+    Waylochorus2AudioProcessor plugin;
+    CHECK (plugin.getTailLengthSeconds() == ChorusVoiceTable::maxDelayMs / 1000.0);
+}
+
+TEST_CASE ("Silence bypass", "[bypass]")
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 128;
+    const auto tailBlocks = (int) std::ceil (ChorusVoiceTable::maxDelayMs / 1000.0 * sampleRate / blockSize);
+
+    Waylochorus2AudioProcessor plugin;
+    plugin.setRateAndBufferSizeDetails (sampleRate, blockSize);
+    plugin.prepareToPlay (sampleRate, blockSize);
+
+    juce::AudioBuffer<float> buffer (2, blockSize);
+    juce::MidiBuffer midi;
+    juce::Random random (5);
+
+    for (int block = 0; block < 100; ++block)
+    {
+        fill (buffer, random, false);
+        plugin.processBlock (buffer, midi);
+    }
+
+    CHECK_FALSE (plugin.isIdle());
+
+    SECTION ("waits for the tail, then goes idle")
+    {
+        // the delay lines are still playing out, so the processing carries on
+        float tailPeak = 0.0f;
+
+        for (int block = 0; block < tailBlocks; ++block)
+        {
+            fill (buffer, random, true);
+            plugin.processBlock (buffer, midi);
+            tailPeak = std::max (tailPeak, peak (buffer));
+            CHECK_FALSE (plugin.isIdle());
+        }
+
+        CHECK (tailPeak > 0.01f);
+
+        // silence in front of every voice now
+        fill (buffer, random, true);
+        plugin.processBlock (buffer, midi);
+        CHECK (plugin.isIdle());
+        CHECK (peak (buffer) == 0.0f);
+
+        // and idling is real-time safe
+        const auto violations = RealtimeGuard::check ([&] { plugin.processBlock (buffer, midi); });
+        INFO (violations.describe());
+        CHECK (violations.isClean());
+    }
+
+    SECTION ("noise below the threshold counts as silence, anything above it doesn't")
+    {
+        for (int block = 0; block <= tailBlocks; ++block)
+        {
+            buffer.clear();
+            buffer.setSample (0, block % blockSize, 0.5f * Waylochorus2AudioProcessor::silenceThreshold);
+            plugin.processBlock (buffer, midi);
+        }
+
+        CHECK (plugin.isIdle());
+
+        buffer.clear();
+        buffer.setSample (1, 7, 2.0f * Waylochorus2AudioProcessor::silenceThreshold);
+        plugin.processBlock (buffer, midi);
+        CHECK_FALSE (plugin.isIdle());
+    }
+}
+
+TEST_CASE ("Silence bypass is seamless", "[bypass]")
+{
+    // a plugin that idles through a gap should come back sounding the same as one that processed it
+    constexpr double sampleRate = 44100.0;
+    constexpr int blockSize = 100;
+
+    const auto mode = GENERATE (0, 1, 2, 3);
+    const auto shape = GENERATE (0, 1, 2);
+    const auto changeShapeOnReturn = GENERATE (false, true);
+    CAPTURE (mode, shape, changeShapeOnReturn);
+
+    Waylochorus2AudioProcessor bypassing, processing;
+    processing.setSilenceBypassEnabled (false);
+
+    for (auto* plugin : { &bypassing, &processing })
+    {
+        setParameter (*plugin, ChorusParameters::interpolationId, (float) mode);
+        setParameter (*plugin, ChorusParameters::lfoShapeId, (float) shape);
+        plugin->setRateAndBufferSizeDetails (sampleRate, blockSize);
+        plugin->prepareToPlay (sampleRate, blockSize);
+    }
+
+    juce::AudioBuffer<float> bypassingBuffer (2, blockSize), processingBuffer (2, blockSize);
+    juce::MidiBuffer midi;
+    juce::Random random (11);
+    float maxDifference = 0.0f;
+    bool wentIdle = false;
+
+    // noise, a second and a half of silence with a parameter change in it, then noise again
+    for (int block = 0; block < 1200; ++block)
+    {
+        const auto silent = block >= 200 && block < 860;
+
+        for (auto* plugin : { &bypassing, &processing })
+        {
+            if (block == 500)
+                plugin->setNumVoices (9);
+
+            if (block == 860 && changeShapeOnReturn)
+                setParameter (*plugin, ChorusParameters::lfoShapeId, (float) ((shape + 1) % 3));
+        }
+
+        fill (bypassingBuffer, random, silent);
+        processingBuffer.makeCopyOf (bypassingBuffer, true);
+
+        bypassing.processBlock (bypassingBuffer, midi);
+        processing.processBlock (processingBuffer, midi);
+        wentIdle = wentIdle || bypassing.isIdle();
+
+        for (int channel = 0; channel < 2; ++channel)
+            for (int i = 0; i < blockSize; ++i)
+                maxDifference = std::max (maxDifference, std::abs (bypassingBuffer.getSample (channel, i) - processingBuffer.getSample (channel, i)));
+    }
+
+    CHECK (wentIdle);
+    CHECK_FALSE (bypassing.isIdle());
+
+    // the idle plugin keeps its delay lines, glides and LFOs in step, so this is only rounding. A shape
+    // glide starts from the exact LFO value rather than the sine oscillator's, which is within 1e-5 of it
+    CHECK (maxDifference < (changeShapeOnReturn ? 2.0e-3f : 1.0e-5f));
+}
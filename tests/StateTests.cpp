@@ -0,0 +1,298 @@
+#include "helpers/test_helpers.h"
+#include <PluginProcessor.h>
+#include <catch2/catch_approx.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+
+    std::vector<float> getAllValues (Waylochorus2AudioProcessor& plugin)
+    {
+        std::vector<float> values;
+
+        for (auto* parameter : plugin.getParameters())
+            values.push_back (parameter->getValue());
+
+        return values;
+    }
+
+    void appendUint32 (juce::MemoryBlock& block, std::uint32_t value)
+    {
+        char bytes[4];
+        for (int i = 0; i < 4; ++i)
+            bytes[i] = (char) (value >> (8 * i));
+
+        block.append (bytes, 4);
+    }
+
+    void appendFloat (juce::MemoryBlock& block, float value)
+    {
+        std::uint32_t bits;
+        std::memcpy (&bits, &value, sizeof (bits));
+        appendUint32 (block, bits);
+    }
+
+    // a state header: magic, version and program, then the number of values
+    juce::MemoryBlock makeHeader (std::uint16_t version, std::uint16_t program, std::uint32_t numValues)
+    {
+        juce::MemoryBlock block;
+        appendUint32 (block, ChorusParameters::stateMagic);
+        appendUint32 (block, (std::uint32_t) version | ((std::uint32_t) program << 16));
+        appendUint32 (block, numValues);
+        return block;
+    }
+}
+
+TEST_CASE ("State round trips", "[state]")
+{
+    Waylochorus2AudioProcessor plugin;
+    plugin.setCurrentProgram (2);
+    plugin.setNumVoices (24);
+    setParameter (plugin, ChorusParameters::interpolationId, 3.0f);
+    setParameter (plugin, ChorusParameters::bbdId, 1.0f);
+    setParameter (plugin, ChorusParameters::feedbackId, 0.3f);
+    setParameter (plugin, "delay2", 41.0f);
+    setParameter (plugin, "pan3", -0.5f);
+
+    juce::MemoryBlock state;
+    plugin.getStateInformation (state);
+
+    // a fixed size header and eight bytes a parameter
+    CHECK ((int) state.getSize() == ChorusParameters::stateHeaderSize + (int) plugin.getParameters().size() * ChorusParameters::stateValueSize);
+
+    Waylochorus2AudioProcessor restored;
+    restored.setStateInformation (state.getData(), (int) state.getSize());
+
+    CHECK (getAllValues (restored) == getAllValues (plugin));
+    CHECK (restored.getCurrentProgram() == 2);
+    CHECK (restored.getNumVoices() == 24);
+    CHECK (getParameter (restored, "delay2") == Catch::Approx (41.0f));
+}
+
+TEST_CASE ("Unreadable states change nothing", "[state]")
+{
+    Waylochorus2AudioProcessor plugin;
+    plugin.setNumVoices (9);
+    const auto before = getAllValues (plugin);
+
+    juce::MemoryBlock valid;
+    plugin.getStateInformation (valid);
+
+    SECTION ("empty")
+    {
+        plugin.setStateInformation (nullptr, 0);
+    }
+
+    SECTION ("something else's state")
+    {
+        const char text[] = "<PARAMETERS voices=\"4\"/>";
+        plugin.setStateInformation (text, (int) sizeof (text));
+    }
+
+    SECTION ("a newer version")
+    {
+        auto block = makeHeader (ChorusParameters::stateVersion + 1, 0, 0);
+        plugin.setStateInformation (block.getData(), (int) block.getSize());
+    }
+
+    SECTION ("cut short")
+    {
+        plugin.setStateInformation (valid.getData(), (int) valid.getSize() - 1);
+    }
+
+    CHECK (getAllValues (plugin) == before);
+}
+
+TEST_CASE ("A state sets what it holds and defaults the rest", "[state]")
+{
+    Waylochorus2AudioProcessor plugin;
+    setParameter (plugin, ChorusParameters::bbdId, 1.0f);
+
+    // the voice count, and a parameter from some other build
+    auto block = makeHeader (ChorusParameters::stateVersion, 0, 2);
+    appendUint32 (block, ChorusParameters::hashId (ChorusParameters::numVoicesId));
+    appendFloat (block, 7.0f);
+    appendUint32 (block, ChorusParameters::hashId ("notAParameter"));
+    appendFloat (block, 0.25f);
+
+    plugin.setStateInformation (block.getData(), (int) block.getSize());
+
+    CHECK (plugin.getNumVoices() == 7);
+    CHECK (getParameter (plugin, ChorusParameters::bbdId) == 0.0f);
+}
+
+TEST_CASE ("A state's non-finite values are left out", "[state]")
+{
+    Waylochorus2AudioProcessor reference, plugin;
+
+    // a corrupt value for each kind of parameter, and one good one to show the rest was read
+    const float corrupt[] = { std::numeric_limits<float>::quiet_NaN(), std::numeric_limits<float>::infinity(),
+                              -std::numeric_limits<float>::infinity(), std::numeric_limits<float>::quiet_NaN() };
+    const juce::String ids[] = { juce::String (ChorusParameters::rateId) + "1", juce::String (ChorusParameters::gainId) + "1",
+                                 juce::String (ChorusParameters::delayId) + "1", ChorusParameters::feedbackId };
+
+    auto state = makeHeader (ChorusParameters::stateVersion, 0, 5);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        appendUint32 (state, ChorusParameters::hashId (ids[i].toRawUTF8()));
+        appendFloat (state, corrupt[i]);
+    }
+
+    appendUint32 (state, ChorusParameters::hashId (ChorusParameters::numVoicesId));
+    appendFloat (state, 7.0f);
+
+    plugin.setStateInformation (state.getData(), (int) state.getSize());
+
+    CHECK (plugin.getNumVoices() == 7);
+
+    // each is treated as missing, so it's back at its default
+    for (const auto& id : ids)
+    {
+        CAPTURE (id);
+        CHECK (std::isfinite (getParameter (plugin, id)));
+        CHECK (getParameter (plugin, id) == getParameter (reference, id));
+    }
+
+    plugin.setRateAndBufferSizeDetails (sampleRate, 256);
+    plugin.prepareToPlay (sampleRate, 256);
+
+    juce::AudioBuffer<float> buffer (2, 256);
+    juce::MidiBuffer midi;
+    bool allFinite = true;
+
+    for (int block = 0; block < 10; ++block)
+    {
+        for (int channel = 0; channel < 2; ++channel)
+            for (int i = 0; i < 256; ++i)
+                buffer.setSample (channel, i, 0.5f * (float) std::sin (0.05 * (block * 256 + i)));
+
+        plugin.processBlock (buffer, midi);
+
+        for (int channel = 0; channel < 2; ++channel)
+            for (int i = 0; i < 256; ++i)
+                allFinite = allFinite && std::isfinite (buffer.getSample (channel, i));
+    }
+
+    CHECK (buffer.getMagnitude (0, 0, 256) > 0.0f);
+    CHECK (allFinite);
+}
+
+TEST_CASE ("Presets are programs", "[state]")
+{
+    Waylochorus2AudioProcessor plugin;
+    REQUIRE (plugin.getNumPrograms() == ChorusPresets::numPresets);
+    REQUIRE (plugin.getNumPrograms() > 1);
+
+    for (int program = 0; program < plugin.getNumPrograms(); ++program)
+    {
+        CAPTURE (program);
+        CHECK (plugin.getProgramName (program).isNotEmpty());
+
+        // every value names a parameter, and is in its range
+        for (const auto& value : ChorusPresets::presets[program].values)
+        {
+            if (value.id == nullptr)
+                break;
+
+            CAPTURE (value.id);
+            auto* parameter = plugin.getValueTreeState().getParameter (value.id);
+            REQUIRE (parameter != nullptr);
+            CHECK (parameter->convertFrom0to1 (parameter->convertTo0to1 (value.value)) == Catch::Approx (value.value));
+        }
+    }
+
+    SECTION ("a program sets its values and defaults the rest")
+    {
+        setParameter (plugin, ChorusParameters::bbdId, 1.0f);
+        plugin.setCurrentProgram (3);
+
+        CHECK (plugin.getCurrentProgram() == 3);
+        CHECK (getParameter (plugin, ChorusParameters::feedbackNetworkId) == 1.0f);
+        CHECK (plugin.getNumVoices() == 8);
+        CHECK (getParameter (plugin, ChorusParameters::bbdId) == 0.0f);
+
+        plugin.setCurrentProgram (0);
+        Waylochorus2AudioProcessor defaults;
+        CHECK (getAllValues (plugin) == getAllValues (defaults));
+    }
+
+    SECTION ("out of range programs are ignored")
+    {
+        plugin.setCurrentProgram (1);
+        plugin.setCurrentProgram (plugin.getNumPrograms());
+        plugin.setCurrentProgram (-1);
+
+        CHECK (plugin.getCurrentProgram() == 1);
+    }
+}
+
+TEST_CASE ("Program changes fade across the switch", "[state]")
+{
+    constexpr auto blockSize = Waylochorus2AudioProcessor::subBlockSize;
+    const auto fadeSamples = (int) (Waylochorus2AudioProcessor::presetFadeSeconds * sampleRate);
+
+    Waylochorus2AudioProcessor switched, unchanged;
+
+    for (auto* plugin : { &switched, &unchanged })
+    {
+        plugin->setRateAndBufferSizeDetails (sampleRate, blockSize);
+        plugin->prepareToPlay (sampleRate, blockSize);
+    }
+
+    juce::AudioBuffer<float> switchedBuffer (2, blockSize), unchangedBuffer (2, blockSize);
+    juce::MidiBuffer midi;
+    juce::Random random (37);
+
+    const auto processBoth = [&]
+    {
+        for (int channel = 0; channel < 2; ++channel)
+        {
+            for (int i = 0; i < blockSize; ++i)
+            {
+                const auto sample = random.nextFloat() - 0.5f;
+                switchedBuffer.setSample (channel, i, sample);
+                unchangedBuffer.setSample (channel, i, sample);
+            }
+        }
+
+        switched.processBlock (switchedBuffer, midi);
+        unchanged.processBlock (unchangedBuffer, midi);
+    };
+
+    for (int block = 0; block < 20; ++block)
+        processBoth();
+
+    switched.setCurrentProgram (3);
+
+    // the old settings carry on playing while they fade out
+    int position = 0;
+
+    for (; position + blockSize <= fadeSamples; position += blockSize)
+    {
+        processBoth();
+
+        for (int channel = 0; channel < 2; ++channel)
+        {
+            for (int i = 0; i < blockSize; ++i)
+            {
+                const auto gain = 1.0f - (float) (position + i) / (float) fadeSamples;
+                CHECK (switchedBuffer.getSample (channel, i) == Catch::Approx (gain * unchangedBuffer.getSample (channel, i)).margin (1.0e-6));
+            }
+        }
+    }
+
+    // then the new ones fade in, and are what's heard after that
+    for (int block = 0; block < 20; ++block)
+        processBoth();
+
+    CHECK (switchedBuffer.getMagnitude (0, 0, blockSize) > 1.0e-3f);
+
+    float difference = 0.0f;
+
+    for (int i = 0; i < blockSize; ++i)
+        difference = std::max (difference, std::abs (switchedBuffer.getSample (0, i) - unchangedBuffer.getSample (0, i)));
+
+    CHECK (difference > 1.0e-3f);
+}
@@ -0,0 +1,122 @@
+#include "helpers/realtime_guard.h"
+#include <TraceRecorder.h>
+#include <catch2/catch_test_macros.hpp>
+#include <thread>
+
+namespace
+{
+    TraceRecorder::Event makeEvent (const char* name, juce::int64 start, int numSamples = 0)
+    {
+        TraceRecorder::Event event;
+        event.name = name;
+        event.startTicks = start;
+        event.endTicks = start + 10;
+        event.threadId = 1;
+        event.numSamples = numSamples;
+        return event;
+    }
+}
+
+TEST_CASE ("Trace recorder", "[trace]")
+{
+    // big, and only ever allocated by the test, so keep it off the stack
+    auto recorder = std::make_unique<TraceRecorder>();
+    std::vector<TraceRecorder::Event> events;
+
+    SECTION ("drains what was recorded, in order")
+    {
+        for (int i = 0; i < 100; ++i)
+            CHECK (recorder->record (makeEvent ("block", i * 100, i)));
+
+        recorder->drain (events);
+        REQUIRE (events.size() == 100);
+
+        for (int i = 0; i < 100; ++i)
+            CHECK (events[(size_t) i].numSamples == i);
+
+        events.clear();
+        recorder->drain (events);
+        CHECK (events.empty());
+    }
+
+    SECTION ("drops and counts when full, and recovers once drained")
+    {
+        for (size_t i = 0; i < TraceRecorder::capacity; ++i)
+            recorder->record (makeEvent ("block", (juce::int64) i));
+
+        CHECK_FALSE (recorder->record (makeEvent ("lost", 0)));
+        CHECK (recorder->getNumDropped() == 1);
+
+        recorder->drain (events);
+        CHECK (events.size() == TraceRecorder::capacity);
+        CHECK (recorder->record (makeEvent ("block", 0)));
+    }
+
+    SECTION ("takes events from several threads while being drained")
+    {
+        constexpr int perThread = 50000;
+
+        std::thread first ([&] { for (int i = 0; i < perThread; ++i) while (! recorder->record (makeEvent ("first", i, i))) std::this_thread::yield(); });
+        std::thread second ([&] { for (int i = 0; i < perThread; ++i) while (! recorder->record (makeEvent ("second", i, i))) std::this_thread::yield(); });
+
+        while (events.size() < 2 * (size_t) perThread)
+            recorder->drain (events);
+
+        first.join();
+        second.join();
+
+        // each thread's events arrive exactly once and in its own order
+        int nextFirst = 0, nextSecond = 0;
+
+        for (const auto& event : events)
+        {
+            auto& next = std::string (event.name) == "first" ? nextFirst : nextSecond;
+            CHECK (event.numSamples == next);
+            ++next;
+        }
+
+        CHECK (nextFirst == perThread);
+        CHECK (nextSecond == perThread);
+    }
+
+    SECTION ("recording is real-time safe")
+    {
+        const auto violations = RealtimeGuard::check ([&] {
+            for (int i = 0; i < 1000; ++i)
+                const TraceRecorder::Scope scope (*recorder, "stage", 64);
+        });
+
+        INFO (violations.describe());
+        CHECK (violations.isClean());
+    }
+}
+
+TEST_CASE ("Chrome trace formatting", "[trace]")
+{
+    ChromeTraceFormatter formatter;
+    juce::String json = ChromeTraceFormatter::header;
+
+    auto lfo = makeEvent ("lfo", 1000, 64);
+    auto write = makeEvent ("write", 2000, 64);
+    write.threadId = 99;
+
+    formatter.append (json, lfo);
+    formatter.append (json, write);
+    json += ChromeTraceFormatter::footer;
+
+    CHECK (formatter.getNumWritten() == 2);
+    CHECK (json.startsWith ("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["));
+    CHECK (json.contains ("\"name\":\"lfo\""));
+    CHECK (json.contains ("\"ph\":\"X\""));
+    CHECK (json.contains ("\"args\":{\"samples\":64}"));
+
+    // threads are renumbered from 1 in the order they appear, timestamps start at the first event
+    CHECK (json.contains ("\"ts\":0.000"));
+    CHECK (json.contains ("\"tid\":1"));
+    CHECK (json.contains ("\"tid\":2"));
+
+    // exactly one separator between the two events, and the brackets balance
+    const auto text = json.toStdString();
+    CHECK (std::count (text.begin(), text.end(), '{') == std::count (text.begin(), text.end(), '}'));
+    CHECK (json.contains ("},\n{"));
+}
@@ -0,0 +1,153 @@
+#include "helpers/test_helpers.h"
+#include <PluginProcessor.h>
+#include <catch2/catch_template_test_macros.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+#include <thread>
+
+TEST_CASE ("Worker pool runs every task once", "[workers]")
+{
+    const auto numWorkers = GENERATE (0, 1, VoiceWorkerPool::maxWorkers);
+    CAPTURE (numWorkers);
+
+    VoiceWorkerPool pool;
+    pool.setNumWorkers (numWorkers);
+    REQUIRE (pool.getNumThreads() == numWorkers + 1);
+
+    std::atomic<int> runs[VoiceWorkerPool::maxThreads * 4];
+    std::atomic<bool> badThread { false };
+
+    for (int job = 0; job < 1000; ++job)
+    {
+        const auto numTasks = 1 + job % (int) std::size (runs);
+
+        for (auto& count : runs)
+            count = 0;
+
+        pool.wake();
+        pool.run (numTasks, [&] (int task, int thread) {
+            if (! juce::isPositiveAndBelow (thread, pool.getNumThreads()))
+                badThread = true;
+
+            runs[task].fetch_add (1);
+        }, [] (int) {}, 1.0);
+
+        // everything is done by the time run() returns, and nothing past the job is touched
+        for (int task = 0; task < (int) std::size (runs); ++task)
+            REQUIRE (runs[task].load() == (task < numTasks ? 1 : 0));
+    }
+
+    CHECK_FALSE (badThread);
+}
+
+TEST_CASE ("Worker pool stops waiting for a late worker", "[workers]")
+{
+    VoiceWorkerPool pool;
+    pool.setNumWorkers (1);
+
+    std::atomic<bool> workerStarted { false };
+    std::atomic<bool> releaseWorker { false };
+    std::vector<int> takenOver;
+
+    // the caller holds on to its task until the worker has claimed the other, then the worker
+    // is held up for as long as the test likes
+    const auto onTime = pool.run (2, [&] (int, int thread) {
+        if (thread == 0)
+        {
+            for (int i = 0; i < 1000 && ! workerStarted; ++i)
+                std::this_thread::sleep_for (std::chrono::milliseconds (1));
+        }
+        else
+        {
+            workerStarted = true;
+
+            while (! releaseWorker)
+                std::this_thread::sleep_for (std::chrono::milliseconds (1));
+        }
+    }, [&] (int task) { takenOver.push_back (task); }, 0.001);
+
+    // run() came back without the worker, and had the caller redo its task
+    REQUIRE (workerStarted);
+    CHECK_FALSE (onTime);
+    CHECK (pool.getNumLateJobs() == 1);
+    CHECK (takenOver == std::vector<int> { 1 });
+    CHECK (pool.isBusy());
+
+    // while the worker is still on it, the next job is the caller's alone
+    takenOver.clear();
+    CHECK_FALSE (pool.run (3, [] (int, int) {}, [&] (int task) { takenOver.push_back (task); }, 0.001));
+    CHECK (takenOver == std::vector<int> { 0, 1, 2 });
+
+    releaseWorker = true;
+    pool.waitUntilIdle();
+    CHECK_FALSE (pool.isBusy());
+
+    takenOver.clear();
+    CHECK (pool.run (3, [] (int, int) {}, [&] (int task) { takenOver.push_back (task); }, 1.0));
+    CHECK (takenOver.empty());
+}
+
+TEMPLATE_TEST_CASE ("Voices rendered on several threads sound the same", "[workers]", float, double)
+{
+    constexpr double sampleRate = 48000.0;
+    // not a multiple of the sub-block size, so the groups see a short chunk as well
+    constexpr int blockSize = 100;
+
+    const auto mode = GENERATE (0, 1, 2, 3);
+    const auto channelCounts = GENERATE (std::pair (1, 1), std::pair (1, 2), std::pair (2, 2));
+    const auto layout = channelCounts.first == 2 ? GENERATE (Waylochorus2AudioProcessor::DelayLineLayout::planar, Waylochorus2AudioProcessor::DelayLineLayout::interleaved)
+                                                 : Waylochorus2AudioProcessor::DelayLineLayout::interleaved;
+    CAPTURE (mode, channelCounts.first, channelCounts.second, (int) layout);
+
+    Waylochorus2AudioProcessor single, threaded;
+    threaded.setNumWorkerThreads (VoiceWorkerPool::maxWorkers);
+
+    const auto channels = [] (int numChannels) { return numChannels == 1 ? juce::AudioChannelSet::mono() : juce::AudioChannelSet::stereo(); };
+
+    for (auto* plugin : { &single, &threaded })
+    {
+        REQUIRE (plugin->setBusesLayout ({ { channels (channelCounts.first) }, { channels (channelCounts.second) } }));
+        plugin->setProcessingPrecision (std::is_same_v<TestType, double> ? juce::AudioProcessor::doublePrecision
+                                                                          : juce::AudioProcessor::singlePrecision);
+        plugin->setDelayLineLayout (layout);
+        setParameter (*plugin, ChorusParameters::interpolationId, (float) mode);
+        setParameter (*plugin, ChorusParameters::stereoModeId, 1.0f);
+        plugin->setRateAndBufferSizeDetails (sampleRate, blockSize);
+        plugin->prepareToPlay (sampleRate, blockSize);
+    }
+
+    juce::AudioBuffer<TestType> singleBuffer (channelCounts.second, blockSize), threadedBuffer (channelCounts.second, blockSize);
+    juce::MidiBuffer midi;
+    juce::Random random (43);
+    double maxDifference = 0.0;
+
+    for (int block = 0; block < 100; ++block)
+    {
+        // from too few voices to split to as many as there are, ramping in between
+        if (block % 25 == 0)
+            for (auto* plugin : { &single, &threaded })
+                plugin->setNumVoices (block == 25 ? 12 : block == 50 ? 7 : 32);
+
+        for (int channel = 0; channel < channelCounts.first; ++channel)
+        {
+            for (int i = 0; i < blockSize; ++i)
+            {
+                const auto sample = (TestType) (random.nextFloat() - 0.5f);
+                singleBuffer.setSample (channel, i, sample);
+                threadedBuffer.setSample (channel, i, sample);
+            }
+        }
+
+        single.processBlock (singleBuffer, midi);
+        threaded.processBlock (threadedBuffer, midi);
+
+        for (int channel = 0; channel < channelCounts.second; ++channel)
+            for (int i = 0; i < blockSize; ++i)
+                maxDifference = std::max (maxDifference, (double) std::abs (singleBuffer.getSample (channel, i) - threadedBuffer.getSample (channel, i)));
+    }
+
+    CHECK (threadedBuffer.getMagnitude (0, 0, blockSize) > 1.0e-3f);
+
+    // the same voices, only with the groups summed in another order
+    CHECK (maxDifference < 1.0e-5);
+}
@@ -0,0 +1,414 @@
+#include "realtime_guard.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <new>
+
+#if defined(__linux__)
+    #include <dlfcn.h>
+    #include <fcntl.h>
+    #include <linux/perf_event.h>
+    #include <pthread.h>
+    #include <sys/ioctl.h>
+    #include <sys/resource.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+    #include <malloc.h>
+#endif
+
+/* The interposers below replace symbols for the whole test executable. They have
+ * to stay cheap and must never allocate or lock themselves: when the calling
+ * thread isn't being watched they only check a thread local flag and forward.
+ */
+namespace
+{
+    struct Counters
+    {
+        bool watching = false;
+        uint64_t allocations = 0;
+        uint64_t deallocations = 0;
+        uint64_t locks = 0;
+    };
+
+    // plain data, so no constructor runs on first use and reading it can't allocate
+    thread_local Counters counters;
+
+    inline void noteAllocation() noexcept
+    {
+        if (counters.watching)
+            ++counters.allocations;
+    }
+
+    inline void noteDeallocation (void* pointer) noexcept
+    {
+        if (counters.watching && pointer != nullptr)
+            ++counters.deallocations;
+    }
+
+    inline void noteLock() noexcept
+    {
+        if (counters.watching)
+            ++counters.locks;
+    }
+}
+
+//==============================================================================
+// malloc and friends. glibc exports its own implementations under __libc_ names,
+// so these can forward without looking anything up.
+#if defined(__GLIBC__)
+extern "C"
+{
+    void* __libc_malloc (size_t);
+    void* __libc_calloc (size_t, size_t);
+    void* __libc_realloc (void*, size_t);
+    void* __libc_memalign (size_t, size_t);
+    void __libc_free (void*);
+
+    void* malloc (size_t size) noexcept
+    {
+        noteAllocation();
+        return __libc_malloc (size);
+    }
+
+    void* calloc (size_t count, size_t size) noexcept
+    {
+        noteAllocation();
+        return __libc_calloc (count, size);
+    }
+
+    void* realloc (void* pointer, size_t size) noexcept
+    {
+        noteAllocation();
+        return __libc_realloc (pointer, size);
+    }
+
+    void* memalign (size_t alignment, size_t size) noexcept
+    {
+        noteAllocation();
+        return __libc_memalign (alignment, size);
+    }
+
+    void* aligned_alloc (size_t alignment, size_t size) noexcept
+    {
+        noteAllocation();
+        return __libc_memalign (alignment, size);
+    }
+
+    int posix_memalign (void** result, size_t alignment, size_t size) noexcept
+    {
+        noteAllocation();
+
+        if (alignment < sizeof (void*) || (alignment & (alignment - 1)) != 0)
+            return EINVAL;
+
+        auto* pointer = __libc_memalign (alignment, size);
+
+        if (pointer == nullptr)
+            return ENOMEM;
+
+        *result = pointer;
+        return 0;
+    }
+
+    void free (void* pointer) noexcept
+    {
+        noteDeallocation (pointer);
+        __libc_free (pointer);
+    }
+}
+#endif
+
+//==============================================================================
+// operator new and delete. These go straight to the allocator underneath malloc,
+// so nothing is counted twice on glibc.
+namespace
+{
+    void* rawAllocate (std::size_t size) noexcept
+    {
+       #if defined(__GLIBC__)
+        return __libc_malloc (size == 0 ? 1 : size);
+       #else
+        return std::malloc (size == 0 ? 1 : size);
+       #endif
+    }
+
+    void rawFree (void* pointer) noexcept
+    {
+       #if defined(__GLIBC__)
+        __libc_free (pointer);
+       #else
+        std::free (pointer);
+       #endif
+    }
+
+    void* rawAllocateAligned (std::size_t size, std::size_t alignment) noexcept
+    {
+       #if defined(__GLIBC__)
+        return __libc_memalign (alignment, size == 0 ? 1 : size);
+       #elif defined(_WIN32)
+        return _aligned_malloc (size == 0 ? 1 : size, alignment);
+       #else
+        void* pointer = nullptr;
+        return posix_memalign (&pointer, alignment < sizeof (void*) ? sizeof (void*) : alignment, size == 0 ? 1 : size) == 0 ? pointer : nullptr;
+       #endif
+    }
+
+    void rawFreeAligned (void* pointer) noexcept
+    {
+       #if defined(_WIN32)
+        _aligned_free (pointer);
+       #else
+        rawFree (pointer);
+       #endif
+    }
+
+    void* allocateOrThrow (std::size_t size)
+    {
+        noteAllocation();
+
+        if (auto* pointer = rawAllocate (size))
+            return pointer;
+
+        throw std::bad_alloc();
+    }
+
+    void* allocateAlignedOrThrow (std::size_t size, std::align_val_t alignment)
+    {
+        noteAllocation();
+
+        if (auto* pointer = rawAllocateAligned (size, (std::size_t) alignment))
+            return pointer;
+
+        throw std::bad_alloc();
+    }
+}
+
+void* operator new (std::size_t size) { return allocateOrThrow (size); }
+void* operator new[] (std::size_t size) { return allocateOrThrow (size); }
+void* operator new (std::size_t size, const std::nothrow_t&) noexcept { noteAllocation(); return rawAllocate (size); }
+void* operator new[] (std::size_t size, const std::nothrow_t&) noexcept { noteAllocation(); return rawAllocate (size); }
+void* operator new (std::size_t size, std::align_val_t alignment) { return allocateAlignedOrThrow (size, alignment); }
+void* operator new[] (std::size_t size, std::align_val_t alignment) { return allocateAlignedOrThrow (size, alignment); }
+
+void operator delete (void* pointer) noexcept { noteDeallocation (pointer); rawFree (pointer); }
+void operator delete[] (void* pointer) noexcept { noteDeallocation (pointer); rawFree (pointer); }
+void operator delete (void* pointer, std::size_t) noexcept { noteDeallocation (pointer); rawFree (pointer); }
+void operator delete[] (void* pointer, std::size_t) noexcept { noteDeallocation (pointer); rawFree (pointer); }
+void operator delete (void* pointer, const std::nothrow_t&) noexcept { noteDeallocation (pointer); rawFree (pointer); }
+void operator delete[] (void* pointer, const std::nothrow_t&) noexcept { noteDeallocation (pointer); rawFree (pointer); }
+void operator delete (void* pointer, std::align_val_t) noexcept { noteDeallocation (pointer); rawFreeAligned (pointer); }
+void operator delete[] (void* pointer, std::align_val_t) noexcept { noteDeallocation (pointer); rawFreeAligned (pointer); }
+void operator delete (void* pointer, std::size_t, std::align_val_t) noexcept { noteDeallocation (pointer); rawFreeAligned (pointer); }
+void operator delete[] (void* pointer, std::size_t, std::align_val_t) noexcept { noteDeallocation (pointer); rawFreeAligned (pointer); }
+
+//==============================================================================
+// Locks. The real functions are looked up the first time they're needed; dlsym
+// doesn't go through pthread_mutex_lock itself, so this can't recurse.
+#if defined(__GLIBC__)
+namespace
+{
+    template <typename Function>
+    Function* findNext (Function*& cached, const char* name) noexcept
+    {
+        if (cached == nullptr)
+            cached = reinterpret_cast<Function*> (dlsym (RTLD_NEXT, name));
+
+        return cached;
+    }
+
+    int (*realMutexLock) (pthread_mutex_t*) = nullptr;
+    int (*realMutexTimedLock) (pthread_mutex_t*, const timespec*) = nullptr;
+    int (*realReadLock) (pthread_rwlock_t*) = nullptr;
+    int (*realWriteLock) (pthread_rwlock_t*) = nullptr;
+}
+
+extern "C"
+{
+    int pthread_mutex_lock (pthread_mutex_t* mutex) noexcept
+    {
+        noteLock();
+        return findNext (realMutexLock, "pthread_mutex_lock") (mutex);
+    }
+
+    int pthread_mutex_timedlock (pthread_mutex_t* mutex, const timespec* timeout) noexcept
+    {
+        noteLock();
+        return findNext (realMutexTimedLock, "pthread_mutex_timedlock") (mutex, timeout);
+    }
+
+    int pthread_rwlock_rdlock (pthread_rwlock_t* lock) noexcept
+    {
+        noteLock();
+        return findNext (realReadLock, "pthread_rwlock_rdlock") (lock);
+    }
+
+    int pthread_rwlock_wrlock (pthread_rwlock_t* lock) noexcept
+    {
+        noteLock();
+        return findNext (realWriteLock, "pthread_rwlock_wrlock") (lock);
+    }
+}
+#endif
+
+//==============================================================================
+// Context switches and syscalls, both per thread.
+namespace
+{
+    int64_t voluntaryContextSwitches()
+    {
+       #if defined(__linux__)
+        rusage usage {};
+
+        if (getrusage (RUSAGE_THREAD, &usage) == 0)
+            return (int64_t) usage.ru_nvcsw;
+       #endif
+
+        return -1;
+    }
+
+   #if defined(__linux__)
+    // counts raw_syscalls:sys_enter for the calling thread
+    class SyscallCounter
+    {
+    public:
+        SyscallCounter()
+        {
+            const auto id = readTracepointId();
+
+            if (id < 0)
+                return;
+
+            perf_event_attr attributes {};
+            attributes.type = PERF_TYPE_TRACEPOINT;
+            attributes.size = sizeof (attributes);
+            attributes.config = (uint64_t) id;
+            attributes.disabled = 1;
+            attributes.sample_period = 1;
+
+            fd = (int) syscall (SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+
+            if (fd < 0)
+                return;
+
+            // stopping the counter is itself a syscall, measure that once and take it off every reading
+            start();
+            overhead = stop();
+        }
+
+        ~SyscallCounter()
+        {
+            if (fd >= 0)
+                close (fd);
+        }
+
+        bool isAvailable() const { return fd >= 0; }
+
+        void start()
+        {
+            if (fd >= 0)
+            {
+                ioctl (fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl (fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+
+        int64_t stop()
+        {
+            if (fd < 0)
+                return -1;
+
+            ioctl (fd, PERF_EVENT_IOC_DISABLE, 0);
+
+            uint64_t count = 0;
+
+            if (read (fd, &count, sizeof (count)) != (ssize_t) sizeof (count))
+                return -1;
+
+            return (int64_t) count - overhead > 0 ? (int64_t) count - overhead : 0;
+        }
+
+    private:
+        static int readTracepointId()
+        {
+            for (auto* path : { "/sys/kernel/tracing/events/raw_syscalls/sys_enter/id",
+                                "/sys/kernel/debug/tracing/events/raw_syscalls/sys_enter/id" })
+            {
+                const auto file = open (path, O_RDONLY);
+
+                if (file < 0)
+                    continue;
+
+                char text[32] = {};
+                const auto length = read (file, text, sizeof (text) - 1);
+                close (file);
+
+                if (length > 0)
+                    return std::atoi (text);
+            }
+
+            return -1;
+        }
+
+        int fd = -1;
+        int64_t overhead = 0;
+    };
+
+    SyscallCounter& getSyscallCounter()
+    {
+        // one per thread, perf counts the thread that opened it
+        thread_local SyscallCounter counter;
+        return counter;
+    }
+   #endif
+
+    thread_local int64_t contextSwitchesAtStart = 0;
+}
+
+namespace RealtimeGuard
+{
+    void begin()
+    {
+       #if defined(__linux__)
+        auto& syscalls = getSyscallCounter();
+       #endif
+
+        contextSwitchesAtStart = voluntaryContextSwitches();
+        counters = {};
+        counters.watching = true;
+
+       #if defined(__linux__)
+        syscalls.start();
+       #endif
+    }
+
+    Violations end()
+    {
+        Violations result;
+
+       #if defined(__linux__)
+        result.syscalls = getSyscallCounter().stop();
+       #endif
+
+        counters.watching = false;
+        result.allocations = counters.allocations;
+        result.deallocations = counters.deallocations;
+        result.locks = counters.locks;
+
+        if (const auto switches = voluntaryContextSwitches(); switches >= 0 && contextSwitchesAtStart >= 0)
+            result.contextSwitches = switches - contextSwitchesAtStart;
+
+        return result;
+    }
+
+    bool canCountSyscalls()
+    {
+       #if defined(__linux__)
+        return getSyscallCounter().isAvailable();
+       #else
+        return false;
+       #endif
+    }
+}
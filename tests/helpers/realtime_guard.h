@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/* Catches anything on the audio path that could block: heap allocation, locking,
+ * sleeping and (where the kernel lets us count them) system calls.
+ *
+ * Run the code that has to be real-time safe through RealtimeGuard::check and
+ * look at what comes back:
+
+    const auto violations = RealtimeGuard::check ([&] { plugin.processBlock (buffer, midi); });
+    INFO (violations.describe());
+    CHECK (violations.isClean());
+
+ * Only the calling thread is watched, and only inside check, so Catch and the
+ * test setup can allocate as they like. Don't put assertions inside the lambda.
+ *
+ * What gets caught:
+ *  - operator new and delete, everywhere
+ *  - malloc, calloc, realloc, free and the aligned variants, on glibc
+ *  - pthread mutex and read-write lock acquisition, on glibc. This is what
+ *    std::mutex, juce::CriticalSection and juce::ReadWriteLock sit on.
+ *    Try-locks don't block, so they aren't counted.
+ *  - voluntary context switches (the thread went to sleep on something), on Linux
+ *  - system calls, on Linux when perf can open the raw_syscalls tracepoint
+ *    (needs a low kernel.perf_event_paranoid or CAP_PERFMON). Otherwise
+ *    syscalls is reported as -1.
+ */
+namespace RealtimeGuard
+{
+    struct Violations
+    {
+        uint64_t allocations = 0;
+        uint64_t deallocations = 0;
+        uint64_t locks = 0;
+        int64_t contextSwitches = -1;
+        int64_t syscalls = -1;
+
+        bool isClean() const
+        {
+            return allocations == 0 && deallocations == 0 && locks == 0
+                && contextSwitches <= 0 && syscalls <= 0;
+        }
+
+        Violations& operator+= (const Violations& other)
+        {
+            allocations += other.allocations;
+            deallocations += other.deallocations;
+            locks += other.locks;
+            contextSwitches = other.contextSwitches < 0 ? contextSwitches : (contextSwitches < 0 ? 0 : contextSwitches) + other.contextSwitches;
+            syscalls = other.syscalls < 0 ? syscalls : (syscalls < 0 ? 0 : syscalls) + other.syscalls;
+            return *this;
+        }
+
+        std::string describe() const
+        {
+            const auto orUnknown = [] (int64_t count) { return count < 0 ? std::string ("not counted") : std::to_string (count); };
+
+            return std::to_string (allocations) + " allocations, " + std::to_string (deallocations) + " deallocations, "
+                 + std::to_string (locks) + " locks, " + orUnknown (contextSwitches) + " voluntary context switches, "
+                 + orUnknown (syscalls) + " syscalls";
+        }
+    };
+
+    /* Starts and stops watching the calling thread. Prefer check(), these are for when
+     * the guarded code can't be put in a lambda. Calls don't nest.
+     */
+    void begin();
+    Violations end();
+
+    template <typename Function>
+    Violations check (Function&& function)
+    {
+        begin();
+        function();
+        return end();
+    }
+
+    /* True if the syscall counter could be opened, so Violations::syscalls means something. */
+    bool canCountSyscalls();
+}
@@ -7,7 +7,7 @@
  *
  * Example usage (screenshots the plugin)
  *
-  runWithinPluginEditor ([&] (PluginProcessor& plugin) {
+  runWithinPluginEditor ([&] (Waylochorus2AudioProcessor& plugin) {
     auto snapshot = plugin.getActiveEditor()->createComponentSnapshot (plugin.getActiveEditor()->getLocalBounds(), true, 2.0f);
     auto file = juce::File::getSpecialLocation (juce::File::SpecialLocationType::userDocumentsDirectory).getChildFile ("snapshot.jpeg");
     file.deleteFile();
@@ -19,9 +19,9 @@
    });
 
  */
-[[maybe_unused]] static void runWithinPluginEditor (const std::function<void (PluginProcessor& plugin)>& testCode)
+[[maybe_unused]] static void runWithinPluginEditor (const std::function<void (Waylochorus2AudioProcessor& plugin)>& testCode)
 {
-    PluginProcessor plugin;
+    Waylochorus2AudioProcessor plugin;
     const auto editor = plugin.createEditorIfNeeded();
 
     testCode (plugin);
@@ -29,3 +29,34 @@
     plugin.editorBeingDeleted (editor);
     delete editor;
 }
+
+/* Sets a parameter to a value in its own units, through the host-facing path, so the processor
+ * picks it up the way it would from automation.
+ */
+[[maybe_unused]] static void setParameter (Waylochorus2AudioProcessor& plugin, const juce::String& id, float value)
+{
+    auto* parameter = plugin.getValueTreeState().getParameter (id);
+    parameter->setValueNotifyingHost (parameter->convertTo0to1 (value));
+}
+
+/* A parameter's current value in its own units. */
+[[maybe_unused]] static float getParameter (Waylochorus2AudioProcessor& plugin, const juce::String& id)
+{
+    auto* parameter = plugin.getValueTreeState().getParameter (id);
+    return parameter->convertFrom0to1 (parameter->getValue());
+}
+
+/* Gives the plugin numInputs and numOutputs channels, each 1 or 2, and prepares it to play. Returns
+ * false if it doesn't take that layout, so a test can REQUIRE it.
+ */
+[[maybe_unused]] static bool prepareWithChannels (Waylochorus2AudioProcessor& plugin, int numInputs, int numOutputs, double sampleRate, int blockSize)
+{
+    const auto channels = [] (int numChannels) { return numChannels == 1 ? juce::AudioChannelSet::mono() : juce::AudioChannelSet::stereo(); };
+
+    if (! plugin.setBusesLayout ({ { channels (numInputs) }, { channels (numOutputs) } }))
+        return false;
+
+    plugin.setRateAndBufferSizeDetails (sampleRate, blockSize);
+    plugin.prepareToPlay (sampleRate, blockSize);
+    return true;
+}